@@ -0,0 +1,65 @@
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+//
+// Clock arithmetic, kept apart from the hardware so that it can be tested on a host.  The clock
+// counts ticks of the 32768 Hz ACLK in a free-running 16-bit timer, extended in software by counting
+// its overflows, and is seen by the app as milliseconds since boot, which wrap every 49.7 days.
+// Times in milliseconds are only ever compared by their difference, taken as signed, so that they
+// compare correctly across the wrap as long as they're within 24.8 days of each other.
+//
+
+#define CLOCK_FREQUENCY             32768
+
+// A one-shot compare is armed no further ahead than half the counter's range, so that it can't be
+// mistaken for one that has already passed, and no nearer than allows for the counter advancing
+// while it's armed
+#define CLOCK_COMPARE_MAX_TICKS     0x8000
+#define CLOCK_COMPARE_MAX_MS        (CLOCK_COMPARE_MAX_TICKS * 1000UL / CLOCK_FREQUENCY)
+#define CLOCK_COMPARE_MIN_TICKS     2
+
+// Extend a reading of the 16-bit counter to the full tick count, given the overflows counted so far
+// and whether the counter's overflow flag is set.  If it is and the reading is from the lower half
+// of the range, the counter overflowed before it was read but the overflow hasn't yet been counted.
+static inline uint64_t clockExtend(uint32_t overflows, uint16_t count, bool overflowPending) {
+    if (overflowPending && count < 0x8000)
+        overflows++;
+    return ((uint64_t) overflows << 16) | count;
+}
+
+// Convert clock ticks to milliseconds, truncated from the full tick count to 32 bits so that millis()
+// wraps cleanly
+static inline long unsigned int clockTicksToMs(uint64_t ticks) {
+    return (uint32_t) ((ticks * 1000) / CLOCK_FREQUENCY);
+}
+
+// Convert a short interval of milliseconds, no more than 131 seconds, to ticks, rounded up so as
+// never to be early
+static inline uint32_t clockMsToTicks(uint32_t ms) {
+    return (ms * (uint32_t) CLOCK_FREQUENCY + 999) / 1000;
+}
+
+// Get the number of milliseconds from now until a time, which is negative once it has passed
+static inline int32_t clockMsUntil(long unsigned int nowMs, long unsigned int thenMs) {
+    return (int32_t) (uint32_t) (thenMs - nowMs);
+}
+
+// Get whether a time has been reached
+static inline bool clockReached(long unsigned int nowMs, long unsigned int thenMs) {
+    return clockMsUntil(nowMs, thenMs) <= 0;
+}
+
+// Get the number of ticks ahead at which to arm the one-shot compare to wake at a deadline that is
+// the specified number of milliseconds away.  If it's further away than a compare can reach, the
+// sleeper is woken early and simply sleeps again.
+static inline uint32_t clockCompareTicks(int32_t remainingMs) {
+    if (remainingMs >= (int32_t) CLOCK_COMPARE_MAX_MS)
+        return CLOCK_COMPARE_MAX_TICKS;
+    uint32_t ticks = clockMsToTicks((uint32_t) remainingMs);
+    return (ticks < CLOCK_COMPARE_MIN_TICKS ? CLOCK_COMPARE_MIN_TICKS : ticks);
+}
+
+#endif // CLOCK_H
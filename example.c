@@ -8,17 +8,59 @@
 #if !DISABLE_NOTE_C_LIBRARY
 #include "note.h"
 
+// The body of each note, which is rendered directly from this struct as described by its table of fields
+typedef struct {
+    JNUMBER temp;
+    JNUMBER voltage;
+    uint32_t count;
+} sensorBody;
+static const JField sensorBodyFields[] = {
+    JFIELD(sensorBody, temp, JFIELD_NUMBER, "temp"),
+    JFIELD(sensorBody, voltage, JFIELD_NUMBER, "voltage"),
+    JFIELD(sensorBody, count, JFIELD_UINT32, "count"),
+    JFIELD_END
+};
+
+// Each sample is taken by a sequence of transactions, from one to the next as each response arrives
+#define SAMPLE_TEMP     0
+#define SAMPLE_VOLTAGE  1
+#define SAMPLE_ADD      2
+#define SAMPLE_POLL_MS  25
+static int sampleStep = SAMPLE_TEMP;
+static unsigned eventCounter = 0;
+static JNUMBER temperature = 0;
+static JNUMBER voltage = 0;
+static bool sampling = false;
+static task sampleTask;
+static task samplePollTask;
+
+// Inbound notes, which the Notecard tells us about by raising its ATTN pin rather than our polling
+// for them, and which may change how often we take a sample
+#define INBOUND_RETRY_MS    5000
+static const char *inboundFiles[] = { "data.qi" };
+static task inboundTask;
+
+// Forwards
+static void sampleTaskFn(void *context);
+static void samplePollTaskFn(void *context);
+static void sampleBegin(J *req);
+static void inboundTaskFn(void *context);
+static void inboundNote(const char *file, J *note);
+
 // JSON example
 void setup() {
 
     // Register callbacks with note-c subsystem that it needs for I/O, memory, timer
     NoteSetFn(malloc, free, delay, millis);
+    NoteSetFnRealloc(realloc);
 
     // Register callbacks for Notecard I/O, or just do the initialization
 #if NOTECARD_USE_I2C
     NoteSetFnI2C(NOTE_I2C_ADDR_DEFAULT, NOTE_I2C_MAX_DEFAULT, noteI2CReset, noteI2CTransmit, noteI2CReceive);
 #else
     NoteSetFnSerial(noteSerialReset, noteSerialTransmit, noteSerialAvailable, noteSerialReceive);
+    NoteSetFnSerialWait(noteSerialWait);
+    NoteSetFnSerialReceiveBlock(noteSerialReceiveBlock);
 #endif
 
     // "NoteNewRequest()" uses the bundled "J" json package to allocate a "req", which is a JSON object
@@ -41,7 +83,7 @@ void setup() {
     JAddStringToObject(req, "mode", "continuous");
 #else
     JAddStringToObject(req, "mode", "periodic");
-    JAddNumberToObject(req, "outbound", 60);
+    JAddIntToObject(req, "outbound", 60);
 #endif
 
     // Issue the request, telling the Notecard how and how often to access the service.
@@ -54,62 +96,130 @@ void setup() {
     // returns "true" if success and "false" if there is any failure.
     NoteRequest(req);
 
+    // Take a sample periodically, starting now
+    taskInit(&sampleTask, sampleTaskFn, NULL);
+    taskInit(&samplePollTask, samplePollTaskFn, NULL);
+#if myLiveDemo
+    taskEvery(&sampleTask, 15*1000, 0);         // 15 seconds
+#else
+    taskEvery(&sampleTask, 15*60*1000, 0);      // 15 minutes
+#endif
+
+    // Arm the Notecard's ATTN pin to rise when an inbound note arrives, and handle it when it does
+    taskInit(&inboundTask, inboundTaskFn, NULL);
+    if (NoteInboundArm(inboundFiles, sizeof(inboundFiles)/sizeof(inboundFiles[0]), inboundNote)) {
+        noteAttnEnable(&inboundTask);
+    }
+
 }
 
-// Arduino-like loop
-void loop() {
+// Take a sample, by way of a task that runs periodically
+static void sampleTaskFn(void *context) {
+
+    // If the previous sample's transactions are still under way, such as when the period is
+    // shorter than they take, skip this one rather than restarting them and mixing up their
+    // responses.  The task runs again at the next period.
+    if (sampling) {
+        return;
+    }
 
     // Simulate an event counter of some kind
-    static unsigned eventCounter = 0;
     eventCounter = eventCounter + 1;
+    sampling = true;
 
     // Rather than simulating a temperature reading, use a Notecard request to read the temp
-    // from the Notecard's built-in temperature sensor.  We use NoteRequestResponse() to indicate
-    // that we would like to examine the response of the transaction.  This method takes a "request" JSON
-    // data structure as input, then processes it and returns a "response" JSON data structure with
-    // the response.  Note that because the Notecard library uses malloc(), developers must always
-    // check for NULL to ensure that there was enough memory available on the microcontroller to
-    // satisfy the allocation request.
-    JNUMBER temperature = 0;
-    J *rsp = NoteRequestResponse(NoteNewRequest("card.temp"));
-    if (rsp != NULL) {
-        temperature = JGetNumber(rsp, "value");
-        NoteDeleteResponse(rsp);
+    // from the Notecard's built-in temperature sensor.  Rather than waiting for the Notecard
+    // to respond, as NoteRequestResponse() would, we begin the transaction and leave the
+    // response to be collected by another task that polls for it, so that other tasks can
+    // run in the meantime.  Note that because the Notecard library uses malloc(), developers
+    // must always check for NULL to ensure that there was enough memory available on the
+    // microcontroller to satisfy the allocation request.
+    sampleStep = SAMPLE_TEMP;
+    sampleBegin(NoteNewRequest("card.temp"));
+
+}
+
+// Poll for the response to the sample's current transaction, and when it has arrived, begin the next one
+static void samplePollTaskFn(void *context) {
+
+    // Check again later if the response hasn't yet arrived
+    if (!NoteTransactionPoll()) {
+        taskAfter(&samplePollTask, SAMPLE_POLL_MS);
+        return;
     }
+    J *rsp = NoteTransactionComplete();
+
+    J *req = NULL;
+    switch (sampleStep) {
 
     // Do the same to retrieve the voltage that is detected by the Notecard on its V+ pin.
-    JNUMBER voltage = 0;
-    rsp = NoteRequestResponse(NoteNewRequest("card.voltage"));
-    if (rsp != NULL) {
-        voltage = JGetNumber(rsp, "value");
-        NoteDeleteResponse(rsp);
-    }
+    case SAMPLE_TEMP:
+        temperature = JGetNumber(rsp, "value");
+        sampleStep = SAMPLE_VOLTAGE;
+        req = NoteNewRequest("card.voltage");
+        break;
 
     // Enqueue the measurement to the Notecard for transmission to the Notehub, adding the "start"
     // flag for demonstration purposes to upload the data instantaneously, so that if you are looking
     // at this on notehub.io you will see the data appearing 'live'.)
-    J *req = NoteNewRequest("note.add");
-    if (req != NULL) {
-        JAddStringToObject(req, "file", "sensors.qo");
+    case SAMPLE_VOLTAGE:
+        voltage = JGetNumber(rsp, "value");
+        sampleStep = SAMPLE_ADD;
+        req = NoteNewRequest("note.add");
+        if (req != NULL) {
+            JAddStringToObject(req, "file", "sensors.qo");
 #if myLiveDemo
-        JAddBoolToObject(req, "start", true);
+            JAddBoolToObject(req, "start", true);
 #endif
-        J *body = JCreateObject();
-        if (body != NULL) {
-            JAddNumberToObject(body, "temp", temperature);
-            JAddNumberToObject(body, "voltage", voltage);
-            JAddNumberToObject(body, "count", eventCounter);
-            JAddItemToObject(req, "body", body);
+            sensorBody reading = { temperature, voltage, eventCounter };
+            J *body = JCreateStruct(&reading, sensorBodyFields);
+            if (body != NULL) {
+                JAddItemToObject(req, "body", body);
+            }
         }
-        NoteRequest(req);
+        break;
+
+    // The sample is complete
+    default:
+        break;
+
     }
+    NoteDeleteResponse(rsp);
+    sampleBegin(req);
 
-    // Delay between measurements
-#if myLiveDemo
-    delay(15*1000);     // 15 seconds
-#else
-    delay(15*60*1000);  // 15 minutes
-#endif
+}
+
+// Begin a transaction for the sample, if there is one, and poll for its response
+static void sampleBegin(J *req) {
+    if (req == NULL) {
+        sampling = false;
+        return;
+    }
+    if (NoteTransactionBegin(req)) {
+        taskAfter(&samplePollTask, SAMPLE_POLL_MS);
+    } else {
+        sampling = false;
+    }
+    JDelete(req);
+}
+
+// Deliver the inbound notes that have arrived, once the Notecard has raised its ATTN pin.  If a
+// sample's transaction is under way, we try again once it has had time to finish, and if the
+// Notecard couldn't be asked about them, a little later than that.
+static void inboundTaskFn(void *context) {
+    if (sampling) {
+        taskAfter(&inboundTask, SAMPLE_POLL_MS);
+    } else if (NoteInboundDispatch() < 0) {
+        taskAfter(&inboundTask, INBOUND_RETRY_MS);
+    }
+}
+
+// An inbound note may tell us how many seconds to wait between samples, such as {"seconds":60}
+static void inboundNote(const char *file, J *note) {
+    uint32_t seconds = JGetInt(JGetObject(note, "body"), "seconds");
+    if (seconds != 0) {
+        taskEvery(&sampleTask, seconds*1000, 0);
+    }
 }
 
 #endif  // !DISABLE_NOTE_C_LIBRARY
@@ -11,8 +11,12 @@
 // written for Serial because I2C requires a "serial-over-i2c" protocol that is implemented within the library.
 #if DISABLE_NOTE_C_LIBRARY && !NOTECARD_USE_I2C
 
+// A task that adds a note periodically
+static task addTask;
+
 // Forwards
 void my_itoa(int dataIn, char* bffr, int radix);
+static void addTaskFn(void *context);
 
 // JSON example
 void setup() {
@@ -49,10 +53,18 @@ void setup() {
     char *request = "{" F_REQ "," F_PRODUCT F_MODE "}\n";
     noteSerialTransmit((uint8_t *)request, strlen(request), true);
 
+    // Add a note periodically, starting now
+    taskInit(&addTask, addTaskFn, NULL);
+#if myLiveDemo
+    taskEvery(&addTask, 15*1000, 0);        // 15 seconds
+#else
+    taskEvery(&addTask, 15*60*1000, 0);     // 15 minutes
+#endif
+
 }
 
-// Arduino-like loop
-void loop() {
+// Add a note, by way of a task that runs periodically
+static void addTaskFn(void *context) {
 
     // Simulate an event counter of some kind
     static unsigned eventCounter = 0;
@@ -76,13 +88,6 @@ void loop() {
     // Complete and issue the request
     request = "}}\n";
     noteSerialTransmit((uint8_t *)request, strlen(request), true);
-
-    // Delay between measurements
-#if myLiveDemo
-    delay(15*1000);     // 15 seconds
-#else
-    delay(15*60*1000);  // 15 minutes
-#endif
 }
 
 // int to string
@@ -9,6 +9,9 @@
 #include <stdlib.h>
 #include <string.h>
 #include "main.h"
+#include "clock.h"
+#include "uart.h"
+#include "note.h"
 
 // MSP430FR2355 UCB0SDA and UCB0SCL
 // http://www.ti.com/lit/ug/slau680/slau680.pdf
@@ -16,12 +19,36 @@
 #define I2C_PIN_SDA         GPIO_PIN2
 #define I2C_PIN_SCL         GPIO_PIN3
 
+// The Notecard's ATTN pin, which it raises when something that it has been armed to watch for, such
+// as a note arriving in an inbound notefile, happens
+#define ATTN_PORT           GPIO_PORT_P2
+#define ATTN_PIN            GPIO_PIN0
+#define ATTN_PORT_IV        P2IV_P2IFG0
+
 // Clock frequencies initialized by INIT_CS()
 #define DCOCLK_FREQUENCY    24000000
 #define MCLK_FREQUENCY      DCOCLK_FREQUENCY
 #define SMCLK_FREQUENCY     DCOCLK_FREQUENCY
-#define ACLK_FREQUENCY      32768
-#define I2C_FREQUENCY       EUSCI_B_I2C_SET_DATA_RATE_100KBPS
+#define ACLK_FREQUENCY      CLOCK_FREQUENCY
+
+// The eUSCI_B can't divide SMCLK by less than 4 to generate SCL, and Fast-mode Plus is the fastest
+// mode that it (and the Notecard) support
+#define I2C_FREQUENCY_STANDARD  100000
+#define I2C_FREQUENCY_MAX       1000000
+#if NOTECARD_I2C_FREQUENCY > I2C_FREQUENCY_MAX || NOTECARD_I2C_FREQUENCY > SMCLK_FREQUENCY/4
+#error NOTECARD_I2C_FREQUENCY is faster than the I2C bus supports
+#endif
+
+// How long to wait for the Notecard to echo a newline when trying a baud rate
+#define SERIAL_PROBE_MS     100
+
+// How deeply to sleep while delaying.  LPM3 stops SMCLK, which clocks the UART, so when talking to
+// the Notecard over SERIAL we only go as deep as LPM0 so as not to drop bytes that it sends us.
+#if NOTECARD_USE_I2C
+#define DELAY_LPM_BITS      LPM3_bits
+#else
+#define DELAY_LPM_BITS      LPM0_bits
+#endif
 
 // Data for Notecard I/O functions
 #if !NOTECARD_USE_I2C
@@ -29,6 +56,11 @@ static size_t serialOverruns = 0;
 static volatile size_t serialFillIndex = 0;
 static volatile size_t serialDrainIndex = 0;
 static char serialBuffer[512];
+// Transmit ring, drained a byte at a time by the UART ISR
+static volatile size_t serialTxFillIndex = 0;
+static volatile size_t serialTxDrainIndex = 0;
+static volatile bool serialTxActive = false;
+static uint8_t serialTxBuffer[64];
 #endif
 
 // I2C parameters
@@ -36,20 +68,37 @@ static char serialBuffer[512];
 static EUSCI_B_I2C_initMasterParam i2cConfig = {
     EUSCI_B_I2C_CLOCKSOURCE_SMCLK,
     SMCLK_FREQUENCY,
-    I2C_FREQUENCY,
+    NOTECARD_I2C_FREQUENCY,
     0,
     EUSCI_B_I2C_SEND_STOP_AUTOMATICALLY_ON_BYTECOUNT_THRESHOLD
 };
-static char *i2cBufferNext;
-static uint32_t i2cBufferLeft = 0;
+// The largest frame on the wire is a maximum-size chunk plus the two header
+// bytes (available, received) that the Notecard prefixes to every read reply.
+#define I2C_FRAME_HEADER_LEN    2
+#define I2C_FRAME_MAX           (NOTE_I2C_MAX_MAX + I2C_FRAME_HEADER_LEN)
+static uint8_t i2cFrame[I2C_FRAME_MAX];
+static uint8_t *i2cBufferNext;
+static volatile uint32_t i2cBufferLeft = 0;
+static volatile bool i2cNacked = false;
 #endif
 
-// Clock timer
-static long unsigned int ticksMs = 0;
+// The task posted by the port ISR when the ATTN pin rises
+static task *volatile attnTask = NULL;
+
+// Clock, which counts ACLK ticks in Timer_B0's free-running 16-bit counter, extended in software by
+// counting its overflows, with the arithmetic in clock.h.  The CPU is interrupted only by an overflow
+// every 2 seconds, and by a one-shot compare when something is asleep until a deadline.
+static volatile uint32_t clockOverflows = 0;
+
+// CPU activity, measured across each sleep, so that the time spent asleep is known
+static uint64_t cpuAsleepTicks = 0;
 
 // Forwards
 void init_GPIO(void);
 void init_CS(void);
+static uint64_t clockTicks(void);
+static void sleepUntilWoken(uint16_t lpmBits);
+static bool sleepUntil(long unsigned int deadlineMs, uint16_t lpmBits);
 
 // Main entry point
 int main(void) {
@@ -58,10 +107,9 @@ int main(void) {
     init_CS();
     init_GPIO();
 
-    // Simulate an Arduino-like setup/loop interface
+    // Let the example set up its tasks, and then run them, sleeping whenever none are ready
     setup();
-    while (true)
-        loop();
+    schedRun();
 
 }
 
@@ -113,35 +161,75 @@ void init_CS(void) {
     P3SEL0 |= BIT4;
     P3SEL1 &= ~BIT4;
 
-    // Set up watchdog to count at ACLK (32768Hz) and to overflow the up counter at 32, or at a ~1mS interval
-    Timer_B_initUpModeParam tpB = {0};
+    // Set up the clock to count freely at ACLK (32768Hz), interrupting only when the counter overflows
+    Timer_B_initContinuousModeParam tpB = {0};
     tpB.clockSource                 = TIMER_B_CLOCKSOURCE_ACLK;
     tpB.clockSourceDivider          = TIMER_B_CLOCKSOURCE_DIVIDER_1;
     tpB.timerInterruptEnable_TBIE   = TIMER_B_TBIE_INTERRUPT_ENABLE;
+    tpB.timerClear                  = TIMER_B_DO_CLEAR;
     tpB.startTimer                  = true;
-    tpB.timerPeriod                 = 32;
-    Timer_B_initUpMode(TIMER_B0_BASE, &tpB);
-    Timer_B_startCounter(TIMER_B0_BASE, TIMER_B_UP_MODE);
+    Timer_B_initContinuousMode(TIMER_B0_BASE, &tpB);
     __bis_SR_register(GIE);
 
 }
 
-// Serial port reset procedure, called before any I/O and called again upon I/O error
+// Sleep in the specified low-power mode until an ISR wakes us.  This must be called with interrupts
+// disabled, just after testing the condition being waited upon, so that an ISR can't change it
+// unnoticed before we're asleep.  It returns with interrupts disabled, so that the condition can be
+// tested again.  ISRs wake us by clearing LPM3_bits, which covers LPM0 as well.
+static void sleepUntilWoken(uint16_t lpmBits) {
+    uint64_t asleepTicks = clockTicks();
+    __bis_SR_register(lpmBits + GIE);
+    __disable_interrupt();
+    cpuAsleepTicks += clockTicks() - asleepTicks;
+}
+
+// Sleep as above, but also until the clock reaches the deadline, returning false without sleeping
+// once it has.  This must also be called with interrupts disabled.  The deadline is reached by a
+// one-shot compare, and if the deadline is further away than one can reach the caller simply sleeps
+// again.
+static bool sleepUntil(long unsigned int deadlineMs, uint16_t lpmBits) {
+    uint64_t ticks = clockTicks();
+    int32_t remainingMs = clockMsUntil(clockTicksToMs(ticks), deadlineMs);
+    if (remainingMs <= 0)
+        return false;
+    uint32_t compareTicks = clockCompareTicks(remainingMs);
+    Timer_B_setCompareValue(TIMER_B0_BASE, TIMER_B_CAPTURECOMPARE_REGISTER_1, (uint16_t) (ticks + compareTicks));
+    Timer_B_clearCaptureCompareInterrupt(TIMER_B0_BASE, TIMER_B_CAPTURECOMPARE_REGISTER_1);
+    Timer_B_enableCaptureCompareInterrupt(TIMER_B0_BASE, TIMER_B_CAPTURECOMPARE_REGISTER_1);
+    sleepUntilWoken(lpmBits);
+    Timer_B_disableCaptureCompareInterrupt(TIMER_B0_BASE, TIMER_B_CAPTURECOMPARE_REGISTER_1);
+    return true;
+}
+
+// Get the number of milliseconds that the CPU has spent awake and asleep since boot
+void cpuActivity(uint32_t *awakeMs, uint32_t *asleepMs) {
+    __disable_interrupt();
+    uint64_t ticks = clockTicks();
+    uint64_t asleepTicks = cpuAsleepTicks;
+    __enable_interrupt();
+    *awakeMs = clockTicksToMs(ticks - asleepTicks);
+    *asleepMs = clockTicksToMs(asleepTicks);
+}
+
+// Configure the UART at the specified baud rate, N/8/1, and start receiving
 #if !NOTECARD_USE_I2C
-bool noteSerialReset() {
+static void serialConfigure(uint32_t baud) {
 
     // Configure UCA1TXD and UCA1RXD
     GPIO_setAsPeripheralModuleFunctionInputPin(GPIO_PORT_P4, GPIO_PIN2, GPIO_PRIMARY_MODULE_FUNCTION);
     GPIO_setAsPeripheralModuleFunctionOutputPin(GPIO_PORT_P4, GPIO_PIN3, GPIO_PRIMARY_MODULE_FUNCTION);
 
-    // Configure UART 9600/N/8/1
-    // http://software-dl.ti.com/msp430/msp430_public_sw/mcu/msp430/MSP430BaudRateConverter/index.html
+    // Configure UART
+    uartDivisors divisors;
+    uartBaudDivisors(SMCLK_FREQUENCY, baud, &divisors);
     EUSCI_A_UART_initParam param = {0};
     param.selectClockSource = EUSCI_A_UART_CLOCKSOURCE_SMCLK;
-    param.clockPrescalar = 156;
-    param.firstModReg = 4;
-    param.secondModReg = 0;
-    param.overSampling = 1;
+    param.clockPrescalar = divisors.prescaler;
+    param.firstModReg = divisors.firstMod;
+    param.secondModReg = divisors.secondMod;
+    param.overSampling = (divisors.overSampling ? EUSCI_A_UART_OVERSAMPLING_BAUDRATE_GENERATION
+                          : EUSCI_A_UART_LOW_FREQUENCY_BAUDRATE_GENERATION);
     param.parity = EUSCI_A_UART_NO_PARITY;
     param.msborLsbFirst = EUSCI_A_UART_LSB_FIRST;
     param.numberofStopBits = EUSCI_A_UART_ONE_STOP_BIT;
@@ -154,22 +242,68 @@ bool noteSerialReset() {
     EUSCI_A_UART_enableInterrupt(EUSCI_A1_BASE, EUSCI_A_UART_RECEIVE_INTERRUPT);
     __bis_SR_register(GIE);
 
-    // Reset our buffer management
+    // Reset our buffer management, noting that initializing the UART disabled its transmit interrupts
+    __disable_interrupt();
     serialFillIndex = serialDrainIndex = serialOverruns = 0;
+    serialTxFillIndex = serialTxDrainIndex = 0;
+    serialTxActive = false;
+    __enable_interrupt();
 
     // Unused, but included for documentation
     ((void)(serialOverruns));
+
+}
+#endif
+
+// Serial port reset procedure, called before any I/O and called again upon I/O error.  The Notecard
+// talks at 9600 baud unless its serial port has been set to another rate, so that is all we use unless
+// NOTECARD_SERIAL_BAUD is set to the faster rate that it has been given.  We never ask the Notecard to
+// change its rate; we only try NOTECARD_SERIAL_BAUD first, and because the Notecard echoes a newline
+// with a blank line, we use that to tell whether it understands us, falling back to 9600 if it doesn't.
+#if !NOTECARD_USE_I2C
+bool noteSerialReset() {
+    static const uint32_t baudRates[] = { NOTECARD_SERIAL_BAUD, 9600 };
+    for (size_t i = 0; i < sizeof(baudRates)/sizeof(baudRates[0]); i++) {
+        serialConfigure(baudRates[i]);
+        if (baudRates[i] == 9600)
+            break;
+        noteSerialTransmit((uint8_t *)"\n", 1, true);
+        long unsigned int startMs = millis();
+        for (uint32_t elapsedMs = 0; elapsedMs < SERIAL_PROBE_MS; elapsedMs = millis() - startMs) {
+            if (noteSerialWait(SERIAL_PROBE_MS - elapsedMs) && noteSerialReceive() == '\n')
+                return true;
+        }
+    }
     return true;
 }
 #endif
 
-// Serial write data function
+// Serial write data function, which queues the data for the ISR to transmit, sleeping while
+// the queue is full and, if flushing, until the last byte has been shifted out onto the wire
 #if !NOTECARD_USE_I2C
 void noteSerialTransmit(uint8_t *text, size_t len, bool flush) {
     while (len > 0) {
-        while (EUSCI_A_UART_queryStatusFlags(EUSCI_A1_BASE, EUSCI_A_UART_BUSY));
-        EUSCI_A_UART_transmitData(EUSCI_A1_BASE, *text++);
+        size_t nextFillIndex = (serialTxFillIndex + 1) % sizeof(serialTxBuffer);
+        __disable_interrupt();
+        while (nextFillIndex == serialTxDrainIndex)
+            sleepUntilWoken(LPM0_bits);
+        serialTxBuffer[serialTxFillIndex] = *text++;
         len--;
+        // Mark the transmitter active before publishing the byte, with interrupts still disabled,
+        // so that the ISR can't find the wire idle and clear the flag between the two, which
+        // would leave the byte queued with nothing to send it and a flush sleeping forever.
+        // The ISR stops itself once the ring has drained and the wire is idle.
+        serialTxActive = true;
+        serialTxFillIndex = nextFillIndex;
+        EUSCI_A_UART_enableInterrupt(EUSCI_A1_BASE, EUSCI_A_UART_TRANSMIT_INTERRUPT
+                                     + EUSCI_A_UART_TRANSMIT_COMPLETE_INTERRUPT);
+        __enable_interrupt();
+    }
+    if (flush) {
+        __disable_interrupt();
+        while (serialTxActive)
+            sleepUntilWoken(LPM0_bits);
+        __enable_interrupt();
     }
 }
 #endif
@@ -181,11 +315,26 @@ bool noteSerialAvailable() {
 }
 #endif
 
+// Serial wait function, which sleeps until the ISR has received data or the timeout has elapsed,
+// returning whether or not data is available
+#if !NOTECARD_USE_I2C
+bool noteSerialWait(uint32_t timeoutMs) {
+    long unsigned int deadlineMs = millis() + timeoutMs;
+    __disable_interrupt();
+    while (!noteSerialAvailable() && sleepUntil(deadlineMs, LPM0_bits)) ;
+    __enable_interrupt();
+    return noteSerialAvailable();
+}
+#endif
+
 // Blocking serial read a byte function (generally only called if known to be available)
 #if !NOTECARD_USE_I2C
 char noteSerialReceive() {
     char data;
-    while (!noteSerialAvailable()) ;
+    __disable_interrupt();
+    while (!noteSerialAvailable())
+        sleepUntilWoken(LPM0_bits);
+    __enable_interrupt();
     if (serialDrainIndex < sizeof(serialBuffer))
         data = serialBuffer[serialDrainIndex++];
     else {
@@ -196,14 +345,59 @@ char noteSerialReceive() {
 }
 #endif
 
+// Serial block read function, which copies out as much as the ISR has received, up to the
+// specified length, in at most two contiguous spans of the ring, returning how many bytes it copied
+#if !NOTECARD_USE_I2C
+size_t noteSerialReceiveBlock(uint8_t *data, size_t len) {
+    size_t received = 0;
+    while (received < len) {
+        size_t fillIndex = serialFillIndex;
+        size_t drainIndex = serialDrainIndex;
+        if (fillIndex == drainIndex)
+            break;
+        if (drainIndex == sizeof(serialBuffer))
+            drainIndex = 0;
+        size_t span = (fillIndex >= drainIndex ? fillIndex : sizeof(serialBuffer)) - drainIndex;
+        if (span > len - received)
+            span = len - received;
+        memcpy(&data[received], &serialBuffer[drainIndex], span);
+        received += span;
+        serialDrainIndex = drainIndex + span;
+    }
+    return received;
+}
+#endif
+
+// Configure the I2C bus for the specified SCL frequency.  The eUSCI_B divides SMCLK by an integer,
+// so the divisor is rounded up so that SCL never runs faster than the bus is rated for.
+#if NOTECARD_USE_I2C
+static void i2cConfigure(uint32_t frequency) {
+    uint32_t divisor = (i2cConfig.i2cClk + frequency - 1) / frequency;
+    if (divisor < 4)
+        divisor = 4;
+    i2cConfig.dataRate = i2cConfig.i2cClk / divisor;
+    EUSCI_B_I2C_initMaster(EUSCI_B0_BASE, &i2cConfig);
+}
+#endif
+
 // I2C reset procedure, called before any I/O and called again upon I/O error
 #if NOTECARD_USE_I2C
 bool noteI2CReset(uint16_t DevAddress) {
     i2cConfig.i2cClk = CS_getSMCLK();
     GPIO_setAsPeripheralModuleFunctionInputPin( I2C_PORT, I2C_PIN_SCL | I2C_PIN_SDA,
                                                 GPIO_PRIMARY_MODULE_FUNCTION );
-    EUSCI_B_I2C_initMaster(EUSCI_B0_BASE, &i2cConfig);
+    i2cConfigure(NOTECARD_I2C_FREQUENCY);
     __bis_SR_register(GIE);
+
+    // Self-check the bus timing by polling the Notecard, which answers a zero-length read with
+    // just the header.  If it doesn't answer correctly at speed, such as when the bus's pull-ups
+    // are too weak for the faster rise times, fall back to Standard-mode.
+    if (NOTECARD_I2C_FREQUENCY > I2C_FREQUENCY_STANDARD) {
+        uint8_t nothing;
+        uint32_t available;
+        if (noteI2CReceive(DevAddress, &nothing, 0, &available) != NULL)
+            i2cConfigure(I2C_FREQUENCY_STANDARD);
+    }
     return true;
 }
 #endif
@@ -214,19 +408,13 @@ bool noteI2CReset(uint16_t DevAddress) {
 #if NOTECARD_USE_I2C
 const char *noteI2CTransmit(uint16_t DevAddress, uint8_t* pBuffer, uint16_t Size) {
 
-    // Special-case Size == 0 as being equivalent to 1 because of the I2C Receive header
-    size_t bufferLength = sizeof(uint8_t) + (Size == 0 ? 1 : Size);
-
-    // Allocate the transmit buffer
-    char *i2cBuffer = malloc(bufferLength);
-    if (i2cBuffer == NULL)
-        return "i2c: insufficient memory (write)";
-
-    // Copy the buffer and set up for transmit
-    i2cBuffer[0] = (uint8_t) Size;
-    memcpy(&i2cBuffer[1], pBuffer, bufferLength-1);
-    i2cBufferNext = i2cBuffer;
-    i2cBufferLeft = bufferLength;
+    // The length header is loaded straight into the transmit register when the
+    // transfer starts, and the ISR then streams the payload out of the caller's
+    // buffer, so no copy of the frame is needed.  Special-case Size == 0 as
+    // sending 1 byte of payload because of the I2C Receive header.
+    i2cBufferNext = pBuffer;
+    i2cBufferLeft = (Size == 0 ? 1 : Size);
+    i2cNacked = false;
 
     // Set up for the transmit
     EUSCI_B_I2C_setSlaveAddress(EUSCI_B0_BASE, DevAddress);
@@ -236,20 +424,21 @@ const char *noteI2CTransmit(uint16_t DevAddress, uint8_t* pBuffer, uint16_t Size
                                + EUSCI_B_I2C_RECEIVE_INTERRUPT0
                                + EUSCI_B_I2C_BYTE_COUNTER_INTERRUPT
                                + EUSCI_B_I2C_NAK_INTERRUPT);
-    EUSCI_B_I2C_enableInterrupt(EUSCI_B0_BASE, EUSCI_B_I2C_TRANSMIT_INTERRUPT0);
+    EUSCI_B_I2C_enableInterrupt(EUSCI_B0_BASE, EUSCI_B_I2C_TRANSMIT_INTERRUPT0 + EUSCI_B_I2C_NAK_INTERRUPT);
     __bis_SR_register(GIE);
 
-    // Initiate the multi-byte transmit, knowing that we ALWAYS send at least 2 bytes
-    EUSCI_B_I2C_masterSendMultiByteStart(EUSCI_B0_BASE, *i2cBufferNext++);
-    i2cBufferLeft--;
+    // Initiate the multi-byte transmit with the header, knowing that we ALWAYS send at least 2 bytes
+    EUSCI_B_I2C_masterSendMultiByteStart(EUSCI_B0_BASE, (uint8_t) Size);
 
     // Wait until it has completed
-    while (i2cBufferLeft > 0)  __bis_SR_register(LPM0_bits + GIE);
+    __disable_interrupt();
+    while (i2cBufferLeft > 0)
+        sleepUntilWoken(LPM0_bits);
+    __enable_interrupt();
     while (EUSCI_B_I2C_masterIsStopSent(EUSCI_B0_BASE) != EUSCI_B_I2C_STOP_SEND_COMPLETE) ;
 
-    // Free the transmit buffer
-    free(i2cBuffer);
-
+    if (i2cNacked)
+        return "i2c: notecard did not acknowledge";
     return NULL;
 }
 #endif
@@ -258,18 +447,20 @@ const char *noteI2CTransmit(uint16_t DevAddress, uint8_t* pBuffer, uint16_t Size
 #if NOTECARD_USE_I2C
 const char *noteI2CReceive(uint16_t DevAddress, uint8_t* pBuffer, uint16_t Size, uint32_t *available) {
 
+    // The reply must fit in the static frame buffer
+    if (Size > NOTE_I2C_MAX_MAX)
+        return "i2c: read exceeds maximum frame size";
+
     // Transmit a signal that "about to do a receive of N bytes" to the slave, with a special-case Size == 0
     uint8_t hdr = (uint8_t) Size;
     const char *errstr = noteI2CTransmit(DevAddress, &hdr, 0);
     if (errstr != NULL)
         return errstr;
 
-    // Allocate a return buffer
-    i2cBufferLeft = Size + (sizeof(uint8_t)*2);
-    char *i2cBuffer = malloc(i2cBufferLeft);
-    if (i2cBuffer == NULL)
-        return "i2c: insufficient memory (read)";
-    i2cBufferNext = i2cBuffer;
+    // Receive the header and the reply into the static frame buffer
+    i2cBufferLeft = Size + I2C_FRAME_HEADER_LEN;
+    i2cBufferNext = i2cFrame;
+    i2cNacked = false;
 
     // Receive the reply
     EUSCI_B_I2C_setSlaveAddress(EUSCI_B0_BASE, DevAddress);
@@ -279,24 +470,30 @@ const char *noteI2CReceive(uint16_t DevAddress, uint8_t* pBuffer, uint16_t Size,
                                + EUSCI_B_I2C_RECEIVE_INTERRUPT0
                                + EUSCI_B_I2C_BYTE_COUNTER_INTERRUPT
                                + EUSCI_B_I2C_NAK_INTERRUPT);
-    EUSCI_B_I2C_enableInterrupt(EUSCI_B0_BASE, EUSCI_B_I2C_RECEIVE_INTERRUPT0 + EUSCI_B_I2C_BYTE_COUNTER_INTERRUPT);
+    EUSCI_B_I2C_enableInterrupt(EUSCI_B0_BASE, EUSCI_B_I2C_RECEIVE_INTERRUPT0 + EUSCI_B_I2C_BYTE_COUNTER_INTERRUPT + EUSCI_B_I2C_NAK_INTERRUPT);
     __bis_SR_register(GIE);
 
     EUSCI_B_I2C_masterReceiveStart(EUSCI_B0_BASE);
 
     // Wait until receive is completed
-    while (i2cBufferLeft > 0) __bis_SR_register(LPM0_bits + GIE);
+    __disable_interrupt();
+    while (i2cBufferLeft > 0)
+        sleepUntilWoken(LPM0_bits);
+    __enable_interrupt();
+    if (i2cNacked) {
+        while (EUSCI_B_I2C_masterIsStopSent(EUSCI_B0_BASE) != EUSCI_B_I2C_STOP_SEND_COMPLETE) ;
+        return "i2c: notecard did not acknowledge";
+    }
 
     // Interpret the received buffer
-    uint8_t availbyte = i2cBuffer[0];
-    uint8_t goodbyte = i2cBuffer[1];
+    uint8_t availbyte = i2cFrame[0];
+    uint8_t goodbyte = i2cFrame[1];
     if (goodbyte != Size) {
         errstr = "i2c: incorrect amount of data";
     } else {
         *available = availbyte;
-        memcpy(pBuffer, &i2cBuffer[2], Size);
+        memcpy(pBuffer, &i2cFrame[I2C_FRAME_HEADER_LEN], Size);
     }
-    free(i2cBuffer);
 
     // Done
     return errstr;
@@ -304,15 +501,65 @@ const char *noteI2CReceive(uint16_t DevAddress, uint8_t* pBuffer, uint16_t Size,
 }
 #endif
 
+// Get the number of clock ticks since boot, which must be called with interrupts disabled.  If the
+// counter has overflowed since it was read but the ISR hasn't yet counted it, it is counted here.
+static uint64_t clockTicks(void) {
+    uint16_t count = Timer_B_getCounterValue(TIMER_B0_BASE);
+    return clockExtend(clockOverflows, count, (TB0CTL & TBIFG) != 0);
+}
+
 // Get the number of app milliseconds since boot (this will wrap)
 long unsigned int millis() {
-    return (long unsigned int) ticksMs;
+    unsigned short state = __get_interrupt_state();
+    __disable_interrupt();
+    uint64_t ticks = clockTicks();
+    __set_interrupt_state(state);
+    return clockTicksToMs(ticks);
 }
 
-// Delay the specified number of milliseconds
+// Delay the specified number of milliseconds, asleep until the deadline
 void delay(uint32_t ms) {
-    long unsigned int expires = millis() + ms;
-    while (millis() < expires) ;
+    long unsigned int deadlineMs = millis() + ms;
+    __disable_interrupt();
+    while (sleepUntil(deadlineMs, DELAY_LPM_BITS)) ;
+    __enable_interrupt();
+}
+
+// Disable interrupts for the scheduler, returning whether they were enabled, so that it can be called by ISRs
+unsigned short schedDisableInterrupts(void) {
+    unsigned short state = __get_interrupt_state();
+    __disable_interrupt();
+    return state;
+}
+
+// Restore interrupts for the scheduler to the state that they were in before being disabled
+void schedRestoreInterrupts(unsigned short state) {
+    __set_interrupt_state(state);
+}
+
+// Sleep while the scheduler has nothing to run, until an ISR wakes us or the next timer is due, as
+// deeply as delay() does
+void schedSleep(bool timed, long unsigned int deadlineMs) {
+    if (timed)
+        sleepUntil(deadlineMs, DELAY_LPM_BITS);
+    else
+        sleepUntilWoken(DELAY_LPM_BITS);
+}
+
+// Post the specified task whenever the Notecard raises its ATTN pin, or stop doing so if it's NULL.
+// If the pin is already high, as it is once the Notecard's been armed and has since fired, the task
+// is posted straight away because there'll be no edge to interrupt us.
+void noteAttnEnable(task *t) {
+    GPIO_disableInterrupt(ATTN_PORT, ATTN_PIN);
+    attnTask = t;
+    if (t == NULL)
+        return;
+    GPIO_setAsInputPinWithPullDownResistor(ATTN_PORT, ATTN_PIN);
+    GPIO_selectInterruptEdge(ATTN_PORT, ATTN_PIN, GPIO_LOW_TO_HIGH_TRANSITION);
+    GPIO_clearInterrupt(ATTN_PORT, ATTN_PIN);
+    GPIO_enableInterrupt(ATTN_PORT, ATTN_PIN);
+    if (GPIO_getInputPinValue(ATTN_PORT, ATTN_PIN) == GPIO_INPUT_PIN_HIGH)
+        taskPost(t);
 }
 
 // EUSCI Interrupt Service Routine
@@ -344,13 +591,37 @@ __interrupt void USCI_A1_ISR(void)
                 serialFillIndex = 1;
             }
         }
+        __bic_SR_register_on_exit(LPM3_bits);
+        break;
+    }
+
+    // Transmit the next queued byte.  Reading the vector cleared the flag, so when the ring is
+    // empty it is set again because the buffer is indeed empty, ready for when we're re-enabled.
+    case USCI_UART_UCTXIFG: {
+        if (serialTxDrainIndex != serialTxFillIndex) {
+            UCA1TXBUF = serialTxBuffer[serialTxDrainIndex];
+            serialTxDrainIndex = (serialTxDrainIndex + 1) % sizeof(serialTxBuffer);
+            UCA1IFG &= ~UCTXCPTIFG;
+        } else {
+            EUSCI_A_UART_disableInterrupt(EUSCI_A1_BASE, EUSCI_A_UART_TRANSMIT_INTERRUPT);
+            UCA1IFG |= UCTXIFG;
+        }
+        __bic_SR_register_on_exit(LPM3_bits);
+        break;
+    }
+
+    // The last byte has been shifted out, so the wire is idle unless more has been queued since
+    case USCI_UART_UCTXCPTIFG: {
+        if (serialTxDrainIndex == serialTxFillIndex) {
+            EUSCI_A_UART_disableInterrupt(EUSCI_A1_BASE, EUSCI_A_UART_TRANSMIT_COMPLETE_INTERRUPT);
+            serialTxActive = false;
+            __bic_SR_register_on_exit(LPM3_bits);
+        }
         break;
     }
 
     case USCI_NONE:
-    case USCI_UART_UCTXIFG:
     case USCI_UART_UCSTTIFG:
-    case USCI_UART_UCTXCPTIFG:
     default:
         break;
     }
@@ -381,7 +652,7 @@ __interrupt void USCI_B0_ISR(void)
                 EUSCI_B_I2C_masterReceiveMultiByteStop(EUSCI_B0_BASE);
         }
         if (i2cBufferLeft == 0)
-            __bic_SR_register_on_exit(LPM0_bits);
+            __bic_SR_register_on_exit(LPM3_bits);
         break;
     }
 
@@ -394,7 +665,7 @@ __interrupt void USCI_B0_ISR(void)
                 EUSCI_B_I2C_masterSendMultiByteFinish(EUSCI_B0_BASE, *i2cBufferNext++);
         }
         if (i2cBufferLeft == 0)
-            __bic_SR_register_on_exit(LPM0_bits);
+            __bic_SR_register_on_exit(LPM3_bits);
         break;
     }
 
@@ -403,6 +674,11 @@ __interrupt void USCI_B0_ISR(void)
     case 0x02:      // Vector 2: No interrupts
         break;
     case 0x04:      // Vector 4: NACKIFG
+        // The Notecard didn't acknowledge, so abandon the transfer with a stop condition
+        UCB0CTLW0 |= UCTXSTP;
+        i2cNacked = true;
+        i2cBufferLeft = 0;
+        __bic_SR_register_on_exit(LPM3_bits);
         break;
     case 0x06:      // Vector 6: STT IFG
         break;
@@ -442,7 +718,44 @@ __interrupt void TIMER0_B1_ISR(void)
 #error compiler not supported
 #endif
 {
-    ticksMs++;
-    Timer_B_clearTimerInterrupt(TIMER_B0_BASE);
+    switch (__even_in_range(TB0IV, TB0IV_TBIFG)) {
+
+    // A deadline has been reached, so disarm its one-shot compare and wake whoever is asleep until it
+    case TB0IV_TBCCR1:
+        Timer_B_disableCaptureCompareInterrupt(TIMER_B0_BASE, TIMER_B_CAPTURECOMPARE_REGISTER_1);
+        __bic_SR_register_on_exit(LPM3_bits);
+        break;
+
+    // The counter has wrapped
+    case TB0IV_TBIFG:
+        clockOverflows++;
+        break;
+
+    default:
+        break;
+    }
 }
 
+// Port 2 interrupt service routine, which hands the ATTN pin's rising to the task waiting for it
+#if defined(__TI_COMPILER_VERSION__) || defined(__IAR_SYSTEMS_ICC__)
+#pragma vector=PORT2_VECTOR
+__interrupt void PORT2_ISR(void)
+#elif defined(__GNUC__)
+    void __attribute__ ((interrupt(PORT2_VECTOR))) PORT2_ISR (void)
+#else
+#error compiler not supported
+#endif
+{
+    switch (__even_in_range(P2IV, P2IV_P2IFG7)) {
+
+    case ATTN_PORT_IV:
+        if (attnTask != NULL) {
+            taskPost(attnTask);
+            __bic_SR_register_on_exit(LPM3_bits);
+        }
+        break;
+
+    default:
+        break;
+    }
+}
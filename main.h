@@ -5,6 +5,7 @@
 #include <stdint.h>
 #include <stddef.h>
 #include <stdlib.h>
+#include "sched.h"
 
 //
 // This library demonstrates two potential ways of sending JSON to the Notecard - the first
@@ -29,6 +30,22 @@
 #define NOTECARD_USE_I2C        false
 #endif
 
+// Choose the baud rate at which to talk to the Notecard over SERIAL.  This is a manual setting: the
+// firmware never asks the Notecard to change its rate, and the Notecard talks at 9600 unless its serial
+// port has been set to a faster rate by other means, so only choose one if it has.  The chosen rate is
+// tried first, falling back to 9600 if the Notecard doesn't answer at it.
+
+#ifndef NOTECARD_SERIAL_BAUD
+#define NOTECARD_SERIAL_BAUD    9600
+#endif
+
+// Choose the I2C bus speed for the Notecard: 100000 (Standard-mode), 400000 (Fast-mode), or
+// 1000000 (Fast-mode Plus), falling back to Standard-mode if the Notecard doesn't answer at speed
+
+#ifndef NOTECARD_I2C_FREQUENCY
+#define NOTECARD_I2C_FREQUENCY  400000
+#endif
+
 
 
 #define myLiveDemo  true
@@ -36,14 +53,17 @@
 // Externalized
 void delay(uint32_t ms);
 long unsigned int millis(void);
+void cpuActivity(uint32_t *awakeMs, uint32_t *asleepMs);
 void setup(void);
-void loop(void);
 bool noteSerialReset(void);
 void noteSerialTransmit(uint8_t *text, size_t len, bool flush);
 bool noteSerialAvailable(void);
 char noteSerialReceive(void);
+size_t noteSerialReceiveBlock(uint8_t *data, size_t len);
+bool noteSerialWait(uint32_t timeoutMs);
 bool noteI2CReset(uint16_t DevAddress);
 size_t noteDebugSerialOutput(const char *message);
+void noteAttnEnable(task *t);
 const char *noteI2CTransmit(uint16_t DevAddress, uint8_t* pBuffer, uint16_t Size);
 const char *noteI2CReceive(uint16_t DevAddress, uint8_t* pBuffer, uint16_t Size, uint32_t *avail);
 long unsigned int millis(void);
@@ -40,6 +40,8 @@
 #define NULL 0
 #endif
 
+#ifndef NOTE_FIXED
+
 #define MAX_EXPONENT 511    /* Largest possible base 10 exponent.  Any
                                  * exponent larger than this will already
                                  * produce underflow or overflow, so there's
@@ -292,3 +294,139 @@ done:
     }
     return fraction;
 }
+
+#else // NOTE_FIXED
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * JAtoN -- a LOCALE-INDEPENDENT string to fixed point
+ *
+ *      This procedure converts a number in the same form as above to a
+ *      JNUMBER scaled by JNUMBER_SCALE, using integer arithmetic alone.
+ *
+ * Results:
+ *      The return value is the number, rounded to the nearest unit of
+ *      the scale and saturated at JNUMBER_MIN and JNUMBER_MAX.  Only the
+ *      first 10 significant digits are used.  *endPtr is set as above.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+#define MAX_MANTISSA 429496729UL      /* Largest mantissa that can take
+                                         * another digit in 32 bits. */
+
+JNUMBER
+JAtoN(const char *string, char **endPtr)
+{
+    int sign = FALSE;
+    uint32_t mantissa = 0;
+    uint32_t limit = (uint32_t)JNUMBER_MAX;
+    int exp = JNUMBER_DECIMALS;         /* Power of ten by which the mantissa
+                                         * must be scaled. */
+    int mantSize = 0;                   /* Number of digits in mantissa. */
+    const char *p = string;
+
+    /*
+     * Strip off leading blanks and check for a sign.
+     */
+
+    while (*p == ' ') {
+        p += 1;
+    }
+    if (*p == '-') {
+        sign = TRUE;
+        limit = (uint32_t)JNUMBER_MAX + 1;
+        p += 1;
+    } else if (*p == '+') {
+        p += 1;
+    }
+
+    /*
+     * Suck up the digits of the mantissa, noting how many places past the
+     * point there are, and the places of any that don't fit.
+     */
+
+    for (; (*p >= '0') && (*p <= '9'); p += 1, mantSize += 1) {
+        if (mantissa < MAX_MANTISSA) {
+            mantissa = (10 * mantissa) + (uint32_t)(*p - '0');
+        } else {
+            exp += 1;
+        }
+    }
+    if (*p == '.') {
+        p += 1;
+        for (; (*p >= '0') && (*p <= '9'); p += 1, mantSize += 1) {
+            if (mantissa < MAX_MANTISSA) {
+                mantissa = (10 * mantissa) + (uint32_t)(*p - '0');
+                exp -= 1;
+            }
+        }
+    }
+    if (mantSize == 0) {
+        p = string;
+        goto done;
+    }
+
+    /*
+     * Skim off the exponent, if it has any digits.
+     */
+
+    if ((*p == 'E') || (*p == 'e')) {
+        const char *pExp = p + 1;
+        int expSign = FALSE;
+        int e = 0;
+        if (*pExp == '-') {
+            expSign = TRUE;
+            pExp += 1;
+        } else if (*pExp == '+') {
+            pExp += 1;
+        }
+        if ((*pExp >= '0') && (*pExp <= '9')) {
+            for (; (*pExp >= '0') && (*pExp <= '9'); pExp += 1) {
+                if (e < 100) {
+                    e = (e * 10) + (*pExp - '0');
+                }
+            }
+            exp += (expSign ? -e : e);
+            p = pExp;
+        }
+    }
+
+    /*
+     * Scale the mantissa, saturating if it overflows and rounding off the
+     * last place that's dropped.
+     */
+
+    for (; (exp > 0) && (mantissa != 0); exp -= 1) {
+        if (mantissa > (limit / 10)) {
+            mantissa = limit;
+            break;
+        }
+        mantissa *= 10;
+    }
+    for (; (exp < -1) && (mantissa != 0); exp += 1) {
+        mantissa /= 10;
+    }
+    if (exp == -1) {
+        mantissa = (mantissa / 10) + ((mantissa % 10) >= 5 ? 1 : 0);
+    }
+    if (mantissa > limit) {
+        mantissa = limit;
+    }
+
+done:
+    if (endPtr != NULL) {
+        *endPtr = (char *) p;
+    }
+
+    if (sign) {
+        return (mantissa == limit) ? JNUMBER_MIN : -(JNUMBER)mantissa;
+    }
+    return (JNUMBER)mantissa;
+}
+
+#endif // NOTE_FIXED
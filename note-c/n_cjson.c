@@ -90,6 +90,8 @@ static error global_error = { NULL, 0 };
 // Forwards
 void htoa16(uint16_t n, unsigned char *p);
 static J *JNew_Item(void);
+static void suffix_object(J *prev, J *item);
+static void* cast_away_const(const void* string);
 
 N_CJSON_PUBLIC(const char *) JGetErrorPtr(void)
 {
@@ -135,6 +137,21 @@ static int case_insensitive_strcmp(const unsigned char *string1, const unsigned
     return tolower(*string1) - tolower(*string2);
 }
 
+/* Case insensitive comparison of at most the first length characters of two strings */
+static int case_insensitive_strncmp(const unsigned char *string1, const unsigned char *string2, size_t length)
+{
+    for (; length > 0; (void)string1++, string2++, length--) {
+        if (tolower(*string1) != tolower(*string2)) {
+            return tolower(*string1) - tolower(*string2);
+        }
+        if (*string1 == '\0') {
+            return 0;
+        }
+    }
+
+    return 0;
+}
+
 static unsigned char* Jstrdup(const unsigned char* string)
 {
     size_t length = 0;
@@ -163,10 +180,66 @@ N_CJSON_PUBLIC(void) JFree(void *p)
     _Free(p);
 }
 
+/* An arena, which is a single allocation holding an entire parsed tree.  Nodes are bump-allocated
+ * upward from just after this header, and strings downward from the end, so nodes need no padding.
+ * When parsing in place, strings are instead left in the text, which the arena adopts.
+ * The root is always the first node, which is how the arena is found again when it is deleted. */
+typedef struct {
+    size_t size;
+    unsigned char *nodes;
+    unsigned char *strings;
+    unsigned char *text;
+    size_t text_size;
+} JArena;
+#define ARENA_HEADER_SIZE (((sizeof(JArena) + sizeof(JNUMBER) - 1) / sizeof(JNUMBER)) * sizeof(JNUMBER))
+
+/* The arena being parsed into by JParseArena, if any, and statistics about all arenas */
+static JArena *parse_arena = NULL;
+static size_t arena_bytes_used = 0;
+static size_t arena_bytes_high = 0;
+
+static Jbool arena_owns(const JArena *arena, const void *p)
+{
+    if (arena == NULL) {
+        return false;
+    }
+    if (((const unsigned char *)p >= (const unsigned char *)arena) && ((const unsigned char *)p < (const unsigned char *)arena + arena->size)) {
+        return true;
+    }
+    return (arena->text != NULL) && ((const unsigned char *)p >= arena->text) && ((const unsigned char *)p < arena->text + arena->text_size);
+}
+
+/* Allocate a string while parsing, from the arena when parsing into one */
+static unsigned char *parse_alloc_string(size_t length)
+{
+    if (parse_arena == NULL) {
+        return (unsigned char*)_Malloc(length);
+    }
+    if ((size_t)(parse_arena->strings - parse_arena->nodes) < length) {
+        return NULL;
+    }
+    parse_arena->strings -= length;
+    return parse_arena->strings;
+}
+
+/* Free memory owned by an item, noting that memory in the arena being parsed into is released with it */
+static void item_free(void *p)
+{
+    if (!arena_owns(parse_arena, p)) {
+        _Free(p);
+    }
+}
+
 /* Internal constructor. */
 static J *JNew_Item()
 {
-    J* node = (J*)_Malloc(sizeof(J));
+    J* node = NULL;
+    if (parse_arena == NULL) {
+        node = (J*)_Malloc(sizeof(J));
+    } else if ((size_t)(parse_arena->strings - parse_arena->nodes) >= sizeof(J)) {
+        node = (J*)parse_arena->nodes;
+        parse_arena->nodes += sizeof(J);
+    }
     if (node) {
         memset(node, '\0', sizeof(J));
     }
@@ -174,22 +247,135 @@ static J *JNew_Item()
     return node;
 }
 
-/* Delete a J structure. */
+#ifdef N_CJSON_INDEX_THRESHOLD
+/* An index of an object's children by key, built when a search of an object passes over at least
+ * N_CJSON_INDEX_THRESHOLD of them, and discarded whenever they change.  It is held in the object's
+ * valuestring, which objects otherwise have no use for.  Each slot of the table, which is open
+ * addressed and at most half full, holds the first child with a given key ignoring case, so that
+ * looking a key up finds the same child as a scan would. */
+#ifndef N_CJSON_INDEX_MAX_ITEMS
+#define N_CJSON_INDEX_MAX_ITEMS 255
+#endif
+typedef struct {
+    size_t mask;
+    J *slots[];
+} JIndex;
+
+static size_t index_hash(const unsigned char *key)
+{
+    size_t hash = 0;
+    while (*key != '\0') {
+        hash = (hash * 31) + (size_t)tolower(*key++);
+    }
+    return hash;
+}
+
+static JIndex *index_of(const J *object)
+{
+    return ((object->type & 0xFF) == JObject) ? (JIndex *)object->valuestring : NULL;
+}
+
+static void index_discard(J *object)
+{
+    JIndex *index = index_of(object);
+    if (index != NULL) {
+        _Free(index);
+        object->valuestring = NULL;
+    }
+}
+
+static void index_build(J *object)
+{
+    size_t count = 0;
+    size_t slots = 2;
+    J *child = NULL;
+    JIndex *index = NULL;
+
+    for (child = object->child; child != NULL; child = child->next) {
+        if (++count > N_CJSON_INDEX_MAX_ITEMS) {
+            return;
+        }
+    }
+    while (slots < (count * 2)) {
+        slots *= 2;
+    }
+
+    index = (JIndex *)_Malloc(sizeof(JIndex) + (slots * sizeof(J *)));
+    if (index == NULL) {
+        return; /* searches continue to scan */
+    }
+    index->mask = slots - 1;
+    memset(index->slots, 0, slots * sizeof(J *));
+
+    for (child = object->child; child != NULL; child = child->next) {
+        size_t i;
+        if (child->string == NULL) {
+            continue;
+        }
+        for (i = index_hash((const unsigned char*)child->string) & index->mask; index->slots[i] != NULL; i = (i + 1) & index->mask) {
+            if (case_insensitive_strcmp((const unsigned char*)index->slots[i]->string, (const unsigned char*)child->string) == 0) {
+                break;
+            }
+        }
+        if (index->slots[i] == NULL) {
+            index->slots[i] = child;
+        }
+    }
+
+    object->valuestring = (char *)index;
+}
+
+static J *index_find(const JIndex *index, const char *name)
+{
+    size_t i;
+    for (i = index_hash((const unsigned char*)name) & index->mask; index->slots[i] != NULL; i = (i + 1) & index->mask) {
+        if (case_insensitive_strcmp((const unsigned char*)name, (const unsigned char*)index->slots[i]->string) == 0) {
+            return index->slots[i];
+        }
+    }
+    return NULL;
+}
+#else
+#define index_discard(object)
+#endif
+
+/* Delete a J structure.  Items in an arena are released all at once when its root is deleted, after
+ * anything that was allocated separately and added to the tree has been freed.  Rather than recursing,
+ * the children of each item are spliced in ahead of it, so that any depth is deleted in constant stack
+ * and every item is still freed after all of its children. */
 N_CJSON_PUBLIC(void) JDelete(J *item)
 {
     J *next = NULL;
     while (item != NULL) {
-        next = item->next;
         if (!(item->type & JIsReference) && (item->child != NULL)) {
-            JDelete(item->child);
+            J *last = item->child;
+            while (last->next != NULL) {
+                last = last->next;
+            }
+            last->next = item;
+            next = item->child;
+            item->child = NULL;
+            item = next;
+            continue;
         }
-        if (!(item->type & JIsReference) && (item->valuestring != NULL)) {
-            _Free(item->valuestring);
+        next = item->next;
+        if (!(item->type & (JIsReference|JIsArena)) && (item->type & (JString|JRaw)) && (item->valuestring != NULL)) {
+            item_free(item->valuestring);
         }
         if (!(item->type & JStringIsConst) && (item->string != NULL)) {
-            _Free(item->string);
+            item_free(item->string);
+        }
+        index_discard(item);
+        if (item->type & JIsArenaRoot) {
+            JArena *arena = (JArena *)((unsigned char *)item - ARENA_HEADER_SIZE);
+            arena_bytes_used -= arena->size + arena->text_size;
+            if (arena->text != NULL) {
+                _Free(arena->text);
+            }
+            _Free(arena);
+        } else if (!(item->type & JIsArena)) {
+            item_free(item);
         }
-        _Free(item);
         item = next;
     }
 }
@@ -220,6 +406,97 @@ typedef struct {
 /* get a pointer to the buffer at the position */
 #define buffer_at_offset(buffer) ((buffer)->content + (buffer)->offset)
 
+#ifndef N_CJSON_COMPACT
+/* Convert a number to an integer, truncating it and saturating in case of overflow. */
+static long int number_to_int(JNUMBER number)
+{
+#ifdef NOTE_FIXED
+    return (long int)(number / JNUMBER_SCALE);
+#else
+    if (number >= LONG_MAX) {
+        return LONG_MAX;
+    }
+    if (number <= LONG_MIN) {
+        return LONG_MIN;
+    }
+    return (long int)number;
+#endif
+}
+#endif
+
+/* Convert an integer to a number, which when fixed point saturates in case of overflow. */
+static JNUMBER number_from_int(long int integer)
+{
+#ifdef NOTE_FIXED
+    if (integer > (long int)(JNUMBER_MAX / JNUMBER_SCALE)) {
+        return JNUMBER_MAX;
+    }
+    if (integer < (long int)(JNUMBER_MIN / JNUMBER_SCALE)) {
+        return JNUMBER_MIN;
+    }
+    return (JNUMBER)integer * JNUMBER_SCALE;
+#else
+    return (JNUMBER)integer;
+#endif
+}
+
+/* Set an item's number, along with its saturated integer value if the item has room for one. */
+static void set_number(J * const item, JNUMBER number)
+{
+    item->valuenumber = number;
+#ifndef N_CJSON_COMPACT
+    item->valueint = number_to_int(number);
+#endif
+}
+
+/* Parse an integer that fits in 32 bits with integer arithmetic alone, keeping it exactly in valueint even when
+ * JNUMBER can't hold it.  Nearly every number from the Notecard is such an integer, so this saves a floating point
+ * conversion, which is costly on a part without an FPU.  Anything else is left to the general path. */
+static Jbool parse_integer(J * const item, parse_buffer * const input_buffer)
+{
+    const unsigned char *digits = buffer_at_offset(input_buffer);
+    size_t i = 0;
+    Jbool negative = false;
+    uint32_t limit = 0x7FFFFFFFUL;
+    uint32_t magnitude = 0;
+    long int number = 0;
+
+    if (can_access_at_index(input_buffer, 0) && (digits[0] == '-')) {
+        negative = true;
+        limit = 0x80000000UL;
+        i++;
+    }
+    if (cannot_access_at_index(input_buffer, i) || (digits[i] < '0') || (digits[i] > '9')) {
+        return false;
+    }
+    for (; can_access_at_index(input_buffer, i) && (digits[i] >= '0') && (digits[i] <= '9'); i++) {
+        uint32_t digit = (uint32_t)(digits[i] - '0');
+        if (magnitude > ((limit - digit) / 10)) {
+            return false; /* too large */
+        }
+        magnitude = (magnitude * 10) + digit;
+    }
+    if (can_access_at_index(input_buffer, i) && ((digits[i] == '.') || (digits[i] == 'e') || (digits[i] == 'E'))) {
+        return false; /* not an integer */
+    }
+
+    if (!negative) {
+        number = (long int)magnitude;
+    } else if (magnitude == 0x80000000UL) {
+        number = -0x7FFFFFFFL - 1;
+    } else {
+        number = -(long int)magnitude;
+    }
+    item->valuenumber = number_from_int(number);
+#ifndef N_CJSON_COMPACT
+    item->valueint = number;
+#endif
+    item->type = JNumber;
+
+    input_buffer->offset += i;
+    return true;
+}
+
 /* Parse the input text to generate a number, and populate the result into item. */
 static Jbool parse_number(J * const item, parse_buffer * const input_buffer)
 {
@@ -233,6 +510,10 @@ static Jbool parse_number(J * const item, parse_buffer * const input_buffer)
         return false;
     }
 
+    if (parse_integer(item, input_buffer)) {
+        return true;
+    }
+
     /* copy the number into a temporary buffer and replace '.' with the decimal point
      * of the current locale (for strtod)
      * This also takes care of '\0' not necessarily being available for marking the end of the input */
@@ -276,17 +557,7 @@ loop_end:
         return false; /* parse_error */
     }
 
-    item->valuenumber = number;
-
-    /* use saturation in case of overflow */
-    if (number >= LONG_MAX) {
-        item->valueint = LONG_MAX;
-    } else if (number <= LONG_MIN) {
-        item->valueint = LONG_MIN;
-    } else {
-        item->valueint = (long int)number;
-    }
-
+    set_number(item, number);
     item->type = JNumber;
 
     input_buffer->offset += (size_t)(after_end - number_c_string);
@@ -299,15 +570,24 @@ N_CJSON_PUBLIC(JNUMBER) JSetNumberHelper(J *object, JNUMBER number)
     if (object == NULL) {
         return number;
     }
-    if (number >= LONG_MAX) {
-        object->valueint = LONG_MAX;
-    } else if (number <= LONG_MIN) {
-        object->valueint = LONG_MIN;
-    } else {
-        object->valueint = (long int)number;
-    }
+    set_number(object, number);
+    return object->valuenumber;
+}
 
-    return object->valuenumber = number;
+/* helper for the JSetIntValue macro where numbers are fixed point, which keeps the integer exactly in valueint as
+ * JCreateInteger does, saturating only the number that it scales into valuenumber */
+N_CJSON_PUBLIC(long int) JSetIntHelper(J *object, long int number)
+{
+    if (object == NULL) {
+        return number;
+    }
+    object->valuenumber = number_from_int(number);
+#ifndef N_CJSON_COMPACT
+    object->valueint = number;
+#elif defined(NOTE_FIXED)
+    return (long int)(object->valuenumber / JNUMBER_SCALE);
+#endif
+    return number;
 }
 
 typedef struct {
@@ -317,9 +597,12 @@ typedef struct {
     size_t depth; /* current nesting depth (for formatted printing) */
     Jbool noalloc;
     Jbool format; /* is this print a formatted print */
+    JPrintSinkFn sink; /* if set, the buffer is a window that is drained here whenever it fills */
+    void *sink_context;
+    size_t *measured; /* if set, text that is already sized is only counted here, and the buffer is never kept */
 } printbuffer;
 
-/* realloc printbuffer if necessary to have at least "needed" bytes more */
+/* realloc printbuffer if necessary to have at least "needed" bytes more, plus the '\0' that follows them */
 static unsigned char* ensure(printbuffer * const p, size_t needed)
 {
     unsigned char *newbuffer = NULL;
@@ -344,6 +627,18 @@ static unsigned char* ensure(printbuffer * const p, size_t needed)
         return p->buffer + p->offset;
     }
 
+    /* when printing to a sink, drain the window and reuse it rather than growing it */
+    if (p->sink != NULL) {
+        if (p->offset > 0) {
+            if (!p->sink(p->sink_context, (const char *) p->buffer, p->offset)) {
+                return NULL;
+            }
+            needed -= p->offset;
+            p->offset = 0;
+        }
+        return (needed <= p->length) ? p->buffer : NULL;
+    }
+
     if (p->noalloc) {
         return NULL;
     }
@@ -391,6 +686,66 @@ static void update_offset(printbuffer * const buffer)
     buffer->offset += strlen((const char*)buffer_pointer);
 }
 
+/* Determine whether a number is an integer that fits in 32 bits, and so can be printed exactly without floating
+ * point.  The integer is taken from valueint where there is one, which when it isn't saturated holds an integer
+ * exactly even if JNUMBER can't. */
+static Jbool number_is_integer(const J * const item, long int *integer)
+{
+    JNUMBER d = item->valuenumber;
+#ifndef N_CJSON_COMPACT
+    long int n = item->valueint;
+    if ((n == LONG_MAX) || (n == LONG_MIN) || (n > 0x7FFFFFFFL) || (n < -0x7FFFFFFFL - 1) || (number_from_int(n) != d)) {
+        return false;
+    }
+#elif defined(NOTE_FIXED)
+    long int n = (long int)(d / JNUMBER_SCALE);
+    if ((d % JNUMBER_SCALE) != 0) {
+        return false;
+    }
+#else
+    long int n;
+    if (!((d >= (JNUMBER)(-0x7FFFFFFFL - 1)) && (d < (JNUMBER)0x7FFFFFFFL))) {
+        return false; /* also rules out NaN */
+    }
+    n = (long int)d;
+    if ((JNUMBER)n != d) {
+        return false;
+    }
+#endif
+    *integer = n;
+    return true;
+}
+
+/* Print a sign and 32-bit magnitude with integer arithmetic alone, returning its length */
+static int print_digits(uint32_t magnitude, Jbool negative, unsigned char *output)
+{
+    unsigned char digits[10];
+    int count = 0;
+    int length = 0;
+
+    do {
+        digits[count++] = (unsigned char)('0' + (magnitude % 10));
+        magnitude /= 10;
+    } while (magnitude != 0);
+
+    if (negative) {
+        output[length++] = '-';
+    }
+    while (count > 0) {
+        output[length++] = digits[--count];
+    }
+    output[length] = '\0';
+
+    return length;
+}
+
+/* Print an integer that fits in 32 bits with integer arithmetic alone, returning its length */
+static int print_integer(long int number, unsigned char *output)
+{
+    uint32_t magnitude = (number < 0) ? ((uint32_t)0 - (uint32_t)number) : (uint32_t)number;
+    return print_digits(magnitude, (number < 0), output);
+}
+
 /* Render the number nicely from the given item into a string. */
 static Jbool print_number(const J * const item, printbuffer * const output_buffer)
 {
@@ -404,13 +759,16 @@ static Jbool print_number(const J * const item, printbuffer * const output_buffe
     size_t i = 0;
     unsigned char number_buffer[JNTOA_MAX]; /* temporary buffer to print the number into */
     unsigned char decimal_point = get_decimal_point();
+    long int integer = 0;
 
     if (output_buffer == NULL) {
         return false;
     }
 
-    /* This checks for NaN and Infinity */
-    if ((d * 0) != 0) {
+    if (number_is_integer(item, &integer)) {
+        length = print_integer(integer, number_buffer);
+    } else if ((d * 0) != 0) {
+        /* This checks for NaN and Infinity */
         char *nbuf = (char *) number_buffer;
         strcpy(nbuf, "null");
         length = strlen(nbuf);
@@ -438,7 +796,7 @@ static Jbool print_number(const J * const item, printbuffer * const output_buffe
     }
 
     /* reserve appropriate space in the output */
-    output_pointer = ensure(output_buffer, (size_t)length + sizeof(""));
+    output_pointer = ensure(output_buffer, (size_t)length);
     if (output_pointer == NULL) {
         return false;
     }
@@ -588,48 +946,13 @@ fail:
     return 0;
 }
 
-/* Parse the input text into an unescaped cinput, and populate item. */
-static Jbool parse_string(J * const item, parse_buffer * const input_buffer)
+/* Unescape a string literal (without its quotes) into output, which must have room for the
+ * literal's length plus a trailing '\0', and which may be the input itself. Returns the end of the output, or NULL on a bad escape
+ * sequence, in which case input_pointer is left at the offending sequence. */
+static unsigned char *unescape_string(const unsigned char **input, const unsigned char * const input_end, unsigned char *output_pointer)
 {
-    const unsigned char *input_pointer = buffer_at_offset(input_buffer) + 1;
-    const unsigned char *input_end = buffer_at_offset(input_buffer) + 1;
-    unsigned char *output_pointer = NULL;
-    unsigned char *output = NULL;
-
-    /* not a string */
-    if (buffer_at_offset(input_buffer)[0] != '\"') {
-        goto fail;
-    }
-
-    {
-        /* calculate approximate size of the output (overestimate) */
-        size_t allocation_length = 0;
-        size_t skipped_bytes = 0;
-        while (((size_t)(input_end - input_buffer->content) < input_buffer->length) && (*input_end != '\"')) {
-            /* is escape sequence */
-            if (input_end[0] == '\\') {
-                if ((size_t)(input_end + 1 - input_buffer->content) >= input_buffer->length) {
-                    /* prevent buffer overflow when last input character is a backslash */
-                    goto fail;
-                }
-                skipped_bytes++;
-                input_end++;
-            }
-            input_end++;
-        }
-        if (((size_t)(input_end - input_buffer->content) >= input_buffer->length) || (*input_end != '\"')) {
-            goto fail; /* string ended unexpectedly */
-        }
-
-        /* This is at most how much we need for the output */
-        allocation_length = (size_t) (input_end - buffer_at_offset(input_buffer)) - skipped_bytes;
-        output = (unsigned char*)_Malloc(allocation_length + 1);  // trailing '\0'
-        if (output == NULL) {
-            goto fail; /* allocation failure */
-        }
-    }
+    const unsigned char *input_pointer = *input;
 
-    output_pointer = output;
     /* loop through the string literal */
     while (input_pointer < input_end) {
         if (*input_pointer != '\\') {
@@ -680,6 +1003,65 @@ static Jbool parse_string(J * const item, parse_buffer * const input_buffer)
         }
     }
 
+    *input = input_pointer;
+    return output_pointer;
+
+fail:
+    *input = input_pointer;
+    return NULL;
+}
+
+/* Parse the input text into an unescaped cinput, and populate item. */
+static Jbool parse_string(J * const item, parse_buffer * const input_buffer)
+{
+    const unsigned char *input_pointer = buffer_at_offset(input_buffer) + 1;
+    const unsigned char *input_end = buffer_at_offset(input_buffer) + 1;
+    unsigned char *output_pointer = NULL;
+    unsigned char *output = NULL;
+
+    /* not a string */
+    if (buffer_at_offset(input_buffer)[0] != '\"') {
+        goto fail;
+    }
+
+    {
+        /* calculate approximate size of the output (overestimate) */
+        size_t allocation_length = 0;
+        size_t skipped_bytes = 0;
+        while (((size_t)(input_end - input_buffer->content) < input_buffer->length) && (*input_end != '\"')) {
+            /* is escape sequence */
+            if (input_end[0] == '\\') {
+                if ((size_t)(input_end + 1 - input_buffer->content) >= input_buffer->length) {
+                    /* prevent buffer overflow when last input character is a backslash */
+                    goto fail;
+                }
+                skipped_bytes++;
+                input_end++;
+            }
+            input_end++;
+        }
+        if (((size_t)(input_end - input_buffer->content) >= input_buffer->length) || (*input_end != '\"')) {
+            goto fail; /* string ended unexpectedly */
+        }
+
+        /* This is at most how much we need for the output */
+        allocation_length = (size_t) (input_end - buffer_at_offset(input_buffer)) - skipped_bytes;
+        if ((parse_arena != NULL) && (parse_arena->text != NULL)) {
+            /* unescaping never lengthens a string, so it can be done in place, ending on the closing quote */
+            output = (unsigned char*)cast_away_const(input_pointer);
+        } else {
+            output = parse_alloc_string(allocation_length + 1);  // trailing '\0'
+        }
+        if (output == NULL) {
+            goto fail; /* allocation failure */
+        }
+    }
+
+    output_pointer = unescape_string(&input_pointer, input_end, output);
+    if (output_pointer == NULL) {
+        goto fail;
+    }
+
     /* zero terminate the output */
     *output_pointer = '\0';
 
@@ -693,7 +1075,7 @@ static Jbool parse_string(J * const item, parse_buffer * const input_buffer)
 
 fail:
     if (output != NULL) {
-        _Free(output);
+        item_free(output);
     }
 
     if (input_pointer != NULL) {
@@ -719,7 +1101,77 @@ void htoa16(uint16_t n, unsigned char *p)
     *p = '\0';
 }
 
-/* Render the cstring provided to an escaped version that can be printed. */
+/* Write the escape sequence for a character that can't appear literally within a string, returning its length. */
+static size_t print_escape(const unsigned char c, unsigned char * const output_pointer)
+{
+    output_pointer[0] = '\\';
+    switch (c) {
+    case '\\':
+        output_pointer[1] = '\\';
+        break;
+    case '\"':
+        output_pointer[1] = '\"';
+        break;
+    case '\b':
+        output_pointer[1] = 'b';
+        break;
+    case '\f':
+        output_pointer[1] = 'f';
+        break;
+    case '\n':
+        output_pointer[1] = 'n';
+        break;
+    case '\r':
+        output_pointer[1] = 'r';
+        break;
+    case '\t':
+        output_pointer[1] = 't';
+        break;
+    default:
+        /* escape and print as unicode codepoint */
+        output_pointer[1] = 'u';
+        htoa16(c, &output_pointer[2]);
+        return 6;
+    }
+    return 2;
+}
+
+/* Render a cstring that is too long to fit within a sink's window, a character at a time. */
+static Jbool print_string_windowed(const unsigned char * const input, printbuffer * const output_buffer)
+{
+    const unsigned char *input_pointer = NULL;
+    unsigned char *output_pointer = ensure(output_buffer, 1);
+
+    if (output_pointer == NULL) {
+        return false;
+    }
+    *output_pointer = '\"';
+    output_buffer->offset++;
+
+    for (input_pointer = input; *input_pointer != '\0'; input_pointer++) {
+        output_pointer = ensure(output_buffer, 6);  // sizeof("\\uXXXX")
+        if (output_pointer == NULL) {
+            return false;
+        }
+        if ((*input_pointer > 31) && (*input_pointer != '\"') && (*input_pointer != '\\')) {
+            *output_pointer = *input_pointer;
+            output_buffer->offset++;
+        } else {
+            output_buffer->offset += print_escape(*input_pointer, output_pointer);
+        }
+    }
+
+    output_pointer = ensure(output_buffer, 1);
+    if (output_pointer == NULL) {
+        return false;
+    }
+    output_pointer[0] = '\"';
+    output_pointer[1] = '\0';
+
+    return true;
+}
+
+/* Render the cstring provided to an escaped version that can be printed. */
 static Jbool print_string_ptr(const unsigned char * const input, printbuffer * const output_buffer)
 {
     const unsigned char *input_pointer = NULL;
@@ -769,6 +1221,22 @@ static Jbool print_string_ptr(const unsigned char * const input, printbuffer * c
     }
     output_length = (size_t)(input_pointer - input) + escape_characters;
 
+    /* when only measuring, there's no need to render it */
+    if (output_buffer->measured != NULL) {
+        output = ensure(output_buffer, 0);
+        if (output == NULL) {
+            return false;
+        }
+        *output = '\0';
+        *output_buffer->measured += output_length + 2;  // sizeof("\"\"")
+        return true;
+    }
+
+    /* a string longer than a sink's window is passed through it piecemeal */
+    if ((output_buffer->sink != NULL) && ((output_length + 3) > output_buffer->length)) {
+        return print_string_windowed(input, output_buffer);
+    }
+
     output = ensure(output_buffer, output_length + 2);  // sizeof("\"\"")
     if (output == NULL) {
         return false;
@@ -787,42 +1255,13 @@ static Jbool print_string_ptr(const unsigned char * const input, printbuffer * c
     output[0] = '\"';
     output_pointer = output + 1;
     /* copy the string */
-    for (input_pointer = input; *input_pointer != '\0'; (void)input_pointer++, output_pointer++) {
+    for (input_pointer = input; *input_pointer != '\0'; input_pointer++) {
         if ((*input_pointer > 31) && (*input_pointer != '\"') && (*input_pointer != '\\')) {
             /* normal character, copy */
-            *output_pointer = *input_pointer;
+            *output_pointer++ = *input_pointer;
         } else {
             /* character needs to be escaped */
-            *output_pointer++ = '\\';
-            switch (*input_pointer) {
-            case '\\':
-                *output_pointer = '\\';
-                break;
-            case '\"':
-                *output_pointer = '\"';
-                break;
-            case '\b':
-                *output_pointer = 'b';
-                break;
-            case '\f':
-                *output_pointer = 'f';
-                break;
-            case '\n':
-                *output_pointer = 'n';
-                break;
-            case '\r':
-                *output_pointer = 'r';
-                break;
-            case '\t':
-                *output_pointer = 't';
-                break;
-            default:
-                /* escape and print as unicode codepoint */
-                *output_pointer++ = 'u';
-                htoa16(*input_pointer, output_pointer);
-                output_pointer += 4;
-                break;
-            }
+            output_pointer += print_escape(*input_pointer, output_pointer);
         }
     }
     output[output_length + 1] = '\"';
@@ -840,10 +1279,6 @@ static Jbool print_string(const J * const item, printbuffer * const p)
 /* Predeclare these prototypes. */
 static Jbool parse_value(J * const item, parse_buffer * const input_buffer);
 static Jbool print_value(const J * const item, printbuffer * const output_buffer);
-static Jbool parse_array(J * const item, parse_buffer * const input_buffer);
-static Jbool print_array(const J * const item, printbuffer * const output_buffer);
-static Jbool parse_object(J * const item, parse_buffer * const input_buffer);
-static Jbool print_object(const J * const item, printbuffer * const output_buffer);
 
 /* Utility to jump whitespace and cr/lf */
 static parse_buffer *buffer_skip_whitespace(parse_buffer * const buffer)
@@ -950,242 +1385,1182 @@ N_CJSON_PUBLIC(J *) JParse(const char *value)
     return JParseWithOpts(value, 0, 0);
 }
 
-#define cjson_min(a, b) ((a < b) ? a : b)
-
-static unsigned char *print(const J * const item, Jbool format)
+/* Mark every item parsed into an arena as belonging to it, noting that keys are marked constant
+ * because they are owned by the arena, and are only freed if replaced.  The items lie one after
+ * another at the start of the arena, so there's no need to walk the tree to find them. */
+static void arena_mark(JArena *arena)
 {
-    static const size_t default_buffer_size = 128;
-    printbuffer buffer[1];
-    unsigned char *printed = NULL;
+    unsigned char *node;
+    for (node = (unsigned char *)arena + ARENA_HEADER_SIZE; node < arena->nodes; node += sizeof(J)) {
+        ((J *)node)->type |= JIsArena | JStringIsConst;
+    }
+}
 
-    memset(buffer, 0, sizeof(buffer));
+/* Parse into an arena, adopting the text and leaving strings in it if it is given */
+static J *parse_into_arena(const char *value, unsigned char *text)
+{
+    const unsigned char *p = (const unsigned char *)value;
+    size_t nodes = 1;
+    size_t strings = 0;
+    size_t size = 0;
+    JArena *arena = NULL;
+    J *item = NULL;
 
-    /* create buffer */
-    buffer->buffer = (unsigned char*) _Malloc(default_buffer_size);
-    buffer->length = default_buffer_size;
-    buffer->format = format;
-    if (buffer->buffer == NULL) {
-        goto fail;
+    if (value == NULL) {
+        return NULL;
     }
 
-    /* print the value */
-    if (!print_value(item, buffer)) {
-        goto fail;
+    /* Size the arena by scanning the text.  Every value but the first follows a comma or opens an
+     * array or object, and parse_string allocates each string's escaped length plus two unless
+     * it is parsing in place. */
+    while (*p != '\0') {
+        if (*p == '\"') {
+            for (p++; (*p != '\0') && (*p != '\"'); p++, strings++) {
+                if ((*p == '\\') && (p[1] != '\0')) {
+                    p++;
+                    strings++;
+                }
+            }
+            strings += 2;
+            if (*p == '\0') {
+                break;
+            }
+        } else if ((*p == ',') || (*p == '[') || (*p == '{')) {
+            nodes++;
+        }
+        p++;
     }
-    update_offset(buffer);
-
-    /* copy the JSON over to a new buffer */
-    printed = (unsigned char*) _Malloc(buffer->offset + 1);
-    if (printed == NULL) {
-        goto fail;
+    if (text != NULL) {
+        strings = 0;
     }
-    memcpy(printed, buffer->buffer, cjson_min(buffer->length, buffer->offset + 1));
-    printed[buffer->offset] = '\0'; /* just to be sure */
+    size = ARENA_HEADER_SIZE + (nodes * sizeof(J)) + strings;
 
-    /* free the buffer */
-    _Free(buffer->buffer);
-
-    return printed;
+    arena = (JArena *)_Malloc(size);
+    if (arena == NULL) {
+        return NULL;
+    }
+    arena->size = size;
+    arena->nodes = (unsigned char *)arena + ARENA_HEADER_SIZE;
+    arena->strings = (unsigned char *)arena + size;
+    arena->text = text;
+    arena->text_size = (text == NULL) ? 0 : strlen(value) + 1;
 
-fail:
-    if (buffer->buffer != NULL) {
-        _Free(buffer->buffer);
+    /* Parse into the arena, which if parsing fails is simply freed along with everything in it */
+    parse_arena = arena;
+    item = JParse(value);
+    parse_arena = NULL;
+    if (item == NULL) {
+        _Free(arena);
+        return NULL;
     }
 
-    if (printed != NULL) {
-        _Free(printed);
+    arena_mark(arena);
+    item->type |= JIsArenaRoot;
+    arena_bytes_used += size + arena->text_size;
+    if (arena_bytes_used > arena_bytes_high) {
+        arena_bytes_high = arena_bytes_used;
     }
 
-    return NULL;
+    return item;
 }
 
-/* Render a J item/entity/structure to text. */
-N_CJSON_PUBLIC(char *) JPrint(const J *item)
+N_CJSON_PUBLIC(J *) JParseArena(const char *value)
 {
-    if (item == NULL) {
-        return (char *)"";
-    }
-    return (char*)print(item, true);
+    return parse_into_arena(value, NULL);
 }
 
-N_CJSON_PUBLIC(char *) JPrintUnformatted(const J *item)
+N_CJSON_PUBLIC(J *) JParseInSitu(char *value)
 {
-    if (item == NULL) {
-        return (char *)"";
-    }
-    return (char*)print(item, false);
+    return parse_into_arena(value, (unsigned char *)value);
 }
 
-N_CJSON_PUBLIC(char *) JPrintBuffered(const J *item, int prebuffer, Jbool fmt)
+N_CJSON_PUBLIC(void) JArenaStats(size_t *used, size_t *high_water)
 {
-    printbuffer p = { 0, 0, 0, 0, 0, 0 };
-
-    if (item == NULL) {
-        return (char *)"";
+    if (used != NULL) {
+        *used = arena_bytes_used;
     }
-
-    if (prebuffer < 0) {
-        return NULL;
+    if (high_water != NULL) {
+        *high_water = arena_bytes_high;
     }
+}
 
-    p.buffer = (unsigned char*)_Malloc((size_t)prebuffer);
-    if (!p.buffer) {
-        return NULL;
+/* Incremental parser states */
+#define JSTREAM_VALUE           0   /* expecting a value */
+#define JSTREAM_FIRST_VALUE     1   /* expecting a value or the end of an empty array */
+#define JSTREAM_KEY             2   /* expecting the name of an object member */
+#define JSTREAM_FIRST_KEY       3   /* expecting a name or the end of an empty object */
+#define JSTREAM_COLON           4   /* expecting the separator after a name */
+#define JSTREAM_NEXT            5   /* expecting a comma or the end of the enclosing array/object */
+#define JSTREAM_STRING          6   /* inside a string */
+#define JSTREAM_NUMBER          7   /* inside a number */
+#define JSTREAM_LITERAL         8   /* inside true, false or null */
+#define JSTREAM_DONE            9   /* the top-level value is complete */
+#define JSTREAM_ERROR           10  /* the input is malformed, or memory ran out */
+
+struct JStream {
+    J *root;
+    /* the arrays/objects being populated, and their most recently added children */
+    J *container[N_CJSON_STREAM_NESTING_LIMIT];
+    J *tail[N_CJSON_STREAM_NESTING_LIMIT];
+    size_t depth;
+    /* the name of the object member whose value is being parsed */
+    char *key;
+    /* text of the string, number or literal that is being accumulated */
+    unsigned char *token;
+    size_t token_length;
+    size_t token_alloc;
+    unsigned char state;
+    Jbool string_is_key;
+    Jbool escaped;
+};
+
+/* Append a byte to the token being accumulated, leaving room for a trailing '\0' */
+static Jbool stream_token_append(JStream * const stream, unsigned char c)
+{
+    if ((stream->token_length + 1) >= stream->token_alloc) {
+        size_t newsize = (stream->token_alloc == 0) ? 32 : (stream->token_alloc * 2);
+        unsigned char *newtoken = (unsigned char *) _Realloc(stream->token, stream->token_alloc, newsize);
+        if (newtoken == NULL) {
+            return false;
+        }
+        stream->token = newtoken;
+        stream->token_alloc = newsize;
     }
+    stream->token[stream->token_length++] = c;
+    return true;
+}
 
-    p.length = (size_t)prebuffer;
-    p.offset = 0;
-    p.noalloc = false;
-    p.format = fmt;
+/* Attach a newly-parsed value to the array/object being populated, or make it the root */
+static Jbool stream_add_value(JStream * const stream, J * const item)
+{
+    J *parent = NULL;
 
-    if (!print_value(item, &p)) {
-        _Free(p.buffer);
-        return NULL;
+    if (stream->depth == 0) {
+        stream->root = item;
+        return true;
     }
 
-    return (char*)p.buffer;
+    parent = stream->container[stream->depth-1];
+    if ((parent->type & 0xFF) == JObject) {
+        item->string = stream->key;
+        stream->key = NULL;
+    }
+    if (stream->tail[stream->depth-1] == NULL) {
+        parent->child = item;
+    } else {
+        suffix_object(stream->tail[stream->depth-1], item);
+    }
+    stream->tail[stream->depth-1] = item;
+
+    return true;
 }
 
-N_CJSON_PUBLIC(Jbool) JPrintPreallocated(J *item, char *buf, const int len, const Jbool fmt)
+/* Begin populating a new array or object */
+static Jbool stream_open(JStream * const stream, int type)
 {
-    printbuffer p = { 0, 0, 0, 0, 0, 0 };
+    J *item = NULL;
 
-    if (item == NULL) {
-        return false;
+    if (stream->depth >= N_CJSON_STREAM_NESTING_LIMIT) {
+        return false; /* too deeply nested */
     }
-    if ((len < 0) || (buf == NULL)) {
+    item = JNew_Item();
+    if (item == NULL) {
         return false;
     }
+    item->type = type;
+    stream_add_value(stream, item);
 
-    p.buffer = (unsigned char*)buf;
-    p.length = (size_t)len;
-    p.offset = 0;
-    p.noalloc = true;
-    p.format = fmt;
+    stream->container[stream->depth] = item;
+    stream->tail[stream->depth] = NULL;
+    stream->depth++;
+    stream->state = (type == JObject) ? JSTREAM_FIRST_KEY : JSTREAM_FIRST_VALUE;
 
-    return print_value(item, &p);
+    return true;
 }
 
-/* Parser core - when encountering text, process appropriately. */
-static Jbool parse_value(J * const item, parse_buffer * const input_buffer)
+/* Finish the array or object being populated, if it is of the given type */
+static Jbool stream_close(JStream * const stream, int type)
 {
-    if (item == NULL) {
+    if ((stream->depth == 0) || ((stream->container[stream->depth-1]->type & 0xFF) != type)) {
         return false;
     }
-    if ((input_buffer == NULL) || (input_buffer->content == NULL)) {
-        return false; /* no input */
-    }
+    stream->depth--;
+    stream->state = (stream->depth == 0) ? JSTREAM_DONE : JSTREAM_NEXT;
+    return true;
+}
 
-    /* parse the different types of values */
-    /* null */
-    if (can_read(input_buffer, 4) && (strncmp((const char*)buffer_at_offset(input_buffer), c_null, c_null_len) == 0)) {
-        item->type = JNULL;
-        input_buffer->offset += 4;
-        return true;
-    }
-    /* false */
-    if (can_read(input_buffer, 5) && (strncmp((const char*)buffer_at_offset(input_buffer), c_false, c_false_len) == 0)) {
-        item->type = JFalse;
-        input_buffer->offset += 5;
-        return true;
-    }
-    /* true */
-    if (can_read(input_buffer, 4) && (strncmp((const char*)buffer_at_offset(input_buffer), c_true, c_true_len) == 0)) {
-        item->type = JTrue;
-        item->valueint = 1;
-        input_buffer->offset += 4;
-        return true;
-    }
-    /* string */
-    if (can_access_at_index(input_buffer, 0) && (buffer_at_offset(input_buffer)[0] == '\"')) {
-        return parse_string(item, input_buffer);
-    }
-    /* number */
-    if (can_access_at_index(input_buffer, 0) && ((buffer_at_offset(input_buffer)[0] == '-') || ((buffer_at_offset(input_buffer)[0] >= '0') && (buffer_at_offset(input_buffer)[0] <= '9')))) {
-        return parse_number(item, input_buffer);
-    }
-    /* array */
-    if (can_access_at_index(input_buffer, 0) && (buffer_at_offset(input_buffer)[0] == '[')) {
-        return parse_array(item, input_buffer);
+/* Unescape the accumulated string token and detach it as a newly-allocated string.  Escapes never
+   expand, so this is done in place; a token that outgrew the initial buffer is handed over rather
+   than copied, so that a long string is never held in memory twice, but is first shrunk to fit so
+   that the string doesn't keep the slack of the buffer's doubling for as long as it lives. */
+static char *stream_take_string(JStream * const stream)
+{
+    const unsigned char *input_pointer = stream->token;
+    unsigned char *output = NULL;
+    unsigned char *output_pointer = unescape_string(&input_pointer, stream->token + stream->token_length, stream->token);
+    size_t length = 0;
+
+    if (output_pointer == NULL) {
+        return NULL;
     }
-    /* object */
-    if (can_access_at_index(input_buffer, 0) && (buffer_at_offset(input_buffer)[0] == '{')) {
-        return parse_object(item, input_buffer);
+    *output_pointer = '\0';
+    length = (size_t) (output_pointer - stream->token);
+
+    if (stream->token_alloc > 32) {
+        output = stream->token;
+        if (stream->token_alloc > (length + 1)) {
+            unsigned char *shrunk = (unsigned char *) _Realloc(output, length + 1, length + 1);
+            if (shrunk != NULL) {
+                output = shrunk;
+            }
+        }
+        stream->token = NULL;
+        stream->token_alloc = 0;
+    } else {
+        output = (unsigned char *) _Malloc(length + 1);
+        if (output == NULL) {
+            return NULL;
+        }
+        memcpy(output, stream->token, length + 1);
     }
+    stream->token_length = 0;
 
-    return false;
+    return (char *) output;
 }
 
-/* Render a value to text. */
-static Jbool print_value(const J * const item, printbuffer * const output_buffer)
+/* Convert the accumulated token into a name or value */
+static Jbool stream_finish_token(JStream * const stream)
 {
-    unsigned char *output = NULL;
+    J *item = NULL;
+    unsigned char state = stream->state;
 
-    if ((item == NULL) || (output_buffer == NULL)) {
+    stream->state = JSTREAM_ERROR;
+
+    if (!stream_token_append(stream, '\0')) {
         return false;
     }
+    stream->token_length--;
 
-    switch ((item->type) & 0xFF) {
-    case JNULL:
-        output = ensure(output_buffer, c_null_len+1);
-        if (output == NULL) {
-            return false;
-        }
-        strcpy((char*)output, c_null);
-        return true;
-
-    case JFalse:
-        output = ensure(output_buffer, c_false_len+1);
-        if (output == NULL) {
-            return false;
-        }
-        strcpy((char*)output, c_false);
-        return true;
-
-    case JTrue:
-        output = ensure(output_buffer, c_true_len+1);
-        if (output == NULL) {
+    if ((state == JSTREAM_STRING) && stream->string_is_key) {
+        stream->key = stream_take_string(stream);
+        if (stream->key == NULL) {
             return false;
         }
-        strcpy((char*)output, c_true);
+        stream->state = JSTREAM_COLON;
         return true;
+    }
 
-    case JNumber:
-        return print_number(item, output_buffer);
+    item = JNew_Item();
+    if (item == NULL) {
+        return false;
+    }
 
-    case JRaw: {
-        size_t raw_length = 0;
+    if (state == JSTREAM_STRING) {
+        item->type = JString;
+        item->valuestring = stream_take_string(stream);
         if (item->valuestring == NULL) {
+            JDelete(item);
             return false;
         }
-
-        raw_length = strlen(item->valuestring) + 1;   // Trailing '\0';
-        output = ensure(output_buffer, raw_length);
-        if (output == NULL) {
+    } else if (state == JSTREAM_NUMBER) {
+        parse_buffer buffer = { 0, 0, 0, 0 };
+        buffer.content = stream->token;
+        buffer.length = stream->token_length;
+        if (!parse_number(item, &buffer) || (buffer.offset != buffer.length)) {
+            JDelete(item);
             return false;
         }
-        memcpy(output, item->valuestring, raw_length);
-        return true;
+    } else if ((stream->token_length == c_null_len) && (memcmp(stream->token, c_null, c_null_len) == 0)) {
+        item->type = JNULL;
+    } else if ((stream->token_length == c_false_len) && (memcmp(stream->token, c_false, c_false_len) == 0)) {
+        item->type = JFalse;
+    } else if ((stream->token_length == c_true_len) && (memcmp(stream->token, c_true, c_true_len) == 0)) {
+        item->type = JTrue;
+#ifndef N_CJSON_COMPACT
+        item->valueint = 1;
+#endif
+    } else {
+        JDelete(item);
+        return false;
     }
 
-    case JString:
-        return print_string(item, output_buffer);
-
-    case JArray:
-        return print_array(item, output_buffer);
-
-    case JObject:
-        return print_object(item, output_buffer);
+    stream_add_value(stream, item);
+    stream->token_length = 0;
+    stream->state = (stream->depth == 0) ? JSTREAM_DONE : JSTREAM_NEXT;
+    return true;
+}
 
-    default:
-        return false;
+/* Begin parsing a document that will be supplied in pieces as it arrives. */
+N_CJSON_PUBLIC(JStream *) JParseStreamBegin(void)
+{
+    JStream *stream = (JStream *) _Malloc(sizeof(JStream));
+    if (stream != NULL) {
+        memset(stream, 0, sizeof(JStream));
+        stream->state = JSTREAM_VALUE;
     }
+    return stream;
 }
 
-/* Build an array from input text. */
-static Jbool parse_array(J * const item, parse_buffer * const input_buffer)
+/* Parse the next piece of a document, building the tree as values are completed. */
+N_CJSON_PUBLIC(Jbool) JParseStreamFeed(JStream *stream, const char *data, size_t length)
 {
-    J *head = NULL; /* head of the linked list */
+    size_t i = 0;
+
+    if ((stream == NULL) || (data == NULL)) {
+        return false;
+    }
+
+    for (i = 0; i < length; i++) {
+        unsigned char c = (unsigned char) data[i];
+
+        switch (stream->state) {
+
+        case JSTREAM_STRING:
+            if (stream->escaped) {
+                stream->escaped = false;
+            } else if (c == '\\') {
+                stream->escaped = true;
+            } else if (c == '\"') {
+                if (!stream_finish_token(stream)) {
+                    return false;
+                }
+                continue;
+            }
+            if (!stream_token_append(stream, c)) {
+                stream->state = JSTREAM_ERROR;
+                return false;
+            }
+            continue;
+
+        case JSTREAM_NUMBER:
+            if (((c >= '0') && (c <= '9')) || (c == '+') || (c == '-') || (c == '.') || (c == 'e') || (c == 'E')) {
+                if (!stream_token_append(stream, c)) {
+                    stream->state = JSTREAM_ERROR;
+                    return false;
+                }
+                continue;
+            }
+            if (!stream_finish_token(stream)) {
+                return false;
+            }
+            break; /* this character follows the number */
+
+        case JSTREAM_LITERAL:
+            if ((c >= 'a') && (c <= 'z')) {
+                if (!stream_token_append(stream, c)) {
+                    stream->state = JSTREAM_ERROR;
+                    return false;
+                }
+                continue;
+            }
+            if (!stream_finish_token(stream)) {
+                return false;
+            }
+            break; /* this character follows the literal */
+
+        case JSTREAM_ERROR:
+            return false;
+
+        default:
+            break;
+        }
+
+        /* whitespace and cr/lf between tokens */
+        if (c <= 32) {
+            continue;
+        }
+
+        switch (stream->state) {
+
+        case JSTREAM_FIRST_VALUE:
+            if (c == ']') {
+                if (!stream_close(stream, JArray)) {
+                    stream->state = JSTREAM_ERROR;
+                }
+                break;
+            }
+        /* fall through */
+        case JSTREAM_VALUE:
+            if (c == '{') {
+                if (!stream_open(stream, JObject)) {
+                    stream->state = JSTREAM_ERROR;
+                }
+            } else if (c == '[') {
+                if (!stream_open(stream, JArray)) {
+                    stream->state = JSTREAM_ERROR;
+                }
+            } else if (c == '\"') {
+                stream->state = JSTREAM_STRING;
+                stream->string_is_key = false;
+            } else if ((c == '-') || ((c >= '0') && (c <= '9'))) {
+                stream->state = JSTREAM_NUMBER;
+                if (!stream_token_append(stream, c)) {
+                    stream->state = JSTREAM_ERROR;
+                }
+            } else if ((c == 't') || (c == 'f') || (c == 'n')) {
+                stream->state = JSTREAM_LITERAL;
+                if (!stream_token_append(stream, c)) {
+                    stream->state = JSTREAM_ERROR;
+                }
+            } else {
+                stream->state = JSTREAM_ERROR;
+            }
+            break;
+
+        case JSTREAM_FIRST_KEY:
+            if (c == '}') {
+                if (!stream_close(stream, JObject)) {
+                    stream->state = JSTREAM_ERROR;
+                }
+                break;
+            }
+        /* fall through */
+        case JSTREAM_KEY:
+            if (c == '\"') {
+                stream->state = JSTREAM_STRING;
+                stream->string_is_key = true;
+            } else {
+                stream->state = JSTREAM_ERROR;
+            }
+            break;
+
+        case JSTREAM_COLON:
+            stream->state = (c == ':') ? JSTREAM_VALUE : JSTREAM_ERROR;
+            break;
+
+        case JSTREAM_NEXT:
+            if (c == ',') {
+                stream->state = ((stream->container[stream->depth-1]->type & 0xFF) == JObject) ? JSTREAM_KEY : JSTREAM_VALUE;
+            } else if (c == '}') {
+                if (!stream_close(stream, JObject)) {
+                    stream->state = JSTREAM_ERROR;
+                }
+            } else if (c == ']') {
+                if (!stream_close(stream, JArray)) {
+                    stream->state = JSTREAM_ERROR;
+                }
+            } else {
+                stream->state = JSTREAM_ERROR;
+            }
+            break;
+
+        case JSTREAM_DONE:
+        default:
+            /* as with JParse, anything that follows the value is ignored */
+            break;
+        }
+
+        if (stream->state == JSTREAM_ERROR) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/* Finish parsing, returning the document if it was complete and well-formed. The stream is freed. */
+N_CJSON_PUBLIC(J *) JParseStreamEnd(JStream *stream)
+{
+    J *item = NULL;
+
+    if (stream == NULL) {
+        return NULL;
+    }
+
+    /* a top-level number or literal is only terminated by the end of the input */
+    if ((stream->state == JSTREAM_NUMBER) || (stream->state == JSTREAM_LITERAL)) {
+        stream_finish_token(stream);
+    }
+
+    if (stream->state == JSTREAM_DONE) {
+        item = stream->root;
+    } else if (stream->root != NULL) {
+        JDelete(stream->root);
+    }
+
+    if (stream->key != NULL) {
+        _Free(stream->key);
+    }
+    if (stream->token != NULL) {
+        _Free(stream->token);
+    }
+    _Free(stream);
+
+    return item;
+}
+
+#define cjson_min(a, b) ((a < b) ? a : b)
+
+/* a sink that discards the text, only counting its length */
+static Jbool count_printed(void *context, const char *data, size_t length)
+{
+    (void)data;
+    *(size_t *)context += length;
+    return true;
+}
+
+/* measure the length of the text that an item renders to, by printing it through a small window that is never kept */
+static Jbool print_length(const J * const item, Jbool format, size_t *length)
+{
+    unsigned char window[N_CJSON_PRINT_WINDOW_MIN];
+    printbuffer buffer[1];
+
+    memset(buffer, 0, sizeof(buffer));
+    buffer->buffer = window;
+    buffer->length = sizeof(window);
+    buffer->noalloc = true;
+    buffer->format = format;
+    buffer->sink = count_printed;
+    buffer->sink_context = length;
+    buffer->measured = length;
+
+    *length = 0;
+    if (!print_value(item, buffer)) {
+        return false;
+    }
+    update_offset(buffer);
+    *length += buffer->offset;
+
+    return true;
+}
+
+/* render an item into a single allocation of exactly the right size, measured beforehand */
+static unsigned char *print(const J * const item, Jbool format)
+{
+    printbuffer buffer[1];
+    size_t length = 0;
+
+    if (!print_length(item, format, &length)) {
+        return NULL;
+    }
+
+    memset(buffer, 0, sizeof(buffer));
+    buffer->buffer = (unsigned char*) _Malloc(length + 1);
+    buffer->length = length + 1;
+    buffer->noalloc = true;
+    buffer->format = format;
+    if (buffer->buffer == NULL) {
+        return NULL;
+    }
+
+    if (!print_value(item, buffer)) {
+        _Free(buffer->buffer);
+        return NULL;
+    }
+
+    return buffer->buffer;
+}
+
+/* Render a J item/entity/structure to text. */
+N_CJSON_PUBLIC(char *) JPrint(const J *item)
+{
+    if (item == NULL) {
+        return (char *)"";
+    }
+    return (char*)print(item, true);
+}
+
+N_CJSON_PUBLIC(char *) JPrintUnformatted(const J *item)
+{
+    if (item == NULL) {
+        return (char *)"";
+    }
+    return (char*)print(item, false);
+}
+
+N_CJSON_PUBLIC(size_t) JPrintLength(const J *item, Jbool fmt)
+{
+    size_t length = 0;
+
+    if ((item == NULL) || !print_length(item, fmt, &length)) {
+        return 0;
+    }
+    return length;
+}
+
+N_CJSON_PUBLIC(char *) JPrintBuffered(const J *item, int prebuffer, Jbool fmt)
+{
+    printbuffer p = { 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+
+    if (item == NULL) {
+        return (char *)"";
+    }
+
+    if (prebuffer < 0) {
+        return NULL;
+    }
+
+    p.buffer = (unsigned char*)_Malloc((size_t)prebuffer);
+    if (!p.buffer) {
+        return NULL;
+    }
+
+    p.length = (size_t)prebuffer;
+    p.offset = 0;
+    p.noalloc = false;
+    p.format = fmt;
+
+    if (!print_value(item, &p)) {
+        _Free(p.buffer);
+        return NULL;
+    }
+
+    return (char*)p.buffer;
+}
+
+N_CJSON_PUBLIC(Jbool) JPrintPreallocated(J *item, char *buf, const int len, const Jbool fmt)
+{
+    printbuffer p = { 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+
+    if (item == NULL) {
+        return false;
+    }
+    if ((len < 0) || (buf == NULL)) {
+        return false;
+    }
+
+    p.buffer = (unsigned char*)buf;
+    p.length = (size_t)len;
+    p.offset = 0;
+    p.noalloc = true;
+    p.format = fmt;
+
+    return print_value(item, &p);
+}
+
+N_CJSON_PUBLIC(Jbool) JPrintToSink(const J *item, char *window, const int length, const Jbool fmt, JPrintSinkFn sink, void *context)
+{
+    printbuffer p = { 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+
+    if ((item == NULL) || (sink == NULL)) {
+        return false;
+    }
+    if ((length < N_CJSON_PRINT_WINDOW_MIN) || (window == NULL)) {
+        return false;
+    }
+
+    p.buffer = (unsigned char*)window;
+    p.length = (size_t)length;
+    p.offset = 0;
+    p.noalloc = true;
+    p.format = fmt;
+    p.sink = sink;
+    p.sink_context = context;
+
+    if (!print_value(item, &p)) {
+        return false;
+    }
+    update_offset(&p);
+
+    /* drain whatever remains in the window */
+    return (p.offset == 0) || sink(context, window, p.offset);
+}
+
+/* Parse a value that is neither an array nor an object. */
+static Jbool parse_scalar(J * const item, parse_buffer * const input_buffer)
+{
+    /* parse the different types of values */
+    /* null */
+    if (can_read(input_buffer, 4) && (strncmp((const char*)buffer_at_offset(input_buffer), c_null, c_null_len) == 0)) {
+        item->type = JNULL;
+        input_buffer->offset += 4;
+        return true;
+    }
+    /* false */
+    if (can_read(input_buffer, 5) && (strncmp((const char*)buffer_at_offset(input_buffer), c_false, c_false_len) == 0)) {
+        item->type = JFalse;
+        input_buffer->offset += 5;
+        return true;
+    }
+    /* true */
+    if (can_read(input_buffer, 4) && (strncmp((const char*)buffer_at_offset(input_buffer), c_true, c_true_len) == 0)) {
+        item->type = JTrue;
+#ifndef N_CJSON_COMPACT
+        item->valueint = 1;
+#endif
+        input_buffer->offset += 4;
+        return true;
+    }
+    /* string */
+    if (can_access_at_index(input_buffer, 0) && (buffer_at_offset(input_buffer)[0] == '\"')) {
+        return parse_string(item, input_buffer);
+    }
+    /* number */
+    if (can_access_at_index(input_buffer, 0) && ((buffer_at_offset(input_buffer)[0] == '-') || ((buffer_at_offset(input_buffer)[0] >= '0') && (buffer_at_offset(input_buffer)[0] <= '9')))) {
+        return parse_number(item, input_buffer);
+    }
+
+    return false;
+}
+
+/* Parse the name of an object member and the colon that follows it, stopping at its value. */
+static Jbool parse_name(J * const item, parse_buffer * const input_buffer)
+{
+    buffer_skip_whitespace(input_buffer);
+    if (!parse_string(item, input_buffer)) {
+        return false; /* failed to parse name */
+    }
+    buffer_skip_whitespace(input_buffer);
+
+    /* swap valuestring and string, because we parsed the name */
+    item->string = item->valuestring;
+    item->valuestring = NULL;
+
+    if (cannot_access_at_index(input_buffer, 0) || (buffer_at_offset(input_buffer)[0] != ':')) {
+        return false; /* invalid object */
+    }
+    input_buffer->offset++;
+
+    return true;
+}
+
+/* Parser core - when encountering text, process appropriately.  Arrays and objects are parsed without
+ * recursing, by keeping those that are open in a fixed array, so the stack used doesn't grow with the
+ * nesting of the text.  Each item is linked into the tree as soon as it is allocated, so that on failure
+ * whatever was built is freed along with the item. */
+static Jbool parse_value(J * const item, parse_buffer * const input_buffer)
+{
+    J *container[N_CJSON_NESTING_LIMIT]; /* the arrays and objects that are open, innermost last */
+    size_t open = 0;
+    J *current = item;
+
+    if (item == NULL) {
+        return false;
+    }
+    if ((input_buffer == NULL) || (input_buffer->content == NULL)) {
+        return false; /* no input */
+    }
+
+    for (;;) {
+        /* an array or object is opened, and unless it's empty its first element is begun */
+        if (can_access_at_index(input_buffer, 0) && ((buffer_at_offset(input_buffer)[0] == '[') || (buffer_at_offset(input_buffer)[0] == '{'))) {
+            int type = (buffer_at_offset(input_buffer)[0] == '[') ? JArray : JObject;
+            J *new_item = NULL;
+
+            if (input_buffer->depth >= N_CJSON_NESTING_LIMIT) {
+                return false; /* to deeply nested */
+            }
+            current->type = type;
+
+            input_buffer->offset++;
+            buffer_skip_whitespace(input_buffer);
+            if (cannot_access_at_index(input_buffer, 0)) {
+                return false; /* ended unexpectedly */
+            }
+            if (buffer_at_offset(input_buffer)[0] != ((type == JArray) ? ']' : '}')) {
+                new_item = JNew_Item();
+                if (new_item == NULL) {
+                    return false; /* allocation failure */
+                }
+                current->child = new_item;
+                container[open++] = current;
+                input_buffer->depth++;
+                current = new_item;
+                if ((type == JObject) && !parse_name(current, input_buffer)) {
+                    return false;
+                }
+                buffer_skip_whitespace(input_buffer);
+                continue;
+            }
+            input_buffer->offset++;
+        } else if (!parse_scalar(current, input_buffer)) {
+            return false;
+        }
+
+        /* the value is complete, so begin the next element of the innermost container that has one,
+         * closing those that don't */
+        while (open > 0) {
+            J *parent = container[open - 1];
+            J *new_item = NULL;
+
+            buffer_skip_whitespace(input_buffer);
+            if (cannot_access_at_index(input_buffer, 0)) {
+                return false; /* ended unexpectedly */
+            }
+            if (buffer_at_offset(input_buffer)[0] == ',') {
+                new_item = JNew_Item();
+                if (new_item == NULL) {
+                    return false; /* allocation failure */
+                }
+                current->next = new_item;
+#ifndef N_CJSON_SINGLY_LINKED
+                new_item->prev = current;
+#endif
+                current = new_item;
+                input_buffer->offset++;
+                if (((parent->type & 0xFF) == JObject) && !parse_name(current, input_buffer)) {
+                    return false;
+                }
+                buffer_skip_whitespace(input_buffer);
+                break;
+            }
+            if (buffer_at_offset(input_buffer)[0] != (((parent->type & 0xFF) == JArray) ? ']' : '}')) {
+                return false; /* expected end of array or object */
+            }
+            input_buffer->offset++;
+            input_buffer->depth--;
+            current = parent;
+            open--;
+        }
+        if (open == 0) {
+            return true;
+        }
+    }
+}
+
+/* Render a value that is neither an array nor an object to text. */
+static Jbool print_scalar(const J * const item, printbuffer * const output_buffer)
+{
+    unsigned char *output = NULL;
+
+    switch ((item->type) & 0xFF) {
+    case JNULL:
+        output = ensure(output_buffer, c_null_len);
+        if (output == NULL) {
+            return false;
+        }
+        strcpy((char*)output, c_null);
+        return true;
+
+    case JFalse:
+        output = ensure(output_buffer, c_false_len);
+        if (output == NULL) {
+            return false;
+        }
+        strcpy((char*)output, c_false);
+        return true;
+
+    case JTrue:
+        output = ensure(output_buffer, c_true_len);
+        if (output == NULL) {
+            return false;
+        }
+        strcpy((char*)output, c_true);
+        return true;
+
+    case JNumber:
+        return print_number(item, output_buffer);
+
+    case JRaw: {
+        size_t raw_length = 0;
+        if (item->valuestring == NULL) {
+            return false;
+        }
+
+        raw_length = strlen(item->valuestring);
+
+        /* when only measuring, there's no need to render it */
+        if (output_buffer->measured != NULL) {
+            output = ensure(output_buffer, 0);
+            if (output == NULL) {
+                return false;
+            }
+            *output = '\0';
+            *output_buffer->measured += raw_length;
+            return true;
+        }
+
+        /* raw text longer than a sink's window is passed through it piecemeal */
+        if ((output_buffer->sink != NULL) && ((raw_length + 1) >= output_buffer->length)) {
+            const char *raw = item->valuestring;
+            while (raw_length > 0) {
+                size_t chunk_length = cjson_min(raw_length, output_buffer->length - 1);
+                output = ensure(output_buffer, chunk_length);
+                if (output == NULL) {
+                    return false;
+                }
+                memcpy(output, raw, chunk_length);
+                output_buffer->offset += chunk_length;
+                raw += chunk_length;
+                raw_length -= chunk_length;
+            }
+            output = ensure(output_buffer, 0);
+            if (output == NULL) {
+                return false;
+            }
+            *output = '\0';
+            return true;
+        }
+
+        output = ensure(output_buffer, raw_length);
+        if (output == NULL) {
+            return false;
+        }
+        memcpy(output, item->valuestring, raw_length + 1);  // Trailing '\0'
+        return true;
+    }
+
+    case JString:
+        return print_string(item, output_buffer);
+
+    default:
+        return false;
+    }
+}
+
+/* Render the opening bracket of an array or object. */
+static Jbool print_open(const J * const item, printbuffer * const output_buffer)
+{
+    unsigned char *output_pointer = NULL;
+    Jbool object = ((item->type & 0xFF) == JObject);
+    size_t length = (size_t) ((object && output_buffer->format) ? 2 : 1); /* fmt: {\n */
+
+    output_pointer = ensure(output_buffer, length);
+    if (output_pointer == NULL) {
+        return false;
+    }
+    *output_pointer++ = object ? '{' : '[';
+    if (length > 1) {
+        *output_pointer++ = '\n';
+    }
+    *output_pointer = '\0';
+    output_buffer->offset += length;
+    output_buffer->depth++;
+
+    return true;
+}
+
+/* Render the name of an object member, indented if formatting, and the colon that follows it. */
+static Jbool print_name(const J * const item, printbuffer * const output_buffer)
+{
+    unsigned char *output_pointer = NULL;
+    size_t length = 0;
+
+    if (output_buffer->format) {
+        size_t i;
+        output_pointer = ensure(output_buffer, output_buffer->depth);
+        if (output_pointer == NULL) {
+            return false;
+        }
+        for (i = 0; i < output_buffer->depth; i++) {
+            *output_pointer++ = '\t';
+        }
+        output_buffer->offset += output_buffer->depth;
+    }
+
+    /* print key */
+    if (!print_string_ptr((unsigned char*)item->string, output_buffer)) {
+        return false;
+    }
+    update_offset(output_buffer);
+
+    length = (size_t) (output_buffer->format ? 2 : 1);
+    output_pointer = ensure(output_buffer, length);
+    if (output_pointer == NULL) {
+        return false;
+    }
+    *output_pointer++ = ':';
+    if (output_buffer->format) {
+        *output_pointer++ = '\t';
+    }
+    *output_pointer = '\0';
+    output_buffer->offset += length;
+
+    return true;
+}
+
+/* Render what follows an element of an array or object: a comma if it isn't the last, and if formatting,
+ * a space in an array or a newline in an object. */
+static Jbool print_separator(const J * const parent, const J * const item, printbuffer * const output_buffer)
+{
+    unsigned char *output_pointer = NULL;
+    Jbool object = ((parent->type & 0xFF) == JObject);
+    size_t length = 0;
+
+    if (item->next != NULL) {
+        length = (size_t) ((output_buffer->format && !object) ? 2 : 1);
+    }
+    if (output_buffer->format && object) {
+        length++;
+    }
+
+    output_pointer = ensure(output_buffer, length);
+    if (output_pointer == NULL) {
+        return false;
+    }
+    if (item->next != NULL) {
+        *output_pointer++ = ',';
+        if (output_buffer->format && !object) {
+            *output_pointer++ = ' ';
+        }
+    }
+    if (output_buffer->format && object) {
+        *output_pointer++ = '\n';
+    }
+    *output_pointer = '\0';
+    output_buffer->offset += length;
+
+    return true;
+}
+
+/* Render the closing bracket of an array or object, indented to match its opening if formatting. */
+static Jbool print_close(const J * const item, printbuffer * const output_buffer)
+{
+    unsigned char *output_pointer = NULL;
+    Jbool object = ((item->type & 0xFF) == JObject);
+    size_t tabs = (object && output_buffer->format) ? (output_buffer->depth - 1) : 0;
+    size_t i;
+
+    output_pointer = ensure(output_buffer, tabs + 1);
+    if (output_pointer == NULL) {
+        return false;
+    }
+    for (i = 0; i < tabs; i++) {
+        *output_pointer++ = '\t';
+    }
+    *output_pointer++ = object ? '}' : ']';
+    *output_pointer = '\0';
+    output_buffer->offset += tabs + 1;
+    output_buffer->depth--;
+
+    return true;
+}
+
+/* Render a value to text.  Arrays and objects are rendered without recursing, by keeping those that are
+ * open in a fixed array, so the stack used doesn't grow with the nesting of the item. */
+static Jbool print_value(const J * const item, printbuffer * const output_buffer)
+{
+    const J *container[N_CJSON_NESTING_LIMIT]; /* the arrays and objects that are open, innermost last */
+    size_t open = 0;
+    const J *current = item;
+
+    if ((item == NULL) || (output_buffer == NULL)) {
+        return false;
+    }
+
+    for (;;) {
+        if ((open > 0) && ((container[open - 1]->type & 0xFF) == JObject) && !print_name(current, output_buffer)) {
+            return false;
+        }
+
+        /* an array or object is opened, and unless it's empty its first element is begun */
+        if (((current->type & 0xFF) == JArray) || ((current->type & 0xFF) == JObject)) {
+            if (open >= N_CJSON_NESTING_LIMIT) {
+                return false; /* too deeply nested */
+            }
+            if (!print_open(current, output_buffer)) {
+                return false;
+            }
+            if (current->child != NULL) {
+                container[open++] = current;
+                current = current->child;
+                continue;
+            }
+            if (!print_close(current, output_buffer)) {
+                return false;
+            }
+        } else {
+            if (!print_scalar(current, output_buffer)) {
+                return false;
+            }
+            update_offset(output_buffer);
+        }
+
+        /* the value is complete, so begin the next element of the innermost container that has one,
+         * closing those that don't */
+        while (open > 0) {
+            if (!print_separator(container[open - 1], current, output_buffer)) {
+                return false;
+            }
+            if (current->next != NULL) {
+                current = current->next;
+                break;
+            }
+            current = container[--open];
+            if (!print_close(current, output_buffer)) {
+                return false;
+            }
+        }
+        if (open == 0) {
+            return true;
+        }
+    }
+}
+
+
+/* Skip over a value without building it, stopping at the comma or bracket that follows it.  Only
+ * strings are checked to be terminated, and brackets to be nested no less than they are closed. */
+static Jbool skip_value(parse_buffer * const input_buffer)
+{
+    size_t start = input_buffer->offset;
+    size_t depth = 0;
+
+    while (can_access_at_index(input_buffer, 0)) {
+        switch (buffer_at_offset(input_buffer)[0]) {
+        case '\"':
+            input_buffer->offset++;
+            while (can_access_at_index(input_buffer, 0) && (buffer_at_offset(input_buffer)[0] != '\"')) {
+                if (buffer_at_offset(input_buffer)[0] == '\\') {
+                    input_buffer->offset++;
+                }
+                input_buffer->offset++;
+            }
+            if (cannot_access_at_index(input_buffer, 0)) {
+                return false; /* string ended unexpectedly */
+            }
+            break;
+        case '{':
+        case '[':
+            depth++;
+            break;
+        case '}':
+        case ']':
+            if (depth == 0) {
+                return (input_buffer->offset != start);
+            }
+            depth--;
+            break;
+        case ',':
+            if (depth == 0) {
+                return (input_buffer->offset != start);
+            }
+            break;
+        case '\0':
+            return false;
+        default:
+            break;
+        }
+        input_buffer->offset++;
+    }
+
+    return false;
+}
+
+/* Find the listed field naming a key of the object at path (the first path_len characters of a field, or
+ * nothing at the top level), either as the whole of the field or as a prefix of it, noting which. Keys are
+ * matched case insensitively, as JGetObjectItem does. */
+static const char *match_field(const char * const *fields, const char *path, size_t path_len, const unsigned char *key, size_t key_len, Jbool *whole)
+{
+    const char *prefix = NULL;
+
+    for (; *fields != NULL; fields++) {
+        const char *rest = *fields;
+        if (path_len != 0) {
+            if ((case_insensitive_strncmp((const unsigned char*)rest, (const unsigned char*)path, path_len) != 0) || (rest[path_len] != '.')) {
+                continue;
+            }
+            rest += path_len + 1;
+        }
+        if (case_insensitive_strncmp((const unsigned char*)rest, key, key_len) != 0) {
+            continue;
+        }
+        if (rest[key_len] == '\0') {
+            *whole = true;
+            return *fields;
+        }
+        if ((rest[key_len] == '.') && (prefix == NULL)) {
+            prefix = *fields;
+        }
+    }
+
+    *whole = false;
+    return prefix;
+}
+
+/* Build an object from the text, with only the listed fields of the object at path, and skip the rest. */
+static Jbool parse_object_fields(J * const item, parse_buffer * const input_buffer, const char * const *fields, const char *path, size_t path_len)
+{
+    J *head = NULL; /* linked list head */
     J *current_item = NULL;
 
     if (input_buffer->depth >= N_CJSON_NESTING_LIMIT) {
@@ -1193,16 +2568,14 @@ static Jbool parse_array(J * const item, parse_buffer * const input_buffer)
     }
     input_buffer->depth++;
 
-    if (buffer_at_offset(input_buffer)[0] != '[') {
-        /* not an array */
-        goto fail;
+    if (cannot_access_at_index(input_buffer, 0) || (buffer_at_offset(input_buffer)[0] != '{')) {
+        goto fail; /* not an object */
     }
 
     input_buffer->offset++;
     buffer_skip_whitespace(input_buffer);
-    if (can_access_at_index(input_buffer, 0) && (buffer_at_offset(input_buffer)[0] == ']')) {
-        /* empty array */
-        goto success;
+    if (can_access_at_index(input_buffer, 0) && (buffer_at_offset(input_buffer)[0] == '}')) {
+        goto success; /* empty object */
     }
 
     /* check if we skipped to the end of the buffer */
@@ -1213,8 +2586,50 @@ static Jbool parse_array(J * const item, parse_buffer * const input_buffer)
 
     /* step back to character in front of the first element */
     input_buffer->offset--;
-    /* loop through the comma separated array elements */
+    /* loop through the comma separated object elements */
     do {
+        const unsigned char *key = NULL;
+        size_t key_len = 0;
+        Jbool escaped = false;
+        Jbool whole = false;
+        const char *field = NULL;
+
+        /* find the name of the child, which can't be a listed field if it has escapes */
+        input_buffer->offset++;
+        buffer_skip_whitespace(input_buffer);
+        if (cannot_access_at_index(input_buffer, 0) || (buffer_at_offset(input_buffer)[0] != '\"')) {
+            goto fail; /* failed to parse name */
+        }
+        key = buffer_at_offset(input_buffer) + 1;
+        for (; can_access_at_index(input_buffer, key_len + 1) && (key[key_len] != '\"'); key_len++) {
+            if (key[key_len] == '\\') {
+                escaped = true;
+                key_len++;
+            }
+        }
+        if (cannot_access_at_index(input_buffer, key_len + 1)) {
+            goto fail; /* name ended unexpectedly */
+        }
+        if (!escaped) {
+            field = match_field(fields, path, path_len, key, key_len, &whole);
+        }
+        input_buffer->offset += key_len + 2;
+        buffer_skip_whitespace(input_buffer);
+
+        if (cannot_access_at_index(input_buffer, 0) || (buffer_at_offset(input_buffer)[0] != ':')) {
+            goto fail; /* invalid object */
+        }
+        input_buffer->offset++;
+        buffer_skip_whitespace(input_buffer);
+
+        /* skip the value unless it is wanted, or is an object containing something that is */
+        if ((field == NULL) || (!whole && (buffer_at_offset(input_buffer)[0] != '{'))) {
+            if (!skip_value(input_buffer)) {
+                goto fail; /* failed to skip value */
+            }
+            continue;
+        }
+
         /* allocate next item */
         J *new_item = JNew_Item();
         if (new_item == NULL) {
@@ -1228,31 +2643,44 @@ static Jbool parse_array(J * const item, parse_buffer * const input_buffer)
         } else {
             /* add to the end and advance */
             current_item->next = new_item;
+#ifndef N_CJSON_SINGLY_LINKED
             new_item->prev = current_item;
+#endif
             current_item = new_item;
         }
 
-        /* parse next value */
-        input_buffer->offset++;
-        buffer_skip_whitespace(input_buffer);
-        if (!parse_value(current_item, input_buffer)) {
-            goto fail; /* failed to parse value */
+        /* copy the name, which having no escapes is exactly as it appears */
+        current_item->string = (char*)parse_alloc_string(key_len + 1);
+        if (current_item->string == NULL) {
+            goto fail; /* allocation failure */
+        }
+        memcpy(current_item->string, key, key_len);
+        current_item->string[key_len] = '\0';
+
+        /* parse the value */
+        if (whole) {
+            if (!parse_value(current_item, input_buffer)) {
+                goto fail; /* failed to parse value */
+            }
+        } else {
+            if (!parse_object_fields(current_item, input_buffer, fields, field, (path_len == 0) ? key_len : (path_len + 1 + key_len))) {
+                goto fail; /* failed to parse value */
+            }
         }
         buffer_skip_whitespace(input_buffer);
     } while (can_access_at_index(input_buffer, 0) && (buffer_at_offset(input_buffer)[0] == ','));
 
-    if (cannot_access_at_index(input_buffer, 0) || buffer_at_offset(input_buffer)[0] != ']') {
-        goto fail; /* expected end of array */
+    if (cannot_access_at_index(input_buffer, 0) || (buffer_at_offset(input_buffer)[0] != '}')) {
+        goto fail; /* expected end of object */
     }
 
 success:
     input_buffer->depth--;
 
-    item->type = JArray;
+    item->type = JObject;
     item->child = head;
 
     input_buffer->offset++;
-
     return true;
 
 fail:
@@ -1263,249 +2691,779 @@ fail:
     return false;
 }
 
-/* Render an array to text */
-static Jbool print_array(const J * const item, printbuffer * const output_buffer)
+N_CJSON_PUBLIC(J *) JParseFields(const char *value, const char * const *fields)
+{
+    parse_buffer buffer = { 0, 0, 0, 0 };
+    J *item = NULL;
+
+    if (fields == NULL) {
+        return JParse(value);
+    }
+    if (value == NULL) {
+        return NULL;
+    }
+
+    buffer.content = (const unsigned char*)value;
+    buffer.length = strlen((const char*)value) + 1;   // Trailing '\0'
+    buffer.offset = 0;
+
+    item = JNew_Item();
+    if (item == NULL) { /* memory fail */
+        return NULL;
+    }
+
+    /* only an object has fields to choose from */
+    buffer_skip_whitespace(skip_utf8_bom(&buffer));
+    if (buffer_at_offset(&buffer)[0] == '{') {
+        if (!parse_object_fields(item, &buffer, fields, NULL, 0)) {
+            JDelete(item);
+            return NULL;
+        }
+    } else if (!parse_value(item, &buffer)) {
+        JDelete(item);
+        return NULL;
+    }
+
+    return item;
+}
+
+#if defined(NOTE_FIXED) || defined(NOTE_FLOAT)
+/* A double held in a struct can't pass through a JNUMBER without losing range or precision, such as that of an epoch
+ * time, so it is converted to and from an integer part and a count of millionths with integer arithmetic alone, which
+ * also keeps a fixed point build free of floating point. Doubles are taken to be IEEE 754 binary64. */
+#define STRUCT_DOUBLE_DECIMALS 6
+#define STRUCT_DOUBLE_SCALE 1000000UL
+typedef char struct_double_is_binary64[(sizeof(double) == sizeof(uint64_t)) ? 1 : -1];
+
+/* Print an unsigned 64-bit integer, returning its length. */
+static int print_digits64(uint64_t magnitude, unsigned char *output)
+{
+    unsigned char digits[20];
+    int count = 0;
+    int length = 0;
+
+    do {
+        digits[count++] = (unsigned char)('0' + (magnitude % 10));
+        magnitude /= 10;
+    } while (magnitude != 0);
+
+    while (count > 0) {
+        output[length++] = digits[--count];
+    }
+    output[length] = '\0';
+
+    return length;
+}
+
+/* Render a double held in a struct to six decimal places, rounded, without trailing zeros, saturating at the limits
+ * of a 64-bit integer part. NaN and infinity are rendered as null, as they are in a tree. */
+static Jbool print_struct_double(const unsigned char * const member, printbuffer * const output_buffer)
 {
+    unsigned char number_buffer[30]; /* sizeof("-18446744073709551615.999999") */
     unsigned char *output_pointer = NULL;
-    size_t length = 0;
-    J *current_element = item->child;
+    uint64_t bits = 0;
+    uint64_t mantissa = 0;
+    uint64_t integer = 0;
+    uint64_t fraction = 0;
+    uint64_t scaled = 0;
+    uint32_t millionths = 0;
+    int exponent = 0;
+    int length = 0;
+    int i = 0;
+
+    memcpy(&bits, member, sizeof(bits));
+    exponent = (int)((bits >> 52) & 0x7FF);
+    mantissa = bits & 0xFFFFFFFFFFFFFULL;
+    if (exponent == 0x7FF) {
+        length = c_null_len;
+        memcpy(number_buffer, c_null, (size_t)length + 1);
+        goto output;
+    }
+    if (exponent == 0) {
+        exponent = 1; /* subnormal */
+    } else {
+        mantissa |= 1ULL << 52;
+    }
 
-    if (output_buffer == NULL) {
+    /* the value is mantissa * 2^(exponent - 1075), split into its integer part and the fraction of it that remains */
+    exponent -= 1075;
+    if (exponent >= 0) {
+        integer = (exponent > 11) ? UINT64_MAX : (mantissa << exponent);
+    } else {
+        int shift = -exponent;
+        if (shift < 64) {
+            integer = mantissa >> shift;
+            fraction = mantissa & ((1ULL << shift) - 1);
+        } else {
+            fraction = (shift - 44 < 64) ? (mantissa >> (shift - 44)) : 0;
+            shift = 44;
+        }
+        /* keep fraction * STRUCT_DOUBLE_SCALE within 64 bits, at a precision far finer than a millionth */
+        if (shift > 44) {
+            fraction >>= (shift - 44);
+            shift = 44;
+        }
+        scaled = fraction * STRUCT_DOUBLE_SCALE;
+        millionths = (uint32_t)(scaled >> shift);
+        scaled &= (1ULL << shift) - 1;
+        if ((scaled > (1ULL << (shift - 1))) || ((scaled == (1ULL << (shift - 1))) && ((millionths & 1) != 0))) {
+            millionths++; /* round half to even */
+        }
+        if (millionths == STRUCT_DOUBLE_SCALE) {
+            millionths = 0;
+            integer = (integer == UINT64_MAX) ? integer : (integer + 1);
+        }
+    }
+
+    if (((bits >> 63) != 0) && ((integer != 0) || (millionths != 0))) {
+        number_buffer[length++] = '-';
+    }
+    length += print_digits64(integer, number_buffer + length);
+    if (millionths != 0) {
+        number_buffer[length++] = '.';
+        for (i = STRUCT_DOUBLE_DECIMALS - 1; i >= 0; i--) {
+            number_buffer[length + i] = (unsigned char)('0' + (millionths % 10));
+            millionths /= 10;
+        }
+        length += STRUCT_DOUBLE_DECIMALS;
+        while (number_buffer[length - 1] == '0') {
+            length--;
+        }
+        number_buffer[length] = '\0';
+    }
+
+output:
+    output_pointer = ensure(output_buffer, (size_t)length);
+    if (output_pointer == NULL) {
         return false;
     }
+    memcpy(output_pointer, number_buffer, (size_t)length + 1);
+    output_buffer->offset += (size_t)length;
 
-    /* Compose the output array. */
-    /* opening square bracket */
-    output_pointer = ensure(output_buffer, 1);
+    return true;
+}
+
+/* Parse a number into a double held in a struct, to six decimal places, rounded to the nearest double. */
+static Jbool parse_struct_double(unsigned char * const member, parse_buffer * const input_buffer)
+{
+    static const uint64_t powers[] = { 1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL,
+                                       100000000ULL, 1000000000ULL, 10000000000ULL, 100000000000ULL, 1000000000000ULL,
+                                       10000000000000ULL, 100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL,
+                                       100000000000000000ULL, 1000000000000000000ULL, 10000000000000000000ULL
+                                     };
+    const int max_power = (int)(sizeof(powers) / sizeof(powers[0])) - 1;
+    Jbool negative = false;
+    Jbool saturated = false;
+    uint64_t digits = 0;
+    uint64_t integer = 0;
+    uint64_t quotient = 0;
+    uint64_t remainder = 0;
+    uint64_t bits = 0;
+    int significant = 0;
+    int scale = 0;
+    int exponent = 0;
+    int binary_exponent = 0;
+    Jbool sticky = false;
+
+    /* gather up to 19 significant digits, noting the power of ten by which they're to be scaled */
+    if (buffer_at_offset(input_buffer)[0] == '-') {
+        negative = true;
+        input_buffer->offset++;
+    }
+    if (cannot_access_at_index(input_buffer, 0) || (buffer_at_offset(input_buffer)[0] < '0') || (buffer_at_offset(input_buffer)[0] > '9')) {
+        return false;
+    }
+    while (can_access_at_index(input_buffer, 0) && (buffer_at_offset(input_buffer)[0] >= '0') && (buffer_at_offset(input_buffer)[0] <= '9')) {
+        if (significant < max_power) {
+            digits = (digits * 10) + (uint64_t)(buffer_at_offset(input_buffer)[0] - '0');
+            significant += (digits != 0) ? 1 : 0;
+        } else {
+            scale++;
+        }
+        input_buffer->offset++;
+    }
+    if (can_access_at_index(input_buffer, 0) && (buffer_at_offset(input_buffer)[0] == '.')) {
+        input_buffer->offset++;
+        while (can_access_at_index(input_buffer, 0) && (buffer_at_offset(input_buffer)[0] >= '0') && (buffer_at_offset(input_buffer)[0] <= '9')) {
+            if (significant < max_power) {
+                digits = (digits * 10) + (uint64_t)(buffer_at_offset(input_buffer)[0] - '0');
+                significant += (digits != 0) ? 1 : 0;
+                scale--;
+            }
+            input_buffer->offset++;
+        }
+    }
+    if (can_access_at_index(input_buffer, 0) && ((buffer_at_offset(input_buffer)[0] == 'e') || (buffer_at_offset(input_buffer)[0] == 'E'))) {
+        Jbool negative_exponent = false;
+        input_buffer->offset++;
+        if (can_access_at_index(input_buffer, 0) && ((buffer_at_offset(input_buffer)[0] == '-') || (buffer_at_offset(input_buffer)[0] == '+'))) {
+            negative_exponent = (buffer_at_offset(input_buffer)[0] == '-');
+            input_buffer->offset++;
+        }
+        while (can_access_at_index(input_buffer, 0) && (buffer_at_offset(input_buffer)[0] >= '0') && (buffer_at_offset(input_buffer)[0] <= '9')) {
+            if (exponent < 1000) {
+                exponent = (exponent * 10) + (buffer_at_offset(input_buffer)[0] - '0');
+            }
+            input_buffer->offset++;
+        }
+        scale += negative_exponent ? -exponent : exponent;
+    }
+
+    /* split it into an integer part and millionths, saturating the integer part at 64 bits */
+    if (scale >= 0) {
+        if ((digits != 0) && ((scale > max_power) || (digits > (UINT64_MAX / powers[scale])))) {
+            saturated = true;
+        } else {
+            integer = digits * powers[scale];
+        }
+        remainder = 0;
+    } else if (-scale <= STRUCT_DOUBLE_DECIMALS) {
+        integer = digits / powers[-scale];
+        remainder = (digits % powers[-scale]) * powers[STRUCT_DOUBLE_DECIMALS + scale];
+    } else if (-scale <= max_power) {
+        uint64_t divisor = powers[-scale - STRUCT_DOUBLE_DECIMALS];
+        integer = digits / powers[-scale];
+        remainder = ((digits % powers[-scale]) + (divisor / 2)) / divisor;
+    } else if (-scale - STRUCT_DOUBLE_DECIMALS <= max_power) {
+        remainder = (digits + (powers[-scale - STRUCT_DOUBLE_DECIMALS] / 2)) / powers[-scale - STRUCT_DOUBLE_DECIMALS];
+    }
+    if (remainder >= STRUCT_DOUBLE_SCALE) {
+        remainder -= STRUCT_DOUBLE_SCALE;
+        saturated = saturated || (integer == UINT64_MAX);
+        integer++;
+    }
+    if (saturated) {
+        integer = UINT64_MAX;
+        remainder = 0;
+    }
+
+    /* develop the binary quotient of integer + remainder/10^6 to 55 significant bits, so that it can be rounded to the
+     * 53 of a double, noting whether anything nonzero is left below them */
+    quotient = integer;
+    if ((quotient >> 54) != 0) {
+        sticky = (remainder != 0);
+        while ((quotient >> 55) != 0) {
+            sticky = sticky || ((quotient & 1) != 0);
+            quotient >>= 1;
+            binary_exponent++;
+        }
+    } else if ((quotient != 0) || (remainder != 0)) {
+        while ((quotient >> 54) == 0) {
+            remainder *= 2;
+            quotient <<= 1;
+            if (remainder >= STRUCT_DOUBLE_SCALE) {
+                remainder -= STRUCT_DOUBLE_SCALE;
+                quotient |= 1;
+            }
+            binary_exponent--;
+        }
+        sticky = (remainder != 0);
+    }
+    if (quotient != 0) {
+        /* round half to even */
+        uint64_t dropped = quotient & 3;
+        quotient >>= 2;
+        binary_exponent += 2;
+        if ((dropped > 2) || ((dropped == 2) && (sticky || ((quotient & 1) != 0)))) {
+            quotient++;
+            if ((quotient >> 53) != 0) {
+                quotient >>= 1;
+                binary_exponent++;
+            }
+        }
+        bits = ((uint64_t)(binary_exponent + 1075) << 52) | (quotient & 0xFFFFFFFFFFFFFULL);
+    }
+    if (negative) {
+        bits |= 1ULL << 63;
+    }
+    memcpy(member, &bits, sizeof(bits));
+
+    return true;
+}
+#else
+/* Render a double held in a struct, which a JNUMBER holds exactly. */
+static Jbool print_struct_double(const unsigned char * const member, printbuffer * const output_buffer)
+{
+    J item;
+
+    memset(&item, 0, sizeof(item));
+    item.type = JNumber;
+    set_number(&item, (JNUMBER)*(const double *)member);
+
+    return print_number(&item, output_buffer);
+}
+
+/* Parse a number into a double held in a struct, which a JNUMBER holds exactly. */
+static Jbool parse_struct_double(unsigned char * const member, parse_buffer * const input_buffer)
+{
+    J item;
+
+    memset(&item, 0, sizeof(item));
+    if (!parse_number(&item, input_buffer)) {
+        return false;
+    }
+    *(double *)member = (double)item.valuenumber;
+
+    return true;
+}
+#endif
+
+/* Render a number held in a struct through an item on the stack, so that it's printed just as it is in a tree. */
+static Jbool print_struct_number(JNUMBER number, printbuffer * const output_buffer)
+{
+    J item;
+
+    memset(&item, 0, sizeof(item));
+    item.type = JNumber;
+    set_number(&item, number);
+
+    return print_number(&item, output_buffer);
+}
+
+/* Render an integer held in a struct. */
+static Jbool print_struct_integer(uint32_t magnitude, Jbool negative, printbuffer * const output_buffer)
+{
+    unsigned char digits[12]; /* sizeof("-4294967295") */
+    unsigned char *output_pointer = NULL;
+    int length = print_digits(magnitude, negative, digits);
+
+    output_pointer = ensure(output_buffer, (size_t)length);
     if (output_pointer == NULL) {
         return false;
     }
+    memcpy(output_pointer, digits, (size_t)length + 1);
+    output_buffer->offset += (size_t)length;
+
+    return true;
+}
 
-    *output_pointer = '[';
+/* Render the fields of a struct as the members of an object. */
+static Jbool print_struct(const unsigned char * const s, const JField *fields, printbuffer * const output_buffer)
+{
+    unsigned char *output_pointer = NULL;
+    const JField *field = NULL;
+
+    output_pointer = ensure(output_buffer, 1);
+    if (output_pointer == NULL) {
+        return false;
+    }
+    *output_pointer = '{';
     output_buffer->offset++;
-    output_buffer->depth++;
 
-    while (current_element != NULL) {
-        if (!print_value(current_element, output_buffer)) {
+    for (field = fields; field->key != NULL; field++) {
+        const unsigned char *member = s + field->offset;
+        Jbool printed = false;
+
+        /* print the comma before all but the first, then the key */
+        output_pointer = ensure(output_buffer, (field == fields) ? 0 : 1);
+        if (output_pointer == NULL) {
+            return false;
+        }
+        if (field != fields) {
+            *output_pointer = ',';
+            output_buffer->offset++;
+        }
+        if (!print_string_ptr((const unsigned char*)field->key, output_buffer)) {
             return false;
         }
         update_offset(output_buffer);
-        if (current_element->next) {
-            length = (size_t) (output_buffer->format ? 2 : 1);
-            output_pointer = ensure(output_buffer, length + 1);
-            if (output_pointer == NULL) {
-                return false;
+        output_pointer = ensure(output_buffer, 1);
+        if (output_pointer == NULL) {
+            return false;
+        }
+        *output_pointer = ':';
+        output_buffer->offset++;
+
+        /* print the value */
+        switch (field->type) {
+        case JFIELD_NUMBER:
+            printed = print_struct_number(*(const JNUMBER *)member, output_buffer);
+            break;
+        case JFIELD_DOUBLE:
+            printed = print_struct_double(member, output_buffer);
+            break;
+        case JFIELD_INT32: {
+            int32_t n = *(const int32_t *)member;
+            printed = print_struct_integer((n < 0) ? ((uint32_t)0 - (uint32_t)n) : (uint32_t)n, (n < 0), output_buffer);
+            break;
+        }
+        case JFIELD_UINT32:
+            printed = print_struct_integer(*(const uint32_t *)member, false, output_buffer);
+            break;
+        case JFIELD_BOOL:
+            output_pointer = ensure(output_buffer, *(const bool *)member ? c_true_len : c_false_len);
+            if (output_pointer != NULL) {
+                strcpy((char*)output_pointer, *(const bool *)member ? c_true : c_false);
+                printed = true;
             }
-            *output_pointer++ = ',';
-            if(output_buffer->format) {
-                *output_pointer++ = ' ';
+            break;
+        case JFIELD_STRING:
+            /* the string must be terminated within its array */
+            if (memchr(member, '\0', field->size) != NULL) {
+                printed = print_string_ptr(member, output_buffer);
             }
-            *output_pointer = '\0';
-            output_buffer->offset += length;
+            break;
+        default:
+            break;
+        }
+        if (!printed) {
+            return false;
         }
-        current_element = current_element->next;
+        update_offset(output_buffer);
     }
 
-    output_pointer = ensure(output_buffer, 2);
+    output_pointer = ensure(output_buffer, 1);
     if (output_pointer == NULL) {
         return false;
     }
-    *output_pointer++ = ']';
-    *output_pointer = '\0';
-    output_buffer->depth--;
+    output_pointer[0] = '}';
+    output_pointer[1] = '\0';
+    output_buffer->offset++;
 
     return true;
 }
 
-/* Build an object from the text. */
-static Jbool parse_object(J * const item, parse_buffer * const input_buffer)
+N_CJSON_PUBLIC(char *) JPrintStruct(const void *s, const JField *fields)
 {
-    J *head = NULL; /* linked list head */
-    J *current_item = NULL;
+    unsigned char window[N_CJSON_PRINT_WINDOW_MIN];
+    printbuffer buffer[1];
+    size_t length = 0;
 
-    if (input_buffer->depth >= N_CJSON_NESTING_LIMIT) {
-        return false; /* to deeply nested */
+    if ((s == NULL) || (fields == NULL)) {
+        return NULL;
     }
-    input_buffer->depth++;
 
-    if (cannot_access_at_index(input_buffer, 0) || (buffer_at_offset(input_buffer)[0] != '{')) {
-        goto fail; /* not an object */
+    /* measure it, as print does */
+    memset(buffer, 0, sizeof(buffer));
+    buffer->buffer = window;
+    buffer->length = sizeof(window);
+    buffer->noalloc = true;
+    buffer->sink = count_printed;
+    buffer->sink_context = &length;
+    buffer->measured = &length;
+    if (!print_struct((const unsigned char*)s, fields, buffer)) {
+        return NULL;
     }
+    length += buffer->offset;
 
-    input_buffer->offset++;
-    buffer_skip_whitespace(input_buffer);
-    if (can_access_at_index(input_buffer, 0) && (buffer_at_offset(input_buffer)[0] == '}')) {
-        goto success; /* empty object */
+    /* and render it into a single allocation of exactly that size */
+    memset(buffer, 0, sizeof(buffer));
+    buffer->buffer = (unsigned char*) _Malloc(length + 1);
+    buffer->length = length + 1;
+    buffer->noalloc = true;
+    if (buffer->buffer == NULL) {
+        return NULL;
     }
-
-    /* check if we skipped to the end of the buffer */
-    if (cannot_access_at_index(input_buffer, 0)) {
-        input_buffer->offset--;
-        goto fail;
+    if (!print_struct((const unsigned char*)s, fields, buffer)) {
+        _Free(buffer->buffer);
+        return NULL;
     }
 
-    /* step back to character in front of the first element */
-    input_buffer->offset--;
-    /* loop through the comma separated array elements */
-    do {
-        /* allocate next item */
-        J *new_item = JNew_Item();
-        if (new_item == NULL) {
-            goto fail; /* allocation failure */
-        }
+    return (char*)buffer->buffer;
+}
 
-        /* attach next item to list */
-        if (head == NULL) {
-            /* start the linked list */
-            current_item = head = new_item;
-        } else {
-            /* add to the end and advance */
-            current_item->next = new_item;
-            new_item->prev = current_item;
-            current_item = new_item;
-        }
+N_CJSON_PUBLIC(J *) JCreateStruct(const void *s, const JField *fields)
+{
+    J *item = NULL;
+    char *text = JPrintStruct(s, fields);
 
-        /* parse the name of the child */
-        input_buffer->offset++;
-        buffer_skip_whitespace(input_buffer);
-        if (!parse_string(current_item, input_buffer)) {
-            goto fail; /* faile to parse name */
-        }
-        buffer_skip_whitespace(input_buffer);
+    if (text == NULL) {
+        return NULL;
+    }
+    item = JNew_Item();
+    if (item == NULL) {
+        _Free(text);
+        return NULL;
+    }
+    item->type = JRaw;
+    item->valuestring = text;
 
-        /* swap valuestring and string, because we parsed the name */
-        current_item->string = current_item->valuestring;
-        current_item->valuestring = NULL;
+    return item;
+}
 
-        if (cannot_access_at_index(input_buffer, 0) || (buffer_at_offset(input_buffer)[0] != ':')) {
-            goto fail; /* invalid object */
+/* Find the field with a given key, case insensitively. */
+static const JField *find_field(const JField *fields, const unsigned char *key, size_t key_len)
+{
+    for (; fields->key != NULL; fields++) {
+        if ((case_insensitive_strncmp((const unsigned char*)fields->key, key, key_len) == 0) && (fields->key[key_len] == '\0')) {
+            return fields;
         }
+    }
+    return NULL;
+}
 
-        /* parse the value */
-        input_buffer->offset++;
-        buffer_skip_whitespace(input_buffer);
-        if (!parse_value(current_item, input_buffer)) {
-            goto fail; /* failed to parse value */
-        }
-        buffer_skip_whitespace(input_buffer);
-    } while (can_access_at_index(input_buffer, 0) && (buffer_at_offset(input_buffer)[0] == ','));
+/* Parse a string into a char array, truncating it to fit. */
+static Jbool parse_struct_string(unsigned char * const member, size_t size, parse_buffer * const input_buffer)
+{
+    const unsigned char *input_pointer = buffer_at_offset(input_buffer) + 1;
+    const unsigned char *input_end = input_pointer;
+    unsigned char *output = member;
+    unsigned char *output_end = NULL;
 
-    if (cannot_access_at_index(input_buffer, 0) || (buffer_at_offset(input_buffer)[0] != '}')) {
-        goto fail; /* expected end of object */
+    while (((size_t)(input_end - input_buffer->content) < input_buffer->length) && (*input_end != '\"')) {
+        if (input_end[0] == '\\') {
+            input_end++;
+        }
+        input_end++;
+    }
+    if (((size_t)(input_end - input_buffer->content) >= input_buffer->length) || (*input_end != '\"')) {
+        return false; /* string ended unexpectedly */
     }
 
-success:
-    input_buffer->depth--;
-
-    item->type = JObject;
-    item->child = head;
+    /* unescaping never lengthens a string, so it need only be unescaped elsewhere if it might not fit */
+    if ((size_t)(input_end - input_pointer) >= size) {
+        output = (unsigned char*) _Malloc((size_t)(input_end - input_pointer) + 1);
+        if (output == NULL) {
+            return false;
+        }
+    }
+    output_end = unescape_string(&input_pointer, input_end, output);
+    if (output_end != NULL) {
+        *output_end = '\0';
+    }
+    if (output != member) {
+        if (output_end != NULL) {
+            size_t length = cjson_min((size_t)(output_end - output), size - 1);
+            memcpy(member, output, length);
+            member[length] = '\0';
+        }
+        _Free(output);
+    }
+    if (output_end == NULL) {
+        return false;
+    }
 
-    input_buffer->offset++;
+    input_buffer->offset = (size_t)(input_end - input_buffer->content) + 1;
     return true;
+}
 
-fail:
-    if (head != NULL) {
-        JDelete(head);
+/* Set a 32-bit integer field from a parsed number, saturating at its limits. */
+static void set_struct_integer(unsigned char * const member, Jbool is_unsigned, J * const item)
+{
+    long int n = JIntValue(item);
+
+    if (!is_unsigned) {
+        *(int32_t *)member = (n > 0x7FFFFFFFL) ? 0x7FFFFFFF : ((n < (-0x7FFFFFFFL - 1)) ? (-0x7FFFFFFF - 1) : (int32_t)n);
+    } else if (n <= 0) {
+        *(uint32_t *)member = 0;
+#ifndef NOTE_FIXED
+    } else if ((n == LONG_MAX) && (item->valuenumber > (JNUMBER)LONG_MAX)) {
+        /* too large for a long, where longs are 32 bits */
+        *(uint32_t *)member = (item->valuenumber >= (JNUMBER)0xFFFFFFFFUL) ? 0xFFFFFFFFUL : (uint32_t)item->valuenumber;
+#endif
+    } else {
+        *(uint32_t *)member = ((unsigned long)n > 0xFFFFFFFFUL) ? 0xFFFFFFFFUL : (uint32_t)n;
     }
-
-    return false;
 }
 
-/* Render an object to text. */
-static Jbool print_object(const J * const item, printbuffer * const output_buffer)
+/* Parse a 32-bit integer field with integer arithmetic alone, so that it has its full range whatever a JNUMBER is,
+ * saturating at its limits and truncating any fraction. Numbers with exponents are parsed as numbers. */
+static Jbool parse_struct_integer(unsigned char * const member, Jbool is_unsigned, parse_buffer * const input_buffer)
 {
-    unsigned char *output_pointer = NULL;
-    size_t length = 0;
-    J *current_item = item->child;
-
-    if (output_buffer == NULL) {
-        return false;
+    const size_t start = input_buffer->offset;
+    Jbool negative = false;
+    Jbool overflow = false;
+    uint32_t magnitude = 0;
+    J item;
+
+    if (buffer_at_offset(input_buffer)[0] == '-') {
+        negative = true;
+        input_buffer->offset++;
     }
-
-    /* Compose the output: */
-    length = (size_t) (output_buffer->format ? 2 : 1); /* fmt: {\n */
-    output_pointer = ensure(output_buffer, length + 1);
-    if (output_pointer == NULL) {
+    if (cannot_access_at_index(input_buffer, 0) || (buffer_at_offset(input_buffer)[0] < '0') || (buffer_at_offset(input_buffer)[0] > '9')) {
         return false;
     }
+    while (can_access_at_index(input_buffer, 0) && (buffer_at_offset(input_buffer)[0] >= '0') && (buffer_at_offset(input_buffer)[0] <= '9')) {
+        uint32_t digit = (uint32_t)(buffer_at_offset(input_buffer)[0] - '0');
+        if (magnitude > ((0xFFFFFFFFUL - digit) / 10)) {
+            overflow = true;
+        } else {
+            magnitude = (magnitude * 10) + digit;
+        }
+        input_buffer->offset++;
+    }
+    if (can_access_at_index(input_buffer, 0) && (buffer_at_offset(input_buffer)[0] == '.')) {
+        do {
+            input_buffer->offset++;
+        } while (can_access_at_index(input_buffer, 0) && (buffer_at_offset(input_buffer)[0] >= '0') && (buffer_at_offset(input_buffer)[0] <= '9'));
+    }
+    if (can_access_at_index(input_buffer, 0) && ((buffer_at_offset(input_buffer)[0] == 'e') || (buffer_at_offset(input_buffer)[0] == 'E'))) {
+        input_buffer->offset = start;
+        memset(&item, 0, sizeof(item));
+        if (!parse_number(&item, input_buffer)) {
+            return false;
+        }
+        set_struct_integer(member, is_unsigned, &item);
+        return true;
+    }
 
-    *output_pointer++ = '{';
-    output_buffer->depth++;
-    if (output_buffer->format) {
-        *output_pointer++ = '\n';
+    if (overflow) {
+        magnitude = 0xFFFFFFFFUL;
     }
-    output_buffer->offset += length;
+    if (is_unsigned) {
+        *(uint32_t *)member = negative ? 0 : magnitude;
+    } else if (negative) {
+        *(int32_t *)member = (magnitude >= 0x80000000UL) ? INT32_MIN : -(int32_t)magnitude;
+    } else {
+        *(int32_t *)member = (magnitude > 0x7FFFFFFFUL) ? INT32_MAX : (int32_t)magnitude;
+    }
+    return true;
+}
 
-    while (current_item) {
-        if (output_buffer->format) {
-            size_t i;
-            output_pointer = ensure(output_buffer, output_buffer->depth);
-            if (output_pointer == NULL) {
-                return false;
-            }
-            for (i = 0; i < output_buffer->depth; i++) {
-                *output_pointer++ = '\t';
-            }
-            output_buffer->offset += output_buffer->depth;
+/* Parse a value into a struct's field, or skip it if it's of another type. */
+static Jbool parse_struct_field(unsigned char * const member, const JField *field, parse_buffer * const input_buffer)
+{
+    const unsigned char c = buffer_at_offset(input_buffer)[0];
+    J item;
+
+    switch (field->type) {
+    case JFIELD_NUMBER:
+    case JFIELD_DOUBLE:
+    case JFIELD_INT32:
+    case JFIELD_UINT32:
+        if ((c != '-') && ((c < '0') || (c > '9'))) {
+            break;
         }
-
-        /* print key */
-        if (!print_string_ptr((unsigned char*)current_item->string, output_buffer)) {
-            return false;
+        if ((field->type == JFIELD_INT32) || (field->type == JFIELD_UINT32)) {
+            return parse_struct_integer(member, (field->type == JFIELD_UINT32), input_buffer);
         }
-        update_offset(output_buffer);
-
-        length = (size_t) (output_buffer->format ? 2 : 1);
-        output_pointer = ensure(output_buffer, length);
-        if (output_pointer == NULL) {
+        if (field->type == JFIELD_DOUBLE) {
+            return parse_struct_double(member, input_buffer);
+        }
+        memset(&item, 0, sizeof(item));
+        if (!parse_number(&item, input_buffer)) {
             return false;
         }
-        *output_pointer++ = ':';
-        if (output_buffer->format) {
-            *output_pointer++ = '\t';
+        *(JNUMBER *)member = item.valuenumber;
+        return true;
+    case JFIELD_BOOL:
+        if (can_read(input_buffer, 4) && (strncmp((const char*)buffer_at_offset(input_buffer), c_true, c_true_len) == 0)) {
+            *(bool *)member = true;
+            input_buffer->offset += c_true_len;
+            return true;
         }
-        output_buffer->offset += length;
-
-        /* print value */
-        if (!print_value(current_item, output_buffer)) {
-            return false;
+        if (can_read(input_buffer, 5) && (strncmp((const char*)buffer_at_offset(input_buffer), c_false, c_false_len) == 0)) {
+            *(bool *)member = false;
+            input_buffer->offset += c_false_len;
+            return true;
         }
-        update_offset(output_buffer);
+        break;
+    case JFIELD_STRING:
+        if ((c == '\"') && (field->size > 0)) {
+            return parse_struct_string(member, field->size, input_buffer);
+        }
+        break;
+    default:
+        break;
+    }
 
-        /* print comma if not last */
-        length = (size_t) ((output_buffer->format ? 1 : 0) + (current_item->next ? 1 : 0));
-        output_pointer = ensure(output_buffer, length + 1);
-        if (output_pointer == NULL) {
-            return false;
+    return skip_value(input_buffer);
+}
+
+/* Parse the members of an object into the fields of a struct, first finding the object named by the path. */
+static Jbool parse_struct(parse_buffer * const input_buffer, const char *path, unsigned char * const s, const JField *fields)
+{
+    Jbool descended = false;
+
+    do {
+        descended = false;
+
+        if (cannot_access_at_index(input_buffer, 0) || (buffer_at_offset(input_buffer)[0] != '{')) {
+            return false; /* not an object */
         }
-        if (current_item->next) {
-            *output_pointer++ = ',';
+        input_buffer->offset++;
+        buffer_skip_whitespace(input_buffer);
+        if (can_access_at_index(input_buffer, 0) && (buffer_at_offset(input_buffer)[0] == '}')) {
+            input_buffer->offset++;
+            return (path == NULL); /* empty object */
         }
 
-        if (output_buffer->format) {
-            *output_pointer++ = '\n';
+        /* loop through the comma separated object elements */
+        for (;;) {
+            const unsigned char *key = NULL;
+            size_t key_len = 0;
+            Jbool escaped = false;
+
+            /* find the name of the member, which can't match if it has escapes */
+            buffer_skip_whitespace(input_buffer);
+            if (cannot_access_at_index(input_buffer, 0) || (buffer_at_offset(input_buffer)[0] != '\"')) {
+                return false; /* failed to parse name */
+            }
+            key = buffer_at_offset(input_buffer) + 1;
+            for (; can_access_at_index(input_buffer, key_len + 1) && (key[key_len] != '\"'); key_len++) {
+                if (key[key_len] == '\\') {
+                    escaped = true;
+                    key_len++;
+                }
+            }
+            if (cannot_access_at_index(input_buffer, key_len + 1)) {
+                return false; /* name ended unexpectedly */
+            }
+            input_buffer->offset += key_len + 2;
+            buffer_skip_whitespace(input_buffer);
+            if (cannot_access_at_index(input_buffer, 0) || (buffer_at_offset(input_buffer)[0] != ':')) {
+                return false; /* invalid object */
+            }
+            input_buffer->offset++;
+            buffer_skip_whitespace(input_buffer);
+            if (cannot_access_at_index(input_buffer, 0)) {
+                return false;
+            }
+
+            if (path != NULL) {
+                /* descend into the object named by the next part of the path, skipping everything else */
+                size_t part_len = strcspn(path, ".");
+                if (!escaped && (key_len == part_len) && (case_insensitive_strncmp((const unsigned char*)path, key, key_len) == 0) && (buffer_at_offset(input_buffer)[0] == '{')) {
+                    path = (path[part_len] == '.') ? &path[part_len + 1] : NULL;
+                    descended = true;
+                    break;
+                }
+                if (!skip_value(input_buffer)) {
+                    return false;
+                }
+            } else {
+                const JField *field = escaped ? NULL : find_field(fields, key, key_len);
+                if (field == NULL) {
+                    if (!skip_value(input_buffer)) {
+                        return false;
+                    }
+                } else if (!parse_struct_field(s + field->offset, field, input_buffer)) {
+                    return false;
+                }
+            }
+
+            buffer_skip_whitespace(input_buffer);
+            if (cannot_access_at_index(input_buffer, 0)) {
+                return false;
+            }
+            if (buffer_at_offset(input_buffer)[0] == ',') {
+                input_buffer->offset++;
+                continue;
+            }
+            if (buffer_at_offset(input_buffer)[0] != '}') {
+                return false; /* expected end of object */
+            }
+            input_buffer->offset++;
+            return (path == NULL);
         }
-        *output_pointer = '\0';
-        output_buffer->offset += length;
+    } while (descended);
 
-        current_item = current_item->next;
-    }
+    return false;
+}
 
-    output_pointer = ensure(output_buffer, output_buffer->format ? (output_buffer->depth + 1) : 2);
-    if (output_pointer == NULL) {
+N_CJSON_PUBLIC(Jbool) JParseStruct(const char *value, const char *path, void *s, const JField *fields)
+{
+    parse_buffer buffer = { 0, 0, 0, 0 };
+
+    if ((value == NULL) || (s == NULL) || (fields == NULL)) {
         return false;
     }
-    if (output_buffer->format) {
-        size_t i;
-        for (i = 0; i < (output_buffer->depth - 1); i++) {
-            *output_pointer++ = '\t';
-        }
-    }
-    *output_pointer++ = '}';
-    *output_pointer = '\0';
-    output_buffer->depth--;
 
-    return true;
+    buffer.content = (const unsigned char*)value;
+    buffer.length = strlen((const char*)value) + 1;   // Trailing '\0'
+    buffer.offset = 0;
+
+    return parse_struct(buffer_skip_whitespace(skip_utf8_bom(&buffer)), path, (unsigned char*)s, fields);
 }
 
 /* Get Array size/item / object item. */
@@ -1573,9 +3531,24 @@ static J *get_object_item(const J * const object, const char * const name, const
             current_element = current_element->next;
         }
     } else {
+#ifdef N_CJSON_INDEX_THRESHOLD
+        const JIndex *index = index_of(object);
+        size_t scanned = 0;
+        if (index != NULL) {
+            return index_find(index, name);
+        }
+        while ((current_element != NULL) && (case_insensitive_strcmp((const unsigned char*)name, (const unsigned char*)(current_element->string)) != 0)) {
+            current_element = current_element->next;
+            scanned++;
+        }
+        if (scanned >= N_CJSON_INDEX_THRESHOLD) {
+            index_build((J *)cast_away_const(object));
+        }
+#else
         while ((current_element != NULL) && (case_insensitive_strcmp((const unsigned char*)name, (const unsigned char*)(current_element->string)) != 0)) {
             current_element = current_element->next;
         }
+#endif
     }
 
     return current_element;
@@ -1609,7 +3582,26 @@ N_CJSON_PUBLIC(Jbool) JHasObjectItem(const J *object, const char *string)
 static void suffix_object(J *prev, J *item)
 {
     prev->next = item;
+#ifndef N_CJSON_SINGLY_LINKED
     item->prev = prev;
+#endif
+}
+
+/* Utility for finding the item before another in its parent's list, or NULL if it is the first. */
+static J *previous_item(const J *parent, const J *item)
+{
+#ifdef N_CJSON_SINGLY_LINKED
+    J *prev = NULL;
+    J *current = parent->child;
+    while ((current != NULL) && (current != item)) {
+        prev = current;
+        current = current->next;
+    }
+    return prev;
+#else
+    (void)parent;
+    return item->prev;
+#endif
 }
 
 /* Utility for handling references. */
@@ -1627,8 +3619,14 @@ static J *create_reference(const J *item)
 
     memcpy(reference, item, sizeof(J));
     reference->string = NULL;
-    reference->type |= JIsReference;
-    reference->next = reference->prev = NULL;
+    reference->type = (reference->type & ~(JIsArena|JIsArenaRoot)) | JIsReference;
+    if ((reference->type & 0xFF) == JObject) {
+        reference->valuestring = NULL; /* the index, if any, is the original's */
+    }
+    reference->next = NULL;
+#ifndef N_CJSON_SINGLY_LINKED
+    reference->prev = NULL;
+#endif
     return reference;
 }
 
@@ -1640,6 +3638,7 @@ static Jbool add_item_to_array(J *array, J *item)
         return false;
     }
 
+    index_discard(array);
     child = array->child;
 
     if (child == NULL) {
@@ -1819,6 +3818,21 @@ N_CJSON_PUBLIC(J*) JAddNumberToObject(J * const object, const char * const name,
     return NULL;
 }
 
+N_CJSON_PUBLIC(J*) JAddIntToObject(J * const object, const char * const name, const long int number)
+{
+    if (object == NULL) {
+        return NULL;
+    }
+
+    J *number_item = JCreateInteger(number);
+    if (add_item_to_object(object, name, number_item, false)) {
+        return number_item;
+    }
+
+    JDelete(number_item);
+    return NULL;
+}
+
 N_CJSON_PUBLIC(J*) JAddStringToObject(J * const object, const char * const name, const char * const string)
 {
     if (object == NULL || string == NULL) {
@@ -1885,21 +3899,27 @@ N_CJSON_PUBLIC(J *) JDetachItemViaPointer(J *parent, J * const item)
         return NULL;
     }
 
-    if (item->prev != NULL) {
+    index_discard(parent);
+    J *prev = previous_item(parent, item);
+    if (prev != NULL) {
         /* not the first element */
-        item->prev->next = item->next;
+        prev->next = item->next;
     }
+#ifndef N_CJSON_SINGLY_LINKED
     if (item->next != NULL) {
         /* not the last element */
-        item->next->prev = item->prev;
+        item->next->prev = prev;
     }
+#endif
 
     if (item == parent->child) {
         /* first element */
         parent->child = item->next;
     }
     /* make sure the detached item doesn't point anywhere anymore */
+#ifndef N_CJSON_SINGLY_LINKED
     item->prev = NULL;
+#endif
     item->next = NULL;
 
     return item;
@@ -1982,13 +4002,17 @@ N_CJSON_PUBLIC(void) JInsertItemInArray(J *array, int which, J *newitem)
         return;
     }
 
+    index_discard(array);
+    J *prev = previous_item(array, after_inserted);
     newitem->next = after_inserted;
-    newitem->prev = after_inserted->prev;
+#ifndef N_CJSON_SINGLY_LINKED
+    newitem->prev = prev;
     after_inserted->prev = newitem;
+#endif
     if (after_inserted == array->child) {
         array->child = newitem;
     } else {
-        newitem->prev->next = newitem;
+        prev->next = newitem;
     }
 }
 
@@ -2002,21 +4026,26 @@ N_CJSON_PUBLIC(Jbool) JReplaceItemViaPointer(J * const parent, J * const item, J
         return true;
     }
 
+    index_discard(parent);
+    J *prev = previous_item(parent, item);
     replacement->next = item->next;
-    replacement->prev = item->prev;
-
+#ifndef N_CJSON_SINGLY_LINKED
+    replacement->prev = prev;
     if (replacement->next != NULL) {
         replacement->next->prev = replacement;
     }
-    if (replacement->prev != NULL) {
-        replacement->prev->next = replacement;
+#endif
+    if (prev != NULL) {
+        prev->next = replacement;
     }
     if (parent->child == item) {
         parent->child = replacement;
     }
 
     item->next = NULL;
+#ifndef N_CJSON_SINGLY_LINKED
     item->prev = NULL;
+#endif
     JDelete(item);
 
     return true;
@@ -2111,15 +4140,20 @@ N_CJSON_PUBLIC(J *) JCreateNumber(JNUMBER num)
     J *item = JNew_Item();
     if(item) {
         item->type = JNumber;
-        item->valuenumber = num;
-        /* use saturation in case of overflow */
-        if (num >= LONG_MAX) {
-            item->valueint = LONG_MAX;
-        } else if (num <= LONG_MIN) {
-            item->valueint = LONG_MIN;
-        } else {
-            item->valueint = (long int)num;
-        }
+        set_number(item, num);
+    }
+    return item;
+}
+
+N_CJSON_PUBLIC(J *) JCreateInteger(long int num)
+{
+    J *item = JNew_Item();
+    if(item) {
+        item->type = JNumber;
+        item->valuenumber = number_from_int(num);
+#ifndef N_CJSON_COMPACT
+        item->valueint = num;
+#endif
     }
     return item;
 }
@@ -2324,17 +4358,26 @@ N_CJSON_PUBLIC(J *) JDuplicate(const J *item, Jbool recurse)
         goto fail;
     }
     /* Copy over all vars */
-    newitem->type = item->type & (~JIsReference);
+    newitem->type = item->type & ~(JIsReference|JIsArena|JIsArenaRoot);
+    if (item->type & JIsArena) {
+        newitem->type &= ~JStringIsConst; /* the key is owned by the arena, so it must be copied */
+    }
+#ifndef N_CJSON_COMPACT
     newitem->valueint = item->valueint;
     newitem->valuenumber = item->valuenumber;
-    if (item->valuestring) {
+#else
+    if (item->type & JNumber) {
+        newitem->valuenumber = item->valuenumber; /* which would otherwise copy whatever shares its storage */
+    }
+#endif
+    if ((item->type & (JString|JRaw)) && item->valuestring) {
         newitem->valuestring = (char*)Jstrdup((unsigned char*)item->valuestring);
         if (!newitem->valuestring) {
             goto fail;
         }
     }
     if (item->string) {
-        newitem->string = (item->type&JStringIsConst) ? item->string : (char*)Jstrdup((unsigned char*)item->string);
+        newitem->string = (newitem->type&JStringIsConst) ? item->string : (char*)Jstrdup((unsigned char*)item->string);
         if (!newitem->string) {
             goto fail;
         }
@@ -2353,7 +4396,9 @@ N_CJSON_PUBLIC(J *) JDuplicate(const J *item, Jbool recurse)
         if (next != NULL) {
             /* If newitem->child already set, then crosswire ->prev and ->next and move on */
             next->next = newchild;
+#ifndef N_CJSON_SINGLY_LINKED
             newchild->prev = next;
+#endif
             next = newchild;
         } else {
             /* Set newitem->child and move to it */
@@ -68,12 +68,37 @@ extern "C"
 
 #define JIsReference 256
 #define JStringIsConst 512
+#define JIsArena 1024
+#define JIsArenaRoot 2048
 
 /* The J structure: */
+/* Define N_CJSON_COMPACT to shrink each item on small targets: valuestring and valuenumber share storage
+   (so only read the one that matches the type), valueint is dropped in favour of JIntValue(), and the type
+   is held in a short.  Define N_CJSON_SINGLY_LINKED as well to drop the prev pointer, at the cost of
+   walking the parent's list when detaching, inserting or replacing an item. */
+#ifdef N_CJSON_COMPACT
+typedef struct J {
+    struct J *next;
+#ifndef N_CJSON_SINGLY_LINKED
+    struct J *prev;
+#endif
+    struct J *child;
+    char *string;
+    union {
+        /* The item's string, if type==JString  and type == JRaw */
+        char *valuestring;
+        /* The item's number, if type==JNumber */
+        JNUMBER valuenumber;
+    };
+    unsigned short type;
+} J;
+#else
 typedef struct J {
     /* next/prev allow you to walk array/object chains. Alternatively, use GetArraySize/GetArrayItem/GetObjectItem */
     struct J *next;
+#ifndef N_CJSON_SINGLY_LINKED
     struct J *prev;
+#endif
     /* An array or object item will have a child pointer pointing to a chain of the items in the array/object. */
     struct J *child;
 
@@ -89,6 +114,7 @@ typedef struct J {
     /* The item's name string, if this item is the child of, or is in the list of subitems of an object. */
     char *string;
 } J;
+#endif
 
 typedef struct JHooks {
     void *(*malloc_fn)(size_t sz);
@@ -140,10 +166,25 @@ then using the N_CJSON_API_VISIBILITY flag to "export" the same symbols the way
 #endif
 #endif
 
-/* Limits how deeply nested arrays/objects can be before J rejects to parse them.
- * This is to prevent stack overflows. */
+/* Limits how deeply nested arrays/objects can be before J rejects to parse or print them.
+ * Rather than recursing, parsing and printing keep this many levels of state on the stack. */
 #ifndef N_CJSON_NESTING_LIMIT
-#define N_CJSON_NESTING_LIMIT 1000
+#ifdef NOTE_LOWMEM
+#define N_CJSON_NESTING_LIMIT 16
+#else
+#define N_CJSON_NESTING_LIMIT 64
+#endif
+#endif
+
+/* Limits how deeply nested arrays/objects can be when parsing incrementally with JParseStream*.
+ * The incremental parser keeps this many levels of state in the JStream itself. */
+#ifndef N_CJSON_STREAM_NESTING_LIMIT
+#define N_CJSON_STREAM_NESTING_LIMIT 16
+#endif
+
+/* The smallest window that JPrintToSink can render through, which must hold the longest number plus a '\0' */
+#ifndef N_CJSON_PRINT_WINDOW_MIN
+#define N_CJSON_PRINT_WINDOW_MIN (JNTOA_MAX+2)
 #endif
 
 /* returns the version of J as a string */
@@ -158,6 +199,25 @@ N_CJSON_PUBLIC(J *) JParse(const char *value);
 /* ParseWithOpts allows you to require (and check) that the JSON is null terminated, and to retrieve the pointer to the final byte parsed. */
 /* If you supply a ptr in return_parse_end and parsing fails, then return_parse_end will contain a pointer to the error so will match JGetErrorPtr(). */
 N_CJSON_PUBLIC(J *) JParseWithOpts(const char *value, const char **return_parse_end, Jbool require_null_terminated);
+/* Parse into an arena, a single allocation sized by scanning the text, that is freed all at once when the document is
+ * deleted with JDelete. Items detached from the document must not outlive it. JArenaStats reports the bytes held by
+ * all arenas now, and the most ever held at once. */
+N_CJSON_PUBLIC(J *) JParseArena(const char *value);
+/* Parse in place, unescaping strings within the text and leaving them there. On success the text, which must have been
+ * allocated with JMalloc, is adopted by the document and freed with it. On failure it is left to the caller, altered. */
+N_CJSON_PUBLIC(J *) JParseInSitu(char *value);
+/* Parse only the fields of an object named in a NULL-terminated list, as dotted paths such as "body.temp", skipping
+ * over the values of all others without building them. Keys are matched case insensitively, as by JGetObjectItem.
+ * Text that isn't an object is parsed in full. */
+N_CJSON_PUBLIC(J *) JParseFields(const char *value, const char * const *fields);
+N_CJSON_PUBLIC(void) JArenaStats(size_t *used, size_t *high_water);
+/* Incremental parsing, for JSON that arrives in pieces. Feed it chunks of any size as they arrive and the J tree is
+ * built as each value completes, so the text never needs to be held in memory in its entirety. JParseStreamEnd frees
+ * the stream and returns the document, or NULL if it was incomplete or malformed. */
+typedef struct JStream JStream;
+N_CJSON_PUBLIC(JStream *) JParseStreamBegin(void);
+N_CJSON_PUBLIC(Jbool) JParseStreamFeed(JStream *stream, const char *data, size_t length);
+N_CJSON_PUBLIC(J *) JParseStreamEnd(JStream *stream);
 
 /* Render a J entity to text for transfer/storage. */
 N_CJSON_PUBLIC(char *) JPrint(const J *item);
@@ -166,8 +226,41 @@ N_CJSON_PUBLIC(char *) JPrintUnformatted(const J *item);
 /* Render a J entity to text using a buffered strategy. prebuffer is a guess at the final size. guessing well reduces reallocation. fmt=0 gives unformatted, =1 gives formatted */
 N_CJSON_PUBLIC(char *) JPrintBuffered(const J *item, int prebuffer, Jbool fmt);
 /* Render a J entity to text using a buffer already allocated in memory with given length. Returns 1 on success and 0 on failure. */
-/* NOTE: J is not always 100% accurate in estimating how much memory it will use, so to be safe allocate 5 bytes more than you actually need */
+/* The buffer must hold the text and its '\0', which is one byte more than JPrintLength returns */
 N_CJSON_PUBLIC(Jbool) JPrintPreallocated(J *item, char *buffer, const int length, const Jbool format);
+/* Measure the length of the text that a J entity renders to, not including the '\0', without allocating. Returns 0 on failure. */
+N_CJSON_PUBLIC(size_t) JPrintLength(const J *item, Jbool fmt);
+/* Render a J entity to text through a small caller-supplied window, handing the text to sink in pieces as the window
+ * fills rather than ever holding all of it in memory. The sink returns false to abandon the print. Returns 1 on success. */
+typedef Jbool (*JPrintSinkFn)(void *context, const char *data, size_t length);
+N_CJSON_PUBLIC(Jbool) JPrintToSink(const J *item, char *window, const int length, const Jbool fmt, JPrintSinkFn sink, void *context);
+/* Render and parse a C struct directly, without building J items, as described by a table of its fields that ends
+ * with JFIELD_END. Strings are char arrays, which are always null-terminated and truncated to fit when parsed. */
+typedef struct {
+    const char *key;
+    unsigned short offset;
+    unsigned char type;
+    unsigned short size;
+} JField;
+#define JFIELD_NUMBER   1   /* JNUMBER */
+#define JFIELD_DOUBLE   2   /* double, which fixed point and float builds convert with integer arithmetic, to 6 decimal places */
+#define JFIELD_INT32    3   /* int32_t */
+#define JFIELD_UINT32   4   /* uint32_t */
+#define JFIELD_BOOL     5   /* bool */
+#define JFIELD_STRING   6   /* char[] */
+#define JFIELD(structType, member, fieldType, key) { (key), (unsigned short)offsetof(structType, member), (fieldType), (unsigned short)sizeof(((structType *)0)->member) }
+#define JFIELD_END { NULL, 0, 0, 0 }
+/* Render a struct as an object with a member for each field, in a single allocation. */
+N_CJSON_PUBLIC(char *) JPrintStruct(const void *s, const JField *fields);
+/* Create a raw item holding a struct rendered as an object, such as the body of a note to be added. */
+N_CJSON_PUBLIC(J *) JCreateStruct(const void *s, const JField *fields);
+/* Parse the members of an object that match fields into a struct, skipping the rest and leaving the fields that are
+ * missing or of another type as they were. Keys are matched case insensitively. A path such as "body" names an object within it to be parsed instead.
+ * Returns 1 if the object was found and parsed, and 0 if it wasn't or the text is malformed. Fields are stored as they
+ * are parsed, so text that turns out to be malformed can leave those before the error updated; parse into a copy if
+ * the struct must be left as it was. */
+N_CJSON_PUBLIC(Jbool) JParseStruct(const char *value, const char *path, void *s, const JField *fields);
+
 /* Delete a J entity and all subentities. */
 N_CJSON_PUBLIC(void) JDelete(J *c);
 
@@ -176,6 +269,9 @@ N_CJSON_PUBLIC(int) JGetArraySize(const J *array);
 /* Retrieve item number "index" from array "array". Returns NULL if unsuccessful. */
 N_CJSON_PUBLIC(J *) JGetArrayItem(const J *array, int index);
 /* Get item "string" from object. Case insensitive. */
+/* Define N_CJSON_INDEX_THRESHOLD to have an object that is searched past that many children indexed by key, so that
+ * later searches of it don't scan. The index is discarded when children are added, removed or replaced through this
+ * API, but not if the list is altered directly. Objects of more than N_CJSON_INDEX_MAX_ITEMS (255) are never indexed. */
 N_CJSON_PUBLIC(J *) JGetObjectItem(const J * const object, const char * const string);
 N_CJSON_PUBLIC(J *) JGetObjectItemCaseSensitive(const J * const object, const char * const string);
 N_CJSON_PUBLIC(Jbool) JHasObjectItem(const J *object, const char *string);
@@ -203,6 +299,8 @@ N_CJSON_PUBLIC(J *) JCreateTrue(void);
 N_CJSON_PUBLIC(J *) JCreateFalse(void);
 N_CJSON_PUBLIC(J *) JCreateBool(Jbool boolean);
 N_CJSON_PUBLIC(J *) JCreateNumber(JNUMBER num);
+/* Create a number from an integer, which is kept exactly even if JNUMBER can't hold it (except in the compact layout). */
+N_CJSON_PUBLIC(J *) JCreateInteger(long int num);
 N_CJSON_PUBLIC(J *) JCreateString(const char *string);
 /* raw json */
 N_CJSON_PUBLIC(J *) JCreateRaw(const char *raw);
@@ -269,6 +367,7 @@ N_CJSON_PUBLIC(J*) JAddTrueToObject(J * const object, const char * const name);
 N_CJSON_PUBLIC(J*) JAddFalseToObject(J * const object, const char * const name);
 N_CJSON_PUBLIC(J*) JAddBoolToObject(J * const object, const char * const name, const Jbool boolean);
 N_CJSON_PUBLIC(J*) JAddNumberToObject(J * const object, const char * const name, const JNUMBER number);
+N_CJSON_PUBLIC(J*) JAddIntToObject(J * const object, const char * const name, const long int number);
 N_CJSON_PUBLIC(J*) JAddStringToObject(J * const object, const char * const name, const char * const string);
 N_CJSON_PUBLIC(J*) JAddRawToObject(J * const object, const char * const name, const char * const raw);
 N_CJSON_PUBLIC(J*) JAddObjectToObject(J * const object, const char * const name);
@@ -277,8 +376,15 @@ N_CJSON_PUBLIC(J*) JAddArrayToObject(J * const object, const char * const name);
 #define JConvertFromJSONString JParse
 
 /* When assigning an integer value, it needs to be propagated to valuenumber too. */
+#if defined(NOTE_FIXED)
+#define JSetIntValue(object, number) ((object) ? JSetIntHelper(object, (long int)(number)) : (number))
+#elif defined(N_CJSON_COMPACT)
+#define JSetIntValue(object, number) ((object) ? (object)->valuenumber = (number) : (number))
+#else
 #define JSetIntValue(object, number) ((object) ? (object)->valueint = (object)->valuenumber = (number) : (number))
-/* helper for the JSetNumberValue macro */
+#endif
+/* helpers for the JSetIntValue and JSetNumberValue macros */
+N_CJSON_PUBLIC(long int) JSetIntHelper(J *object, long int number);
 N_CJSON_PUBLIC(JNUMBER) JSetNumberHelper(J *object, JNUMBER number);
 #define JSetNumberValue(object, number) ((object != NULL) ? JSetNumberHelper(object, (JNUMBER)number) : (number))
 
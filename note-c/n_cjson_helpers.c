@@ -11,6 +11,7 @@
  *
  */
 
+#include <limits.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
@@ -108,6 +109,9 @@ char *JStringValue(J *item)
     if (item == NULL) {
         return (char *)"";
     }
+    if (!(item->type & (JString|JRaw))) {
+        return NULL;
+    }
     return item->valuestring;
 }
 
@@ -123,6 +127,9 @@ JNUMBER JNumberValue(J *item)
     if (item == NULL) {
         return 0.0;
     }
+    if (!JIsNumber(item)) {
+        return 0.0;
+    }
     return item->valuenumber;
 }
 
@@ -161,7 +168,28 @@ long int JIntValue(J *item)
     if (item == NULL) {
         return 0;
     }
+#ifdef N_CJSON_COMPACT
+    // Compact items don't carry an integer, so derive it as the parser would have
+    if (JIsTrue(item)) {
+        return 1;
+    }
+    if (!JIsNumber(item)) {
+        return 0;
+    }
+#ifdef NOTE_FIXED
+    return (long int) (item->valuenumber / JNUMBER_SCALE);
+#else
+    if (item->valuenumber >= LONG_MAX) {
+        return LONG_MAX;
+    }
+    if (item->valuenumber <= LONG_MIN) {
+        return LONG_MIN;
+    }
+    return (long int) item->valuenumber;
+#endif
+#else
     return item->valueint;
+#endif
 }
 
 //**************************************************************************/
@@ -541,7 +569,7 @@ int JGetType(J *rsp, const char *field)
     case JNULL:
         return JTYPE_NULL;
     case JNumber:
-        if (item->valueint == 0 && item->valuenumber == 0) {
+        if (JIntValue(item) == 0 && item->valuenumber == 0) {
             return JTYPE_NUMBER_ZERO;
         }
         return JTYPE_NUMBER;
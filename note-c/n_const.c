@@ -26,3 +26,35 @@ const char *c_cmd = "cmd";
 const char *c_bad = "bad";
 const char *c_iobad = "bad {io}";
 const char *c_ioerr = "{io}";
+
+// Field tables for rendering and parsing the edge structs without J items
+const JField NoteTrackPointFields[] = {
+    JFIELD(TrackPoint, mtime, JFIELD_DOUBLE, TRACKPOINT_MEASUREMENT_TIME),
+    JFIELD(TrackPoint, lat, JFIELD_DOUBLE, TRACKPOINT_LAT),
+    JFIELD(TrackPoint, lon, JFIELD_DOUBLE, TRACKPOINT_LON),
+    JFIELD(TrackPoint, time, JFIELD_UINT32, TRACKPOINT_TIME),
+    JFIELD(TrackPoint, hdop, JFIELD_DOUBLE, TRACKPOINT_HDOP),
+    JFIELD(TrackPoint, journeyTime, JFIELD_UINT32, TRACKPOINT_JOURNEY_TIME),
+    JFIELD(TrackPoint, journeyCount, JFIELD_UINT32, TRACKPOINT_JOURNEY_COUNT),
+    JFIELD(TrackPoint, trackType, JFIELD_STRING, TRACKPOINT_TYPE),
+    JFIELD(TrackPoint, motionCount, JFIELD_UINT32, TRACKPOINT_MOTION_COUNT),
+    JFIELD(TrackPoint, seconds, JFIELD_INT32, TRACKPOINT_SECONDS),
+    JFIELD(TrackPoint, distance, JFIELD_DOUBLE, TRACKPOINT_DISTANCE),
+    JFIELD(TrackPoint, bearing, JFIELD_DOUBLE, TRACKPOINT_BEARING),
+    JFIELD(TrackPoint, velocity, JFIELD_DOUBLE, TRACKPOINT_VELOCITY),
+    JFIELD(TrackPoint, temperature, JFIELD_DOUBLE, TRACKPOINT_TEMPERATURE),
+    JFIELD(TrackPoint, humidity, JFIELD_DOUBLE, TRACKPOINT_HUMIDITY),
+    JFIELD(TrackPoint, pressure, JFIELD_DOUBLE, TRACKPOINT_PRESSURE),
+    JFIELD(TrackPoint, voltage, JFIELD_DOUBLE, TRACKPOINT_VOLTAGE),
+    JFIELD(TrackPoint, usb, JFIELD_BOOL, TRACKPOINT_USB),
+    JFIELD(TrackPoint, charging, JFIELD_BOOL, TRACKPOINT_CHARGING),
+    JFIELD_END
+};
+const JField NoteMotionPointFields[] = {
+    JFIELD(MotionPoint, mtime, JFIELD_DOUBLE, MOTIONPOINT_MEASUREMENT_TIME),
+    JFIELD(MotionPoint, movements, JFIELD_STRING, MOTIONPOINT_MOVEMENTS),
+    JFIELD(MotionPoint, orientation, JFIELD_STRING, MOTIONPOINT_ORIENTATION),
+    JFIELD(MotionPoint, motionCount, JFIELD_UINT32, MOTIONPOINT_MOTION_COUNT),
+    JFIELD(MotionPoint, tiltCount, JFIELD_UINT32, MOTIONPOINT_TILT_COUNT),
+    JFIELD_END
+};
@@ -23,6 +23,50 @@
 #include <stdint.h>
 #include <math.h>
 
+#ifdef NOTE_FIXED
+
+// Convert a fixed-point JNUMBER into a null-terminated text string, with only
+// as many of its JNUMBER_DECIMALS places as it needs.  The scale determines the
+// precision, and so the precision argument is ignored.  As with the floating
+// point version, buf must be pointing at a buffer of JNTOA_MAX length.
+char * JNtoA(JNUMBER f, char * buf, int precision)
+{
+    char digits[JNTOA_MAX];
+    int count = 0;
+    size_t len = 0;
+    bool significant = false;
+    uint32_t magnitude = (f < 0) ? ((uint32_t)0 - (uint32_t)f) : (uint32_t)f;
+    (void)precision;
+
+    // Generate the digits backwards, omitting trailing zeros of the fraction
+    for (int places = 0; places < JNUMBER_DECIMALS; places++) {
+        char digit = (char)('0' + (magnitude % 10));
+        magnitude /= 10;
+        if (significant || (digit != '0')) {
+            significant = true;
+            digits[count++] = digit;
+        }
+    }
+    if (significant) {
+        digits[count++] = '.';
+    }
+    do {
+        digits[count++] = (char)('0' + (magnitude % 10));
+        magnitude /= 10;
+    } while (magnitude != 0);
+
+    if (f < 0) {
+        buf[len++] = '-';
+    }
+    while (count > 0) {
+        buf[len++] = digits[--count];
+    }
+    buf[len] = '\0';
+    return buf;
+}
+
+#else
+
 #define	PRINT_F_QUOTE		0x0001
 #define	PRINT_F_TYPE_E		0x0002
 #define	PRINT_F_TYPE_G		0x0004
@@ -502,3 +546,5 @@ static JNUMBER mypow10(int exponent)
     }
     return result;
 }
+
+#endif // NOTE_FIXED
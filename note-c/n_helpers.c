@@ -58,6 +58,12 @@ static char scSN[128] = {0};
 static char scProduct[128] = {0};
 static char scService[128] = {0};
 
+// Inbound notefiles watched by way of the ATTN pin, and the function to which their notes are delivered
+static const char **inboundFiles = NULL;
+static int inboundFileCount = 0;
+static inboundNoteFn inboundFn = NULL;
+static bool inboundArmed = false;
+
 // For date conversions
 #define daysByMonth(y) ((y)&03||(y)==0?normalYearDaysByMonth:leapYearDaysByMonth)
 static short leapYearDaysByMonth[] = {0, 31, 60, 91, 121, 152, 182, 213, 244, 274, 305, 335};
@@ -66,6 +72,8 @@ static const char *daynames[] = {"Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"
 
 // Forwards
 static bool timerExpiredSecs(uint32_t *timer, uint32_t periodSecs);
+static bool inboundArm(void);
+static int inboundDrain(const char *file);
 static int ytodays(int year);
 
 //**************************************************************************/
@@ -230,7 +238,8 @@ JTIME NoteTimeST()
         if (timerExpiredSecs(&timeTimer, suppressionTimerSecs)) {
 
             // Request time and zone info from the card
-            J *rsp = NoteRequestResponse(NoteNewRequest("card.time"));
+            static const char * const fields[] = {"time", "zone", "minutes", "country", "area", NULL};
+            J *rsp = NoteRequestResponseFields(NoteNewRequest("card.time"), fields);
             if (rsp != NULL) {
                 if (!NoteResponseError(rsp)) {
                     JTIME seconds = JGetInt(rsp, "time");
@@ -503,7 +512,8 @@ bool NoteLocationValidST(char *errbuf, uint32_t errbuflen)
     }
 
     // Request location from the card
-    J *rsp = NoteRequestResponse(NoteNewRequest("card.location"));
+    static const char * const fields[] = {"mode", NULL};
+    J *rsp = NoteRequestResponseFields(NoteNewRequest("card.location"), fields);
     if (rsp == NULL) {
         return false;
     }
@@ -632,7 +642,8 @@ bool NoteGetEnv(const char *variable, const char *defaultVal, char *buf, uint32_
     J *req = NoteNewRequest("env.get");
     if (req != NULL) {
         JAddStringToObject(req, "name", variable);
-        J *rsp = NoteRequestResponse(req);
+        static const char * const fields[] = {"text", NULL};
+        J *rsp = NoteRequestResponseFields(req, fields);
         if (rsp != NULL) {
             if (!NoteResponseError(rsp)) {
                 success = true;
@@ -668,7 +679,8 @@ bool NoteIsConnected()
 bool NoteIsConnectedST()
 {
     if (timerExpiredSecs(&connectivityTimer, suppressionTimerSecs)) {
-        J *rsp = NoteRequestResponse(NoteNewRequest("hub.status"));
+        static const char * const fields[] = {"connected", NULL};
+        J *rsp = NoteRequestResponseFields(NoteNewRequest("hub.status"), fields);
         if (rsp != NULL) {
             if (!NoteResponseError(rsp)) {
                 cardConnected = JGetBool(rsp, "connected");
@@ -691,7 +703,8 @@ bool NoteGetNetStatus(char *statusBuf, int statusBufLen)
 {
     bool success = false;
     statusBuf[0] = '\0';
-    J *rsp = NoteRequestResponse(NoteNewRequest("hub.status"));
+    static const char * const fields[] = {"status", NULL};
+    J *rsp = NoteRequestResponseFields(NoteNewRequest("hub.status"), fields);
     if (rsp != NULL) {
         success = !NoteResponseError(rsp);
         if (success) {
@@ -714,7 +727,8 @@ bool NoteGetVersion(char *versionBuf, int versionBufLen)
 {
     bool success = false;
     versionBuf[0] = '\0';
-    J *rsp = NoteRequestResponse(NoteNewRequest("card.version"));
+    static const char * const fields[] = {"version", NULL};
+    J *rsp = NoteRequestResponseFields(NoteNewRequest("card.version"), fields);
     if (rsp != NULL) {
         success = !NoteResponseError(rsp);
         if (success) {
@@ -751,7 +765,8 @@ bool NoteGetLocation(JNUMBER *retLat, JNUMBER *retLon, JTIME *time, char *status
     if (time != NULL) {
         *time = 0;
     }
-    J *rsp = NoteRequestResponse(NoteNewRequest("card.location"));
+    static const char * const fields[] = {"lat", "lon", "time", NULL};
+    J *rsp = NoteRequestResponseFields(NoteNewRequest("card.location"), fields);
     if (rsp != NULL) {
         if (statusBuf != NULL) {
             strlcpy(statusBuf, JGetString(rsp, "err"), statusBufLen);
@@ -824,7 +839,8 @@ bool NoteGetLocationMode(char *modeBuf, int modeBufLen)
 {
     bool success = false;
     modeBuf[0] = '\0';
-    J *rsp = NoteRequestResponse(NoteNewRequest("card.location.mode"));
+    static const char * const fields[] = {"mode", NULL};
+    J *rsp = NoteRequestResponseFields(NoteNewRequest("card.location.mode"), fields);
     if (rsp != NULL) {
         success = !NoteResponseError(rsp);
         if (success) {
@@ -852,7 +868,7 @@ bool NoteSetLocationMode(const char *mode, uint32_t seconds)
             mode = "-";
         }
         JAddStringToObject(req, "mode", mode);
-        JAddNumberToObject(req, "seconds", seconds);
+        JAddIntToObject(req, "seconds", seconds);
         success = NoteRequest(req);
     }
     return success;
@@ -907,7 +923,8 @@ bool NoteGetServiceConfigST(char *productBuf, int productBufLen, char *serviceBu
 
     // Use cache except for a rare refresh
     if (scProduct[0] == '\0' || scDevice[0] == '\0' || timerExpiredSecs(&serviceConfigTimer, 4*60*60)) {
-        J *rsp = NoteRequestResponse(NoteNewRequest("hub.get"));
+        static const char * const fields[] = {"product", "host", "device", "sn", NULL};
+        J *rsp = NoteRequestResponseFields(NoteNewRequest("hub.get"), fields);
         if (rsp != NULL) {
             success = !NoteResponseError(rsp);
             if (success) {
@@ -965,7 +982,8 @@ bool NoteGetStatus(char *statusBuf, int statusBufLen, JTIME *bootTime, bool *ret
     if (retSignals != NULL) {
         *retSignals = false;
     }
-    J *rsp = NoteRequestResponse(NoteNewRequest("card.status"));
+    static const char * const fields[] = {"status", "time", "usb", "connected", "signals", NULL};
+    J *rsp = NoteRequestResponseFields(NoteNewRequest("card.status"), fields);
     if (rsp != NULL) {
         success = !NoteResponseError(rsp);
         if (success) {
@@ -1010,7 +1028,8 @@ bool NoteGetStatusST(char *statusBuf, int statusBufLen, JTIME *bootTime, bool *r
 
     // Refresh if it's time to do so
     if (timerExpiredSecs(&statusTimer, suppressionTimerSecs)) {
-        J *rsp = NoteRequestResponse(NoteNewRequest("card.status"));
+        static const char * const fields[] = {"status", "time", "usb", "connected", "signals", NULL};
+        J *rsp = NoteRequestResponseFields(NoteNewRequest("card.status"), fields);
         if (rsp != NULL) {
             success = !NoteResponseError(rsp);
             if (success) {
@@ -1126,7 +1145,7 @@ bool NoteSleep(char *stateb64, uint32_t seconds, const char *modes)
             strlcat(modestr, modes, sizeof(modestr));
         }
         JAddStringToObject(req, "mode", modestr);
-        JAddNumberToObject(req, "seconds", seconds);
+        JAddIntToObject(req, "seconds", seconds);
         success = NoteRequest(req);
     }
 
@@ -1186,7 +1205,8 @@ bool NotePayloadRetrieveAfterSleep(NotePayloadDesc *desc)
         return false;
     }
     JAddBoolToObject(req, "start", true);
-    J *rsp = NoteRequestResponse(req);
+    static const char * const fields[] = {"time", "payload", NULL};
+    J *rsp = NoteRequestResponseFields(req, fields);
     if (rsp == NULL) {
         return false;
     }
@@ -1341,7 +1361,7 @@ bool NoteSetUploadMode(const char *uploadMode, int uploadMinutes, bool align)
     if (req != NULL) {
         JAddStringToObject(req, "mode", uploadMode);
         if (uploadMinutes != 0) {
-            JAddNumberToObject(req, "outbound", uploadMinutes);
+            JAddIntToObject(req, "outbound", uploadMinutes);
             // Setting this flag aligns uploads to be grouped within the period,
             // rather than counting the number of minutes from "first modified".
             JAddBoolToObject(req, "align", align);
@@ -1376,13 +1396,13 @@ bool NoteSetSyncMode(const char *uploadMode, int uploadMinutes, int downloadMinu
     if (req != NULL) {
         JAddStringToObject(req, "mode", uploadMode);
         if (uploadMinutes != 0) {
-            JAddNumberToObject(req, "outbound", uploadMinutes);
+            JAddIntToObject(req, "outbound", uploadMinutes);
             // Setting this flag aligns uploads to be grouped within the period,
             // rather than counting the number of minutes from "first modified".
             JAddBoolToObject(req, "align", align);
         }
         if (downloadMinutes != 0) {
-            JAddNumberToObject(req, "inbound", downloadMinutes);
+            JAddIntToObject(req, "inbound", downloadMinutes);
         }
         // Setting this flag when mode is "continuous" causes an immediate sync
         // when a file is modified on the service side via HTTP
@@ -1515,7 +1535,8 @@ bool NoteGetVoltage(JNUMBER *voltage)
 {
     bool success = false;
     *voltage = 0.0;
-    J *rsp = NoteRequestResponse(NoteNewRequest("card.voltage"));
+    static const char * const fields[] = {"value", NULL};
+    J *rsp = NoteRequestResponseFields(NoteNewRequest("card.voltage"), fields);
     if (rsp != NULL) {
         if (!NoteResponseError(rsp)) {
             *voltage = JGetNumber(rsp, "value");
@@ -1720,6 +1741,154 @@ bool NoteDebugSyncStatus(int pollFrequencyMs, int maxLevel)
 
 }
 
+//**************************************************************************/
+/*!
+  @brief  Watch inbound notefiles by way of the Notecard's ATTN pin, rather
+  than polling them.  The ATTN pin is armed with `card.attn` so that it goes
+  high when a note arrives in any of the files, at which point the host, having
+  seen it do so (typically in a pin-change ISR), calls NoteInboundDispatch().
+  @param  files The inbound (.qi) notefiles to watch, which must remain valid
+  until they are no longer being watched.
+  @param  count The number of files.
+  @param  fn The function to which their notes are delivered.
+  @returns boolean. `true` if the ATTN pin was armed.
+*/
+/**************************************************************************/
+bool NoteInboundArm(const char **files, int count, inboundNoteFn fn)
+{
+    inboundFiles = files;
+    inboundFileCount = count;
+    inboundFn = fn;
+    return inboundArm();
+}
+
+//**************************************************************************/
+/*!
+  @brief  Stop watching inbound notefiles by way of the ATTN pin.
+  @returns boolean. `true` if the ATTN pin was disarmed.
+*/
+/**************************************************************************/
+bool NoteInboundDisarm(void)
+{
+    inboundArmed = false;
+    inboundFiles = NULL;
+    inboundFileCount = 0;
+    inboundFn = NULL;
+    J *req = NoteNewRequest("card.attn");
+    if (req == NULL) {
+        return false;
+    }
+    JAddStringToObject(req, "mode", "disarm,-files");
+    return NoteRequest(req);
+}
+
+//**************************************************************************/
+/*!
+  @brief  Determine whether inbound notefiles are being watched by way of
+  the ATTN pin, which is to say whether it is expected to go high when a note
+  arrives.
+  @returns boolean. `true` if the ATTN pin is armed.
+*/
+/**************************************************************************/
+bool NoteInboundArmed(void)
+{
+    return inboundArmed;
+}
+
+//**************************************************************************/
+/*!
+  @brief  Having seen the ATTN pin go high, deliver the notes that have
+  arrived in the watched notefiles.  Only those files that the Notecard
+  reports as having changed are drained, and the pin is rearmed before they
+  are, so that a note arriving while they're being drained raises it again
+  rather than going unnoticed.
+  @returns The number of notes delivered, or -1 if the Notecard couldn't
+  be asked which files changed or the pin couldn't be rearmed, in which case
+  this should be called again later to try again.
+*/
+/**************************************************************************/
+int NoteInboundDispatch(void)
+{
+    if (inboundFiles == NULL) {
+        return 0;
+    }
+
+    // Find out which files changed, which rearming forgets
+    J *rsp = NoteRequestResponse(NoteNewRequest("card.attn"));
+    if (rsp == NULL) {
+        return -1;
+    }
+    if (NoteResponseError(rsp) || !inboundArm()) {
+        NoteDeleteResponse(rsp);
+        return -1;
+    }
+
+    // Drain those of them that are being watched
+    int delivered = 0;
+    J *file;
+    JArrayForEach(file, JGetObjectItem(rsp, "files")) {
+        if (!JIsString(file)) {
+            continue;
+        }
+        for (int i=0; i<inboundFileCount; i++) {
+            if (strcmp(file->valuestring, inboundFiles[i]) == 0) {
+                delivered += inboundDrain(inboundFiles[i]);
+                break;
+            }
+        }
+    }
+    NoteDeleteResponse(rsp);
+    return delivered;
+}
+
+// Arm the ATTN pin to go high when a note arrives in any of the watched files
+static bool inboundArm(void)
+{
+    inboundArmed = false;
+    J *req = NoteNewRequest("card.attn");
+    if (req == NULL) {
+        return false;
+    }
+    JAddStringToObject(req, "mode", "arm,files");
+    J *files = JCreateStringArray(inboundFiles, inboundFileCount);
+    if (files == NULL) {
+        JDelete(req);
+        return false;
+    }
+    JAddItemToObject(req, "files", files);
+    inboundArmed = NoteRequest(req);
+    return inboundArmed;
+}
+
+// Deliver and delete the notes queued in an inbound file until none are left, returning how many
+// there were.  As with NoteDebugSyncStatus(), an error means that none are left.
+static int inboundDrain(const char *file)
+{
+    int delivered = 0;
+    while (true) {
+        J *req = NoteNewRequest("note.get");
+        if (req == NULL) {
+            break;
+        }
+        JAddStringToObject(req, "file", file);
+        JAddBoolToObject(req, "delete", true);
+        J *rsp = NoteRequestResponse(req);
+        if (rsp == NULL) {
+            break;
+        }
+        if (NoteResponseError(rsp)) {
+            NoteDeleteResponse(rsp);
+            break;
+        }
+        if (inboundFn != NULL) {
+            inboundFn(file, rsp);
+        }
+        NoteDeleteResponse(rsp);
+        delivered++;
+    }
+    return delivered;
+}
+
 // A general purpose, super nonperformant, but accurate way of figuring out how much memory
 // is available, while exercising the allocator to ensure that it competently deals with
 // adjacent block coalescing on free.
@@ -82,6 +82,13 @@ mallocFn hookMalloc = NULL;
 /**************************************************************************/
 freeFn hookFree = NULL;
 //**************************************************************************/
+/*!
+  @brief  Hook for the calling platform's memory reallocation function, if
+  any.
+*/
+/**************************************************************************/
+reallocFn hookRealloc = NULL;
+//**************************************************************************/
 /*!
   @brief  Hook for the calling platform's delay function.
 */
@@ -128,6 +135,18 @@ serialAvailableFn hookSerialAvailable = NULL;
 */
 /**************************************************************************/
 serialReceiveFn hookSerialReceive = NULL;
+//**************************************************************************/
+/*!
+  @brief  Hook for the calling platform's Serial wait function, if any.
+*/
+/**************************************************************************/
+serialWaitFn hookSerialWait = NULL;
+//**************************************************************************/
+/*!
+  @brief  Hook for the calling platform's Serial block receive function, if any.
+*/
+/**************************************************************************/
+serialReceiveBlockFn hookSerialReceiveBlock = NULL;
 
 //**************************************************************************/
 /*!
@@ -162,9 +181,11 @@ i2cReceiveFn hookI2CReceive = NULL;
 
 // Internal hooks
 typedef bool (*nNoteResetFn) (void);
-typedef const char * (*nTransactionFn) (char *, char **);
+typedef const char * (*nTransactionBeginFn) (char *, J *, char **, JStream *, transactionReply *);
+typedef const char * (*nTransactionPollFn) (transactionReply *, bool);
 static nNoteResetFn notecardReset = NULL;
-static nTransactionFn notecardTransaction = NULL;
+static nTransactionBeginFn notecardTransactionBegin = NULL;
+static nTransactionPollFn notecardTransactionPoll = NULL;
 
 //**************************************************************************/
 /*!
@@ -212,6 +233,20 @@ void NoteSetFn(mallocFn mallocfn, freeFn freefn, delayMsFn delayfn, getMsFn mill
     hookGetMs = millisfn;
 }
 
+//**************************************************************************/
+/*!
+  @brief  Set the platform-specific memory reallocation hook, which is
+  optional.  When it is set, buffers that grow as a reply arrives can
+  often be extended in place rather than copied.
+  @param   reallocfn  The platform-specific memory reallocation `realloc`
+  function to use, or NULL to allocate, copy, and free instead.
+*/
+/**************************************************************************/
+void NoteSetFnRealloc(reallocFn reallocfn)
+{
+    hookRealloc = reallocfn;
+}
+
 //**************************************************************************/
 /*!
   @brief  Set the platform-specific debug output function.
@@ -274,7 +309,39 @@ void NoteSetFnSerial(serialResetFn resetfn, serialTransmitFn transmitfn, serialA
     hookSerialReceive = receivefn;
 
     notecardReset = serialNoteReset;
-    notecardTransaction = serialNoteTransaction;
+    notecardTransactionBegin = serialNoteTransactionBegin;
+    notecardTransactionPoll = serialNoteTransactionPoll;
+}
+
+//**************************************************************************/
+/*!
+  @brief  Set the platform-specific Serial wait function, which is optional.
+  When it is set, waiting for a reply from the Notecard sleeps until data
+  arrives rather than polling for it.
+  @param   waitfn  The platform-specific function that waits up to the
+  specified number of milliseconds for Serial data to be available,
+  returning whether it is, or NULL to poll instead.
+*/
+/**************************************************************************/
+void NoteSetFnSerialWait(serialWaitFn waitfn)
+{
+    hookSerialWait = waitfn;
+}
+
+//**************************************************************************/
+/*!
+  @brief  Set the platform-specific Serial block receive function, which is
+  optional.  When it is set, a reply from the Notecard is received as many
+  bytes at a time as have arrived, rather than a byte at a time by way of
+  the available and receive functions.
+  @param   receiveblockfn  The platform-specific function that receives up
+  to the specified number of bytes of Serial data, without waiting for any,
+  returning how many it received, or NULL to receive a byte at a time.
+*/
+/**************************************************************************/
+void NoteSetFnSerialReceiveBlock(serialReceiveBlockFn receiveblockfn)
+{
+    hookSerialReceiveBlock = receiveblockfn;
 }
 
 //**************************************************************************/
@@ -301,7 +368,8 @@ void NoteSetFnI2C(uint32_t i2caddress, uint32_t i2cmax, i2cResetFn resetfn, i2cT
     hookI2CReceive = receivefn;
 
     notecardReset = i2cNoteReset;
-    notecardTransaction = i2cNoteTransaction;
+    notecardTransactionBegin = i2cNoteTransactionBegin;
+    notecardTransactionPoll = i2cNoteTransactionPoll;
 }
 
 //**************************************************************************/
@@ -315,7 +383,8 @@ void NoteSetFnDisabled()
     hookActiveInterface = interfaceNone;
 
     notecardReset = NULL;
-    notecardTransaction = NULL;
+    notecardTransactionBegin = NULL;
+    notecardTransactionPoll = NULL;
 
 }
 
@@ -450,6 +519,30 @@ void *NoteMalloc(size_t size)
 #endif
 }
 
+//**************************************************************************/
+/*!
+  @brief  Resize a memory chunk using the platform-specific hook, or by
+  allocating, copying, and freeing if there is no such hook.
+  @param   p the chunk to resize, or NULL to allocate a new one.
+  @param   oldSize the number of bytes currently allocated to the chunk.
+  @param   newSize the number of bytes to allocate.
+  @returns the resized chunk, or NULL if there is insufficient memory, in
+  which case the original chunk is untouched.
+*/
+/**************************************************************************/
+void *NoteRealloc(void *p, size_t oldSize, size_t newSize)
+{
+    if (hookRealloc != NULL) {
+        return hookRealloc(p, newSize);
+    }
+    void *q = NoteMalloc(newSize);
+    if (q != NULL && p != NULL) {
+        memcpy(q, p, oldSize < newSize ? oldSize : newSize);
+        NoteFree(p);
+    }
+    return q;
+}
+
 //**************************************************************************/
 /*!
   @brief  Free memory using the platform-specific hook.
@@ -593,6 +686,54 @@ char NoteSerialReceive()
     return 0;
 }
 
+//**************************************************************************/
+/*!
+  @brief  Obtain as many bytes as are available from the Serial bus, up to
+  a limit, using the platform-specific block receive hook, or if there is
+  none, a byte at a time using the available and receive hooks.
+  @param   data The buffer into which to receive the bytes.
+  @param   len The most bytes to receive.
+  @returns The number of bytes received, which is 0 if none are available.
+*/
+/**************************************************************************/
+size_t NoteSerialReceiveBlock(uint8_t *data, size_t len)
+{
+    if (hookActiveInterface == interfaceSerial && hookSerialReceiveBlock != NULL) {
+        return hookSerialReceiveBlock(data, len);
+    }
+    size_t received = 0;
+    while (received < len && NoteSerialAvailable()) {
+        data[received++] = (uint8_t) NoteSerialReceive();
+    }
+    return received;
+}
+
+//**************************************************************************/
+/*!
+  @brief  Wait for data to be available on the Serial bus using the
+  platform-specific hook, or if there is none, by delaying in short steps
+  until it is.
+  @param   timeoutMs The most milliseconds to wait.
+  @returns A boolean indicating whether the Serial bus is available to read.
+*/
+/**************************************************************************/
+bool NoteSerialWait(uint32_t timeoutMs)
+{
+    if (hookActiveInterface == interfaceSerial && hookSerialWait != NULL) {
+        return hookSerialWait(timeoutMs);
+    }
+    uint32_t startMs = _GetMs();
+    while (!NoteSerialAvailable()) {
+        uint32_t elapsedMs = _GetMs() - startMs;
+        if (elapsedMs >= timeoutMs) {
+            return false;
+        }
+        uint32_t stepMs = timeoutMs - elapsedMs;
+        _DelayMs(stepMs > CARD_SERIAL_WAIT_STEP_MS ? CARD_SERIAL_WAIT_STEP_MS : stepMs);
+    }
+    return true;
+}
+
 //**************************************************************************/
 /*!
   @brief  Reset the I2C bus using the platform-specific hook.
@@ -711,16 +852,76 @@ bool NoteHardReset()
 /*!
   @brief  Perform a JSON request to the Notecard using the currently-set
   platform hook.
-  @param   json the JSON request.
+  @param   json the JSON request, or NULL to serialize `jsonRequest` directly
+  to the Notecard.
+  @param   jsonRequest the request object, used only if `json` is NULL.
   @param   jsonResponse (out) A buffer with the JSON response.
+  @param   jsonStream A streaming parser to feed the response to as it
+  arrives, instead of returning it in `jsonResponse`.
+  @returns NULL if successful, or an error string if the transaction failed
+  or the hook has not been set.
+*/
+/**************************************************************************/
+const char *NoteJSONTransaction(char *json, J *jsonRequest, char **jsonResponse, JStream *jsonStream)
+{
+    transactionReply reply;
+    const char *err = NoteJSONTransactionBegin(json, jsonRequest, jsonResponse, jsonStream, &reply);
+    if (err != NULL) {
+        return err;
+    }
+    return NoteJSONTransactionPoll(&reply, true);
+}
+
+//**************************************************************************/
+/*!
+  @brief  Begin a JSON request to the Notecard using the currently-set
+  platform hook, transmitting the request and leaving its reply to be
+  received by `NoteJSONTransactionPoll`.
+  @param   json the JSON request, or NULL to serialize `jsonRequest` directly
+  to the Notecard.
+  @param   jsonRequest the request object, used only if `json` is NULL.
+  @param   jsonResponse (out) A buffer with the JSON response, set when the
+  reply is done.
+  @param   jsonStream A streaming parser to feed the response to as it
+  arrives, instead of returning it in `jsonResponse`.
+  @param   reply (out) The state of the reply, which is done if no reply is
+  expected or if the transaction failed.
   @returns NULL if successful, or an error string if the transaction failed
   or the hook has not been set.
 */
 /**************************************************************************/
-const char *NoteJSONTransaction(char *json, char **jsonResponse)
+const char *NoteJSONTransactionBegin(char *json, J *jsonRequest, char **jsonResponse, JStream *jsonStream, transactionReply *reply)
 {
-    if (notecardTransaction == NULL || hookActiveInterface == interfaceNone) {
+    if (notecardTransactionBegin == NULL || hookActiveInterface == interfaceNone) {
+        reply->done = true;
+        return "i2c or serial interface must be selected";
+    }
+    pacingBegin();
+    const char *err = notecardTransactionBegin(json, jsonRequest, jsonResponse, jsonStream, reply);
+    if (err == NULL && !reply->done) {
+        latencyBegin(reply, json, jsonRequest);
+    }
+    return err;
+}
+
+//**************************************************************************/
+/*!
+  @brief  Receive as much of the reply to a JSON request as has arrived.
+  @param   reply The state of the reply, which is done when this returns an
+  error or when the reply has been received in its entirety.
+  @param   block Whether to wait for the reply to be done.
+  @returns NULL if successful so far, or an error string if the transaction
+  failed.
+*/
+/**************************************************************************/
+const char *NoteJSONTransactionPoll(transactionReply *reply, bool block)
+{
+    if (reply->done) {
+        return NULL;
+    }
+    if (notecardTransactionPoll == NULL || hookActiveInterface == interfaceNone) {
+        reply->done = true;
         return "i2c or serial interface must be selected";
     }
-    return notecardTransaction(json, jsonResponse);
+    return notecardTransactionPoll(reply, block);
 }
@@ -16,8 +16,24 @@
 // Turbo I/O mode
 extern bool cardTurboIO;
 
+// Throughput statistics
+static uint32_t i2cStatBytes = 0;
+static uint32_t i2cStatMs = 0;
+static uint32_t i2cStatStalls = 0;
+
+// The request being transmitted, gathered into chunks of up to _I2CMax() bytes
+typedef struct {
+    uint8_t chunk[NOTE_I2C_MAX_MAX];
+    uint32_t chunkLen;
+    uint32_t sentInSegment;
+    const char *err;
+} i2cRequest;
+
 // Forwards
 static void _DelayIO(void);
+static void _AdaptPacing(bool success);
+static bool _TransmitChunk(i2cRequest *request);
+static Jbool _WriteRequest(void *context, const char *data, size_t length);
 
 /**************************************************************************/
 /*!
@@ -36,176 +52,358 @@ static void _DelayIO()
 
 /**************************************************************************/
 /*!
-  @brief  Given a JSON string, perform an I2C transaction with the Notecard.
+  @brief  Adapt the delays between request chunks and segments to the
+  outcome of a transaction.  The notecard refuses (NAKs) I2C I/O or loses
+  the request when it can't keep up.
+  @param   success
+  Whether or not the transaction completed without an I/O error or timeout.
+*/
+/**************************************************************************/
+static void _AdaptPacing(bool success)
+{
+    pacingAdjust(PACE_I2C_CHUNK, success);
+    pacingAdjust(PACE_I2C_SEGMENT, success);
+}
+
+/**************************************************************************/
+/*!
+  @brief  Return statistics about I2C transactions with the notecard.
+  @param   bytesPerSec
+  An out parameter for the number of request and reply bytes moved per
+  second over the course of all transactions, or `NULL`.
+  @param   stalls
+  An out parameter for the number of times that a reply wasn't yet
+  available when polled, or `NULL`.
+  @param   chunkDelayMs
+  An out parameter for the delay currently used between request chunks,
+  or `NULL`.
+*/
+/**************************************************************************/
+void NoteGetI2CStats(uint32_t *bytesPerSec, uint32_t *stalls, uint32_t *chunkDelayMs)
+{
+    if (bytesPerSec != NULL) {
+        *bytesPerSec = (i2cStatMs == 0 ? 0 : (uint32_t) (((uint64_t) i2cStatBytes * 1000) / i2cStatMs));
+    }
+    if (stalls != NULL) {
+        *stalls = i2cStatStalls;
+    }
+    NoteGetPacing(chunkDelayMs, NULL, NULL);
+}
+
+/**************************************************************************/
+/*!
+  @brief  Transmit the chunk of the request that has been gathered so far,
+  pacing chunks and segments so as not to overwhelm the notecard's
+  interrupt buffers.
+  @param   request
+  The request being transmitted.
+  @returns `true` if the chunk was transmitted, else `false` with the
+  error string left in the request.
+*/
+/**************************************************************************/
+static bool _TransmitChunk(i2cRequest *request)
+{
+    if (request->chunkLen == 0) {
+        return true;
+    }
+    _DelayIO();
+    request->err = _I2CTransmit(_I2CAddress(), request->chunk, (uint16_t) request->chunkLen);
+    if (request->err != NULL) {
+        return false;
+    }
+    i2cStatBytes += request->chunkLen;
+    request->sentInSegment += request->chunkLen;
+    request->chunkLen = 0;
+    if (request->sentInSegment > CARD_REQUEST_I2C_SEGMENT_MAX_LEN) {
+        request->sentInSegment = 0;
+        pacingDelay(PACE_I2C_SEGMENT);
+    }
+    pacingDelay(PACE_I2C_CHUNK);
+    return true;
+}
+
+/**************************************************************************/
+/*!
+  @brief  Append data to the request, transmitting each chunk as it fills.
+  This is a `JPrintSinkFn`, so that a request can be serialized
+  directly onto the wire.
+  @param   context
+  The `i2cRequest` being transmitted.
+  @param   data
+  The data to append.
+  @param   length
+  The length of the data.
+  @returns `true` if successful, else `false` if a chunk couldn't be
+  transmitted.
+*/
+/**************************************************************************/
+static Jbool _WriteRequest(void *context, const char *data, size_t length)
+{
+    i2cRequest *request = (i2cRequest *) context;
+    while (length > 0) {
+        if (request->chunkLen >= _I2CMax() && !_TransmitChunk(request)) {
+            return false;
+        }
+        uint32_t copyLen = _I2CMax() - request->chunkLen;
+        if (copyLen > length) {
+            copyLen = length;
+        }
+        memcpy(&request->chunk[request->chunkLen], data, copyLen);
+        request->chunkLen += copyLen;
+        data += copyLen;
+        length -= copyLen;
+    }
+    return true;
+}
+/**************************************************************************/
+/*!
+  @brief  Given a JSON request, begin an I2C transaction with the Notecard
+  by transmitting the request, leaving its reply to be received by
+  `i2cNoteTransactionPoll`.  The bus is held until the transaction ends.
   @param   json
-  A c-string containing the JSON request object.
+  A c-string containing the JSON request object, or `NULL` if the
+  request is to be serialized from `jsonRequest` directly onto the
+  wire without ever being held in memory in its entirety.
+  @param   jsonRequest
+  The request object, used only if `json` is `NULL`.
   @param   jsonResponse
   An out parameter c-string buffer that will contain the JSON
   response from the Notercard.
+  @param   jsonStream
+  If not `NULL`, a streaming parser that is fed each chunk of the
+  response as it is received, in which case `jsonResponse` is unused
+  and no response buffer is allocated.
+  @param   reply
+  The state of the reply, which is done if no reply is expected or if
+  the transaction failed.
   @returns a c-string with an error, or `NULL` if no error ocurred.
 */
 /**************************************************************************/
-const char *i2cNoteTransaction(char *json, char **jsonResponse)
+const char *i2cNoteTransactionBegin(char *json, J *jsonRequest, char **jsonResponse, JStream *jsonStream, transactionReply *reply)
 {
-
-    // Append newline to the transaction
-    int jsonLen = strlen(json);
-    uint8_t *transmitBuf = (uint8_t *) _Malloc(jsonLen+1);
-    if (transmitBuf == NULL) {
-        return ERRSTR("insufficient memory",c_mem);
-    }
-    memcpy(transmitBuf, json, jsonLen);
-    transmitBuf[jsonLen++] = '\n';
+    const char *estr;
 
     // Lock over the entire transaction
     _LockI2C();
-
-    // Transmit the request in chunks, but also in segments so as not to overwhelm the notecard's interrupt buffers
-    const char *estr;
-    uint8_t *chunk = transmitBuf;
-    uint32_t sentInSegment = 0;
-    while (jsonLen > 0) {
-        int chunklen = (uint8_t) (jsonLen > (int)_I2CMax() ? (int)_I2CMax() : jsonLen);
-        _DelayIO();
-        estr = _I2CTransmit(_I2CAddress(), chunk, chunklen);
-        if (estr != NULL) {
-            _Free(transmitBuf);
-            _I2CReset(_I2CAddress());
+    memset(reply, 0, sizeof(transactionReply));
+    reply->done = true;
+    reply->transactionMs = _GetMs();
+
+    // Transmit the request followed by a newline, gathering it into chunks as we go so that
+    // it never needs to be copied in its entirety.
+    i2cRequest request;
+    request.chunkLen = 0;
+    request.sentInSegment = 0;
+    request.err = NULL;
+    bool success;
+    if (json != NULL) {
+        success = _WriteRequest(&request, json, strlen(json));
+    } else {
+        char window[CARD_REQUEST_PRINT_WINDOW_LEN];
+        success = JPrintToSink(jsonRequest, window, sizeof(window), false, _WriteRequest, &request);
+    }
+    if (success) {
+        success = _WriteRequest(&request, "\n", 1) && _TransmitChunk(&request);
+    }
+    if (!success) {
+        estr = (request.err != NULL ? request.err : ERRSTR("can't convert to JSON",c_bad));
+        if (request.err != NULL) {
+            _AdaptPacing(false);
+        } else if (_WriteRequest(&request, "\n", 1)) {
+            // Part of the request may already be on the wire, so end the line for the notecard to
+            // reject rather than leave it to run into the next request.  The reset that follows
+            // the failure drains the notecard's reply to it.
+            _TransmitChunk(&request);
+        }
+        _I2CReset(_I2CAddress());
 #ifdef ERRDBG
-            _Debug("i2c transmit: ");
-            _Debug(estr);
-            _Debug("\n");
+        _Debug("i2c transmit: ");
+        _Debug(estr);
+        _Debug("\n");
 #endif
-            _UnlockI2C();
-            return estr;
-        }
-        chunk += chunklen;
-        jsonLen -= chunklen;
-        sentInSegment += chunklen;
-        if (sentInSegment > CARD_REQUEST_I2C_SEGMENT_MAX_LEN) {
-            sentInSegment = 0;
-            if (!cardTurboIO) {
-                _DelayMs(CARD_REQUEST_I2C_SEGMENT_DELAY_MS);
-            }
-        }
-        if (!cardTurboIO) {
-            _DelayMs(CARD_REQUEST_I2C_CHUNK_DELAY_MS);
-        }
+        _UnlockI2C();
+        return estr;
     }
 
-    // Free the transmit buffer
-    _Free(transmitBuf);
-
     // If no reply expected, we're done
-    if (jsonResponse == NULL) {
+    if (jsonResponse == NULL && jsonStream == NULL) {
+        _AdaptPacing(true);
+        i2cStatMs += _GetMs() - reply->transactionMs;
         _UnlockI2C();
         return NULL;
     }
 
-    // Dynamically grow the buffer as we read.  Note that we always put the +1 in the alloc
-    // so we can be assured that it can be null-terminated, which must be the case because
-    // our json parser requires a null-terminated string.
-    int growlen = ALLOC_CHUNK;
-    int jsonbufAllocLen = growlen;
-    char *jsonbuf = (char *) _Malloc(jsonbufAllocLen+1);
-    if (jsonbuf == NULL) {
+    // When streaming, each chunk is read into a single buffer of the maximum chunk size and
+    // handed to the parser as soon as it arrives.  Otherwise, the buffer isn't allocated until
+    // the module tells us how much is available, so that a reply that is available in its
+    // entirety is read into a single allocation of exactly the right size.  Note that we always
+    // put the +1 in the alloc so we can be assured that it can be null-terminated, which must
+    // be the case because our json parser requires a null-terminated string.
+    if (jsonStream != NULL) {
+        reply->jsonbufAllocLen = (int)_I2CMax();
+        reply->jsonbuf = (char *) _Malloc(reply->jsonbufAllocLen+1);
+        if (reply->jsonbuf == NULL) {
 #ifdef ERRDBG
-        _Debug("transaction: jsonbuf malloc failed\n");
+            _Debug("transaction: jsonbuf malloc failed\n");
 #endif
-        _UnlockI2C();
-        return ERRSTR("insufficient memory",c_mem);
+            _UnlockI2C();
+            return ERRSTR("insufficient memory",c_mem);
+        }
+    }
+
+    // The reply is now awaited
+    reply->jsonResponse = jsonResponse;
+    reply->jsonStream = jsonStream;
+    reply->startMs = _GetMs();
+    reply->done = false;
+    return NULL;
+}
+
+/**************************************************************************/
+/*!
+  @brief  Receive as much of the reply to an I2C transaction as the
+  Notecard has available, building a reply buffer out of received chunks
+  and growing it as necessary, until the reply is complete.
+  @param   reply
+  The state of the reply, which is done when this returns an error or
+  when the reply has been received in its entirety.
+  @param   block
+  If `true`, wait for the reply to be complete rather than returning as
+  soon as nothing is available.
+  @returns a c-string with an error, or `NULL` if no error ocurred.
+*/
+/**************************************************************************/
+const char *i2cNoteTransactionPoll(transactionReply *reply, bool block)
+{
+    if (reply->done) {
+        return NULL;
     }
 
-    // Loop, building a reply buffer out of received chunks.  We'll build the reply in the same
-    // buffer we used to transmit, and will grow it as necessary.
-    bool receivedNewline = false;
-    int jsonbufLen = 0;
-    int chunklen = 0;
-    uint32_t startMs = _GetMs();
     while (true) {
 
-        // Grow the buffer as necessary to read this next chunk
-        if (jsonbufLen + chunklen > jsonbufAllocLen) {
-            if (chunklen > growlen) {
-                jsonbufAllocLen += chunklen;
-            } else {
-                jsonbufAllocLen += growlen;
+        // Grow the buffer as necessary to read this next chunk, making room for everything
+        // that is available but at least doubling it so that a long reply is copied rarely.
+        if (reply->jsonStream == NULL && reply->jsonbufLen + reply->chunklen > reply->jsonbufAllocLen) {
+            int newAllocLen = reply->jsonbufLen + (int)reply->available;
+            if (reply->jsonbufAllocLen > 0 && newAllocLen < reply->jsonbufAllocLen*2) {
+                newAllocLen = reply->jsonbufAllocLen*2;
             }
-            char *jsonbufNew = (char *) _Malloc(jsonbufAllocLen+1);
+            char *jsonbufNew = (char *) _Realloc(reply->jsonbuf, reply->jsonbufAllocLen+1, newAllocLen+1);
             if (jsonbufNew == NULL) {
 #ifdef ERRDBG
                 _Debug("transaction: jsonbuf grow malloc failed\n");
 #endif
-                _Free(jsonbuf);
+                if (reply->jsonbuf != NULL) {
+                    _Free(reply->jsonbuf);
+                }
+                reply->done = true;
                 _UnlockI2C();
                 return ERRSTR("insufficient memory",c_mem);
             }
-            memcpy(jsonbufNew, jsonbuf, jsonbufLen);
-            _Free(jsonbuf);
-            jsonbuf = jsonbufNew;
+            reply->jsonbuf = jsonbufNew;
+            reply->jsonbufAllocLen = newAllocLen;
         }
 
-        // Read the chunk
-        uint32_t available;
+        // Read the chunk, noting that until something is available there is no buffer to read
+        // into, and that nothing is read in that case anyway.
+        uint8_t nothing;
+        uint8_t *chunk = (reply->jsonbuf == NULL ? &nothing : (uint8_t *) &reply->jsonbuf[reply->jsonbufLen]);
         _DelayIO();
-        const char *err = _I2CReceive(_I2CAddress(), (uint8_t *) &jsonbuf[jsonbufLen], chunklen, &available);
+        const char *err = _I2CReceive(_I2CAddress(), chunk, reply->chunklen, &reply->available);
         if (err != NULL) {
-            _Free(jsonbuf);
+            if (reply->jsonbuf != NULL) {
+                _Free(reply->jsonbuf);
+            }
+            _AdaptPacing(false);
 #ifdef ERRDBG
             _Debug("i2c receive error\n");
 #endif
+            reply->done = true;
             _UnlockI2C();
             return err;
         }
 
         // We've now received the chunk
-        jsonbufLen += chunklen;
+        pacingScanReply(reply, (const char *) chunk, (size_t) reply->chunklen);
+        reply->jsonbufLen += reply->chunklen;
+        i2cStatBytes += reply->chunklen;
+        if (reply->available > 0) {
+            latencyArrived(reply);
+        }
 
         // If the last byte of the chunk is \n, chances are that we're done.  However, just so
         // that we pull everything pending from the module, we only exit when we've received
         // a newline AND there's nothing left available from the module.
-        if (jsonbufLen > 0 && jsonbuf[jsonbufLen-1] == '\n') {
-            receivedNewline = true;
+        if (reply->jsonbufLen > 0 && reply->jsonbuf[reply->jsonbufLen-1] == '\n') {
+            reply->receivedNewline = true;
+        }
+
+        // When streaming, parse the chunk now and reuse the buffer for the next one.  A parse
+        // error is reported by the parser when the transaction completes, but we still drain
+        // the rest of the reply so that the next transaction starts clean.
+        if (reply->jsonStream != NULL) {
+            if (reply->chunklen > 0) {
+                JParseStreamFeed(reply->jsonStream, reply->jsonbuf, reply->chunklen);
+            }
+            reply->jsonbufLen = 0;
         }
 
         // For the next iteration, read the min of what's available and what we're permitted to read
-        chunklen = (int) (available > _I2CMax() ? _I2CMax() : available);
+        reply->chunklen = (int) (reply->available > _I2CMax() ? _I2CMax() : reply->available);
 
         // If there's something available on the notecard for us to receive, do it
-        if (chunklen > 0) {
+        if (reply->chunklen > 0) {
             continue;
         }
 
         // If there's nothing available AND we've received a newline, we're done
-        if (receivedNewline) {
+        if (reply->receivedNewline) {
             break;
         }
 
         // If we've timed out and nothing's available, exit
-        if (_GetMs() >= startMs + (NOTECARD_TRANSACTION_TIMEOUT_SEC*1000)) {
-            _Free(jsonbuf);
+        if (_GetMs() >= reply->startMs + (NOTECARD_TRANSACTION_TIMEOUT_SEC*1000)) {
+            if (reply->jsonbuf != NULL) {
+                _Free(reply->jsonbuf);
+            }
+            _AdaptPacing(false);
 #ifdef ERRDBG
             _Debug("reply to request didn't arrive from module in time\n");
 #endif
+            reply->done = true;
             _UnlockI2C();
             return ERRSTR("request or response was lost {io}",c_iotimeout);
         }
 
-        // Delay, simply waiting for the Note to process the request
+        // The Note is still processing the request, so either leave it to be polled again or
+        // simply wait for it
+        i2cStatStalls++;
+        if (!block) {
+            return NULL;
+        }
         if (!cardTurboIO) {
-            _DelayMs(50);
+            _DelayMs(latencyWaitMs(reply));
         }
 
     }
 
-    // Done with the bus
+    // Done with the bus, and the notecard kept up with the request unless it replied that it didn't
+    _AdaptPacing(pacingReplyKeptUp(reply));
+    i2cStatMs += _GetMs() - reply->transactionMs;
+    reply->done = true;
     _UnlockI2C();
 
+    // When streaming, the parser already has the entire reply
+    if (reply->jsonStream != NULL) {
+        _Free(reply->jsonbuf);
+        return NULL;
+    }
+
     // Null-terminate it, using the +1 space that we'd allocated in the buffer
-    jsonbuf[jsonbufLen] = '\0';
+    reply->jsonbuf[reply->jsonbufLen] = '\0';
 
     // Return it
-    *jsonResponse = jsonbuf;
+    *reply->jsonResponse = reply->jsonbuf;
     return NULL;
 }
 
@@ -232,9 +430,7 @@ bool i2cNoteReset()
     // If we get a failure on transmitting the \n, it means that the notecard isn't even present.
     _DelayIO();
     const char *transmitErr = _I2CTransmit(_I2CAddress(), (uint8_t *)"\n", 1);
-    if (!cardTurboIO) {
-        _DelayMs(CARD_REQUEST_I2C_SEGMENT_DELAY_MS);
-    }
+    pacingDelay(PACE_I2C_SEGMENT);
 
     // This outer loop does retries on I2C error, and is simply here for robustness.
     bool notecardReady = false;
@@ -30,7 +30,9 @@ extern "C" {
 
 // The notecard is a real-time device that has a fixed size interrupt buffer.
 // We can push data at it far, far faster than it can process it, therefore we
-// push it in segments with a pause between each segment.
+// push it in segments with a pause between each segment.  The pauses start
+// at their least and are adapted to how well the notecard keeps up, backing
+// off toward the most conservative delays upon I/O errors or timeouts.
 
 /**************************************************************************/
 /*!
@@ -40,17 +42,33 @@ extern "C" {
 #define CARD_REQUEST_I2C_SEGMENT_MAX_LEN 250
 /**************************************************************************/
 /*!
-    @brief  The delay, in miliseconds, of each request when using I2C.
+    @brief  The most delay, in miliseconds, between each request segment when
+    using I2C.
 */
 /**************************************************************************/
 #define CARD_REQUEST_I2C_SEGMENT_DELAY_MS 250
 /**************************************************************************/
 /*!
-    @brief  The delay, in miliseconds, between each request chunk when using I2C.
+    @brief  The least delay, in miliseconds, between each request segment
+    when using I2C.
+*/
+/**************************************************************************/
+#define CARD_REQUEST_I2C_SEGMENT_DELAY_MIN_MS 10
+/**************************************************************************/
+/*!
+    @brief  The most delay, in miliseconds, between each request chunk when
+    using I2C.
 */
 /**************************************************************************/
 #define CARD_REQUEST_I2C_CHUNK_DELAY_MS 20
 /**************************************************************************/
+/*!
+    @brief  The least delay, in miliseconds, between each request chunk when
+    using I2C.
+*/
+/**************************************************************************/
+#define CARD_REQUEST_I2C_CHUNK_DELAY_MIN_MS 1
+/**************************************************************************/
 /*!
     @brief  The max length, in bytes, of each request segment when using Serial.
 */
@@ -58,10 +76,26 @@ extern "C" {
 #define CARD_REQUEST_SERIAL_SEGMENT_MAX_LEN 250
 /**************************************************************************/
 /*!
-    @brief  The delay, in miliseconds, of each request when using Serial.
+    @brief  The most delay, in miliseconds, between each request segment when
+    using Serial.
 */
 /**************************************************************************/
 #define CARD_REQUEST_SERIAL_SEGMENT_DELAY_MS 250
+/**************************************************************************/
+/*!
+    @brief  The least delay, in miliseconds, between each request segment
+    when using Serial.
+*/
+/**************************************************************************/
+#define CARD_REQUEST_SERIAL_SEGMENT_DELAY_MIN_MS 10
+/**************************************************************************/
+/*!
+    @brief  The size, in bytes, of the window through which a request is
+    serialized when it is rendered directly onto the wire.  This must be
+    at least `N_CJSON_PRINT_WINDOW_MIN`.
+*/
+/**************************************************************************/
+#define CARD_REQUEST_PRINT_WINDOW_LEN 64
 
 /**************************************************************************/
 /*!
@@ -74,12 +108,91 @@ extern "C" {
 #define ALLOC_CHUNK 128
 #endif
 
+/**************************************************************************/
+/*!
+    @brief  The least and most time, in miliseconds, to wait between polls
+    for a reply once it is later than expected.  Waits start at the least
+    and double until they reach the most.
+*/
+/**************************************************************************/
+#define CARD_REPLY_POLL_MIN_MS 2
+#define CARD_REPLY_POLL_MAX_MS 50
+
+/**************************************************************************/
+/*!
+    @brief  The most time, in miliseconds, to delay at once while waiting
+    for Serial data without a platform wait hook, so that a reply arriving
+    meanwhile doesn't overrun the receive buffer.
+*/
+/**************************************************************************/
+#define CARD_SERIAL_WAIT_STEP_MS 10
+
+/**************************************************************************/
+/*!
+    @brief  The size, in bytes, of the buffer through which a Serial reply
+    is received when it is streamed to the parser rather than buffered.
+*/
+/**************************************************************************/
+#define CARD_REPLY_SERIAL_CHUNK_LEN 32
+
+/**************************************************************************/
+/*!
+    @brief  The number of kinds of request whose reply latency is learned,
+    and the length of the `req` string, including its terminator, by which
+    each is known.  Longer strings are truncated.
+*/
+/**************************************************************************/
+#ifdef NOTE_LOWMEM
+#define CARD_REPLY_LATENCIES 4
+#else
+#define CARD_REPLY_LATENCIES 8
+#endif
+#define CARD_REPLY_LATENCY_REQ_LEN 16
+
+// The reply to a transaction, received over however many polls it takes to arrive
+typedef struct {
+    bool done;
+    bool receiving;
+    bool receivedNewline;
+    char **jsonResponse;
+    JStream *jsonStream;
+    char *jsonbuf;
+    int jsonbufAllocLen;
+    int jsonbufLen;
+    int chunklen;
+    uint32_t available;
+    uint32_t startMs;
+    uint32_t transactionMs;
+    int latency;
+    uint32_t expectMs;
+    uint32_t waitMs;
+    int ioerrMatched;
+} transactionReply;
+
 // Transactions
-const char *i2cNoteTransaction(char *json, char **jsonResponse);
+const char *i2cNoteTransactionBegin(char *json, J *jsonRequest, char **jsonResponse, JStream *jsonStream, transactionReply *reply);
+const char *i2cNoteTransactionPoll(transactionReply *reply, bool block);
 bool i2cNoteReset(void);
-const char *serialNoteTransaction(char *json, char **jsonResponse);
+const char *serialNoteTransactionBegin(char *json, J *jsonRequest, char **jsonResponse, JStream *jsonStream, transactionReply *reply);
+const char *serialNoteTransactionPoll(transactionReply *reply, bool block);
 bool serialNoteReset(void);
 
+// Pacing of requests, indexing the delays that are adapted
+#define PACE_I2C_CHUNK          0
+#define PACE_I2C_SEGMENT        1
+#define PACE_SERIAL_SEGMENT     2
+#define PACE_DELAYS             3
+void pacingBegin(void);
+void pacingDelay(int pace);
+void pacingAdjust(int pace, bool success);
+void pacingScanReply(transactionReply *reply, const char *data, size_t len);
+bool pacingReplyKeptUp(const transactionReply *reply);
+
+// Learned latency of replies, by the kind of request
+void latencyBegin(transactionReply *reply, const char *json, J *jsonRequest);
+void latencyArrived(transactionReply *reply);
+uint32_t latencyWaitMs(transactionReply *reply);
+
 // Hooks
 void NoteLockNote(void);
 void NoteUnlockNote(void);
@@ -88,11 +201,15 @@ bool NoteSerialReset(void);
 void NoteSerialTransmit(uint8_t *, size_t, bool);
 bool NoteSerialAvailable(void);
 char NoteSerialReceive(void);
+bool NoteSerialWait(uint32_t timeoutMs);
+size_t NoteSerialReceiveBlock(uint8_t *data, size_t len);
 bool NoteI2CReset(uint16_t DevAddress);
 const char *NoteI2CTransmit(uint16_t DevAddress, uint8_t* pBuffer, uint16_t Size);
 const char *NoteI2CReceive(uint16_t DevAddress, uint8_t* pBuffer, uint16_t Size, uint32_t *avail);
 bool NoteHardReset(void);
-const char *NoteJSONTransaction(char *json, char **jsonResponse);
+const char *NoteJSONTransaction(char *json, J *jsonRequest, char **jsonResponse, JStream *jsonStream);
+const char *NoteJSONTransactionBegin(char *json, J *jsonRequest, char **jsonResponse, JStream *jsonStream, transactionReply *reply);
+const char *NoteJSONTransactionPoll(transactionReply *reply, bool block);
 bool NoteIsDebugOutputActive(void);
 
 // Constants, a global optimization to save static string memory
@@ -144,13 +261,18 @@ extern const char *c_ioerr;
 #define _SerialTransmit NoteSerialTransmit
 #define _SerialAvailable NoteSerialAvailable
 #define _SerialReceive NoteSerialReceive
+#define _SerialWait NoteSerialWait
+#define _SerialReceiveBlock NoteSerialReceiveBlock
 #define _I2CReset NoteI2CReset
 #define _I2CTransmit NoteI2CTransmit
 #define _I2CReceive NoteI2CReceive
 #define _Reset NoteHardReset
 #define _Transaction NoteJSONTransaction
+#define _TransactionBegin NoteJSONTransactionBegin
+#define _TransactionPoll NoteJSONTransactionPoll
 #define _Malloc NoteMalloc
 #define _Free NoteFree
+#define _Realloc NoteRealloc
 #define _GetMs NoteGetMs
 #define _DelayMs NoteDelayMs
 #define _LockI2C NoteLockI2C
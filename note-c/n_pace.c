@@ -0,0 +1,402 @@
+/*!
+ * @file n_pace.c
+ *
+ * Pacing of requests to the Notecard, whose fixed size interrupt buffers can
+ * be overrun by a host that pushes data at it faster than it can process it.
+ *
+ * Written by Ray Ozzie and Blues Inc. team.
+ *
+ * Copyright (c) 2019 Blues Inc. MIT License. Use of this source code is
+ * governed by licenses granted by the copyright holder including that found in
+ * the
+ * <a href="https://github.com/blues/note-c/blob/master/LICENSE">LICENSE</a>
+ * file.
+ *
+ */
+
+#include "n_lib.h"
+
+// Turbo I/O mode
+extern bool cardTurboIO;
+
+// The bounds of each delay, indexed by PACE_xxx
+static const uint32_t paceMinMs[PACE_DELAYS] = {
+    CARD_REQUEST_I2C_CHUNK_DELAY_MIN_MS,
+    CARD_REQUEST_I2C_SEGMENT_DELAY_MIN_MS,
+    CARD_REQUEST_SERIAL_SEGMENT_DELAY_MIN_MS,
+};
+static const uint32_t paceMaxMs[PACE_DELAYS] = {
+    CARD_REQUEST_I2C_CHUNK_DELAY_MS,
+    CARD_REQUEST_I2C_SEGMENT_DELAY_MS,
+    CARD_REQUEST_SERIAL_SEGMENT_DELAY_MS,
+};
+
+// The learned latency of replies to each kind of request, most recently used first, from the
+// end of the request to the arrival of the start of its reply
+typedef struct {
+    char req[CARD_REPLY_LATENCY_REQ_LEN];
+    uint32_t latencyMs;
+    uint32_t samples;
+} replyLatency;
+static replyLatency latencies[CARD_REPLY_LATENCIES];
+static int latencyCount = 0;
+
+// The learned delays, which start at the conservative delays that were once
+// fixed, and which are deliberately left alone when the notecard is reset, so
+// that what was learned isn't lost.
+static uint32_t paceMs[PACE_DELAYS] = {
+    CARD_REQUEST_I2C_CHUNK_DELAY_MS,
+    CARD_REQUEST_I2C_SEGMENT_DELAY_MS,
+    CARD_REQUEST_SERIAL_SEGMENT_DELAY_MS,
+};
+
+// The delays, one bit per PACE_xxx, that have been paused for during the
+// current transaction, because only those say anything about whether the
+// notecard kept up.
+static uint8_t paceUsed = 0;
+
+/**************************************************************************/
+/*!
+  @brief  Clamp a delay to its bounds.
+  @param   pace
+  The delay, as `PACE_xxx`.
+  @param   ms
+  The proposed delay in milliseconds.
+  @returns the delay in milliseconds, within its bounds.
+*/
+/**************************************************************************/
+static uint32_t _PaceClamp(int pace, uint32_t ms)
+{
+    if (ms < paceMinMs[pace]) {
+        return paceMinMs[pace];
+    }
+    if (ms > paceMaxMs[pace]) {
+        return paceMaxMs[pace];
+    }
+    return ms;
+}
+
+/**************************************************************************/
+/*!
+  @brief  Note the start of a transaction, before which none of the
+  delays have been used.
+*/
+/**************************************************************************/
+void pacingBegin(void)
+{
+    paceUsed = 0;
+}
+
+/**************************************************************************/
+/*!
+  @brief  Pause between parts of a request for the learned delay, unless
+  in turbo I/O mode.
+  @param   pace
+  The delay, as `PACE_xxx`.
+*/
+/**************************************************************************/
+void pacingDelay(int pace)
+{
+    if (!cardTurboIO) {
+        _DelayMs(paceMs[pace]);
+        paceUsed |= (uint8_t) (1 << pace);
+    }
+}
+
+/**************************************************************************/
+/*!
+  @brief  Adapt a delay to the outcome of a transaction, in the manner of
+  AIMD congestion control.  The delay is doubled when the notecard
+  fails to keep up, which shows itself as an I/O error or a lost request,
+  and is otherwise shortened by its least delay until it reaches it.
+  A delay that wasn't paused for since the transaction began is left alone,
+  as is one that has already been adapted to it, because a short request
+  that never crossed a chunk or segment boundary is no evidence either way.
+  @param   pace
+  The delay, as `PACE_xxx`.
+  @param   success
+  Whether the transaction completed without an I/O error or timeout.
+*/
+/**************************************************************************/
+void pacingAdjust(int pace, bool success)
+{
+    uint8_t used = (uint8_t) (1 << pace);
+    if ((paceUsed & used) == 0) {
+        return;
+    }
+    paceUsed &= (uint8_t) ~used;
+    if (success) {
+        paceMs[pace] = _PaceClamp(pace, paceMs[pace] - paceMinMs[pace]);
+    } else {
+        paceMs[pace] = _PaceClamp(pace, paceMs[pace] * 2);
+    }
+}
+
+/**************************************************************************/
+/*!
+  @brief  Scan part of a reply for the `{io}` with which the notecard marks
+  the error that it replies with when a request reached it garbled, such as
+  when bytes of it were dropped because its interrupt buffer overran.  The
+  reply arrives in pieces, so the match is carried from one to the next.
+  @param   reply
+  The state of the reply.
+  @param   data
+  The part of the reply just received.
+  @param   len
+  The length of the part.
+*/
+/**************************************************************************/
+void pacingScanReply(transactionReply *reply, const char *data, size_t len)
+{
+    for (size_t i=0; i<len && reply->ioerrMatched < c_ioerr_len; i++) {
+        if (data[i] == c_ioerr[reply->ioerrMatched]) {
+            reply->ioerrMatched++;
+        } else {
+            reply->ioerrMatched = (data[i] == c_ioerr[0] ? 1 : 0);
+        }
+    }
+}
+
+/**************************************************************************/
+/*!
+  @brief  Get whether the notecard kept up with a request whose reply has
+  arrived in its entirety, which it didn't if the reply is an I/O error.
+  @param   reply
+  The state of the reply.
+  @returns boolean. `true` if the reply has no `{io}` in it.
+*/
+/**************************************************************************/
+bool pacingReplyKeptUp(const transactionReply *reply)
+{
+    return (reply->ioerrMatched < c_ioerr_len);
+}
+
+/**************************************************************************/
+/*!
+  @brief  Get the delays currently used between parts of a request, such as
+  so that they can be saved across a power cycle.
+  @param   i2cChunkMs
+  An out parameter for the delay between I2C chunks, or `NULL`.
+  @param   i2cSegmentMs
+  An out parameter for the delay between I2C segments, or `NULL`.
+  @param   serialSegmentMs
+  An out parameter for the delay between Serial segments, or `NULL`.
+*/
+/**************************************************************************/
+void NoteGetPacing(uint32_t *i2cChunkMs, uint32_t *i2cSegmentMs, uint32_t *serialSegmentMs)
+{
+    if (i2cChunkMs != NULL) {
+        *i2cChunkMs = paceMs[PACE_I2C_CHUNK];
+    }
+    if (i2cSegmentMs != NULL) {
+        *i2cSegmentMs = paceMs[PACE_I2C_SEGMENT];
+    }
+    if (serialSegmentMs != NULL) {
+        *serialSegmentMs = paceMs[PACE_SERIAL_SEGMENT];
+    }
+}
+
+/**************************************************************************/
+/*!
+  @brief  Set the delays used between parts of a request, such as to
+  restore those learned before a power cycle.  Each is limited to the
+  range within which it would otherwise adapt.
+  @param   i2cChunkMs
+  The delay between I2C chunks.
+  @param   i2cSegmentMs
+  The delay between I2C segments.
+  @param   serialSegmentMs
+  The delay between Serial segments.
+*/
+/**************************************************************************/
+void NoteSetPacing(uint32_t i2cChunkMs, uint32_t i2cSegmentMs, uint32_t serialSegmentMs)
+{
+    paceMs[PACE_I2C_CHUNK] = _PaceClamp(PACE_I2C_CHUNK, i2cChunkMs);
+    paceMs[PACE_I2C_SEGMENT] = _PaceClamp(PACE_I2C_SEGMENT, i2cSegmentMs);
+    paceMs[PACE_SERIAL_SEGMENT] = _PaceClamp(PACE_SERIAL_SEGMENT, serialSegmentMs);
+}
+
+/**************************************************************************/
+/*!
+  @brief  Find the `req` string of a request, either in the object or by
+  scanning the JSON text for it, without parsing the whole request.
+  @param   json
+  The JSON text of the request, or `NULL`.
+  @param   jsonRequest
+  The request object, used only if `json` is `NULL`.
+  @param   reqLen
+  An out parameter for the length of the string.
+  @returns the string, which is not terminated when scanned from the text,
+  or `NULL` if there is none.
+*/
+/**************************************************************************/
+static const char *_LatencyReq(const char *json, J *jsonRequest, size_t *reqLen)
+{
+    if (json == NULL) {
+        const char *req = JGetString(jsonRequest, "req");
+        *reqLen = strlen(req);
+        return (*reqLen == 0 ? NULL : req);
+    }
+    const char *p = strstr(json, "\"req\"");
+    if (p == NULL) {
+        return NULL;
+    }
+    p += 5;
+    while (*p == ' ' || *p == '\t') {
+        p++;
+    }
+    if (*p++ != ':') {
+        return NULL;
+    }
+    while (*p == ' ' || *p == '\t') {
+        p++;
+    }
+    if (*p++ != '"') {
+        return NULL;
+    }
+    const char *end = strchr(p, '"');
+    if (end == NULL || end == p) {
+        return NULL;
+    }
+    *reqLen = (size_t) (end - p);
+    return p;
+}
+
+/**************************************************************************/
+/*!
+  @brief  Get ready to wait for the reply to a request, by looking up the
+  latency learned for its kind of request so that the first wait lasts
+  until just before the reply is expected.  A kind of request that hasn't
+  been seen before takes the place of the one least recently seen.
+  @param   reply
+  The state of the reply, whose transaction has just begun.
+  @param   json
+  The JSON text of the request, or `NULL`.
+  @param   jsonRequest
+  The request object, used only if `json` is `NULL`.
+*/
+/**************************************************************************/
+void latencyBegin(transactionReply *reply, const char *json, J *jsonRequest)
+{
+    reply->latency = 0;
+    reply->expectMs = 0;
+    reply->waitMs = CARD_REPLY_POLL_MIN_MS;
+    size_t reqLen = 0;
+    const char *req = _LatencyReq(json, jsonRequest, &reqLen);
+    if (req == NULL) {
+        return;
+    }
+    if (reqLen >= CARD_REPLY_LATENCY_REQ_LEN) {
+        reqLen = CARD_REPLY_LATENCY_REQ_LEN-1;
+    }
+
+    // Find it, and move it to the front
+    int i;
+    for (i=0; i<latencyCount; i++) {
+        if (strncmp(latencies[i].req, req, reqLen) == 0 && latencies[i].req[reqLen] == '\0') {
+            break;
+        }
+    }
+    replyLatency found;
+    if (i < latencyCount) {
+        found = latencies[i];
+    } else {
+        memcpy(found.req, req, reqLen);
+        found.req[reqLen] = '\0';
+        found.latencyMs = 0;
+        found.samples = 0;
+        if (latencyCount < CARD_REPLY_LATENCIES) {
+            latencyCount++;
+        }
+        i = latencyCount-1;
+    }
+    memmove(&latencies[1], &latencies[0], i*sizeof(replyLatency));
+    latencies[0] = found;
+
+    // Wake a little early, because a reply is later than its average about as often as it's earlier
+    reply->latency = 1;
+    reply->expectMs = found.latencyMs - found.latencyMs/8;
+}
+
+/**************************************************************************/
+/*!
+  @brief  Learn from the arrival of the start of a reply how long the
+  Notecard takes to reply to its kind of request, as an average that
+  follows changes in it without being thrown by the odd outlier.
+  @param   reply
+  The state of the reply, which has started to arrive.
+*/
+/**************************************************************************/
+void latencyArrived(transactionReply *reply)
+{
+    if (reply->latency == 0) {
+        return;
+    }
+    replyLatency *l = &latencies[reply->latency-1];
+    reply->latency = 0;
+    uint32_t sampleMs = _GetMs() - reply->startMs;
+    if (l->samples == 0) {
+        l->latencyMs = sampleMs;
+    } else {
+        l->latencyMs = (uint32_t) ((int32_t) l->latencyMs + ((int32_t) sampleMs - (int32_t) l->latencyMs) / 4);
+    }
+    if (l->samples < UINT32_MAX) {
+        l->samples++;
+    }
+}
+
+/**************************************************************************/
+/*!
+  @brief  Get how long to wait before polling again for a reply that hasn't
+  yet arrived, which is until just before it is expected and then for
+  exponentially longer each time that it still hasn't.
+  @param   reply
+  The state of the reply.
+  @returns the time to wait, in milliseconds.
+*/
+/**************************************************************************/
+uint32_t latencyWaitMs(transactionReply *reply)
+{
+    uint32_t elapsedMs = _GetMs() - reply->startMs;
+    if (elapsedMs + CARD_REPLY_POLL_MIN_MS < reply->expectMs) {
+        return reply->expectMs - elapsedMs;
+    }
+    uint32_t waitMs = reply->waitMs;
+    reply->waitMs = (waitMs*2 > CARD_REPLY_POLL_MAX_MS ? CARD_REPLY_POLL_MAX_MS : waitMs*2);
+    return waitMs;
+}
+
+/**************************************************************************/
+/*!
+  @brief  Get the reply latency learned for a kind of request, such as to
+  see which requests are slow, or how well the waits for them are fitted.
+  @param   index
+  The index of the kind of request, most recently used first.
+  @param   req
+  An out parameter for the `req` string, or `NULL`.
+  @param   reqLen
+  The size of the `req` buffer.
+  @param   latencyMs
+  An out parameter for the average time, in milliseconds, from the end of
+  the request to the start of its reply, or `NULL`.
+  @param   samples
+  An out parameter for the number of replies it was learned from, or `NULL`.
+  @returns boolean. `true` if there is a kind of request at that index.
+*/
+/**************************************************************************/
+bool NoteGetReplyLatency(int index, char *req, size_t reqLen, uint32_t *latencyMs, uint32_t *samples)
+{
+    if (index < 0 || index >= latencyCount) {
+        return false;
+    }
+    if (req != NULL) {
+        strlcpy(req, latencies[index].req, reqLen);
+    }
+    if (latencyMs != NULL) {
+        *latencyMs = latencies[index].latencyMs;
+    }
+    if (samples != NULL) {
+        *samples = latencies[index].samples;
+    }
+    return true;
+}
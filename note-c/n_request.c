@@ -19,6 +19,59 @@ static int suppressShowTransactions = 0;
 // Flag that gets set whenever an error occurs that should force a reset
 static bool resetRequired = true;
 
+// Parse responses incrementally as they arrive rather than buffering them
+static bool streamResponses = false;
+
+// Parse buffered responses into a single allocation rather than one per item
+static bool arenaResponses = false;
+
+// Parse buffered responses in place, adopting the buffer rather than copying strings out of it
+static bool inSituResponses = false;
+
+// A struct into which a response is to be parsed
+typedef struct {
+    const char *path;
+    void *s;
+    const JField *fields;
+} structResponse;
+
+// The transaction in progress, whose response is received by polling.  A transaction is settled
+// when its response was decided without one being received.
+static struct {
+    bool active;
+    bool settled;
+    bool noResponseExpected;
+    const char * const *fields;
+    const structResponse *target;
+    const char *errStr;
+    char *responseJSON;
+    JStream *responseStream;
+    J *rsp;
+    transactionReply reply;
+} transaction;
+
+// Forwards
+static J *noteTransaction(J *req, const char * const *fields, const structResponse *target);
+static bool transactionBegin(J *req, const char * const *fields, const structResponse *target);
+static bool transactionPoll(bool block);
+static J *transactionComplete(void);
+
+/**************************************************************************/
+/*!
+    @brief  Show the text of a response on the debug console.
+    @param   responseJSON
+               The response, which may or may not end with a newline.
+*/
+/**************************************************************************/
+static void showResponse(const char *responseJSON)
+{
+    if (responseJSON[strlen(responseJSON)-1] == '\n') {
+        _Debug(responseJSON);
+    } else {
+        _Debugln(responseJSON);
+    }
+}
+
 /**************************************************************************/
 /*!
     @brief  Create an error response document.
@@ -61,6 +114,60 @@ void NoteResumeTransactionDebug()
     suppressShowTransactions--;
 }
 
+/**************************************************************************/
+/*!
+    @brief  Enable or disable streaming of responses.  When enabled, the
+            transport feeds each response to the JSON parser as it arrives,
+            so that the response text is never buffered in its entirety and
+            peak memory during a transaction is roughly halved.  Because the
+            response text isn't retained, transaction debug output shows the
+            response as re-rendered from the parsed object.
+    @param   enable
+               `true` to stream responses, `false` to buffer them (the default).
+*/
+/**************************************************************************/
+void NoteStreamResponses(bool enable)
+{
+    streamResponses = enable;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Enable or disable parsing of responses into an arena.  When
+            enabled, a buffered response is parsed into a single allocation
+            rather than one for every item and string within it, which is
+            freed all at once by `NoteDeleteResponse`.  Items detached from
+            such a response must not outlive it.  Streamed responses are
+            unaffected.
+    @param   enable
+               `true` to parse responses into an arena, `false` to allocate
+               each item separately (the default).
+*/
+/**************************************************************************/
+void NoteArenaResponses(bool enable)
+{
+    arenaResponses = enable;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Enable or disable parsing of responses in place.  When enabled,
+            strings are unescaped within the buffer that the response was
+            received into, which is then kept and freed along with the
+            response by `NoteDeleteResponse`, rather than each string being
+            copied out of it before it is freed.  Items are allocated as if
+            by `NoteArenaResponses`, and so detached items must not outlive
+            the response.  Streamed responses are unaffected.
+    @param   enable
+               `true` to parse responses in place, `false` to copy strings
+               out of the buffer (the default).
+*/
+/**************************************************************************/
+void NoteInSituResponses(bool enable)
+{
+    inSituResponses = enable;
+}
+
 /**************************************************************************/
 /*!
     @brief  Create a new request object to populate before sending to the Notecard.
@@ -215,6 +322,89 @@ J *NoteRequestResponse(J *req)
     return rsp;
 }
 
+/**************************************************************************/
+/*!
+    @brief  Send a request to the Notecard and return only the wanted fields
+            of the response, skipping over the rest rather than allocating
+            memory for them.  The `err` field is always included, so that
+            `NoteResponseError` works as it does on a full response.
+            Frees the request structure from memory after sending the request.
+    @param   req
+               The `J` cJSON request object.
+    @param   fields
+               A NULL-terminated list of the fields wanted, which may name
+               fields within objects with dotted paths such as `body.temp`.
+  @returns a `J` cJSON object with the response, or NULL if there is
+             insufficient memory.
+*/
+/**************************************************************************/
+J *NoteRequestResponseFields(J *req, const char * const *fields)
+{
+    // Exit if null request.  This allows safe execution of the form NoteRequestResponseFields(NoteNewRequest("xxx"), fields)
+    if (req == NULL) {
+        return NULL;
+    }
+
+    // Add the error to the fields wanted
+    size_t count = 0;
+    while (fields[count] != NULL) {
+        count++;
+    }
+    const char **wanted = (const char **) _Malloc((count + 2) * sizeof(const char *));
+    if (wanted == NULL) {
+        JDelete(req);
+        return NULL;
+    }
+    wanted[0] = c_err;
+    memcpy(&wanted[1], fields, (count + 1) * sizeof(const char *));
+
+    // Execute the transaction
+    J *rsp = noteTransaction(req, wanted, NULL);
+    _Free(wanted);
+
+    // Free the request and exit
+    JDelete(req);
+    return rsp;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Send a request to the Notecard and parse the response directly
+            into a C struct as described by a table of its fields, without
+            allocating memory for any of it other than the `err` field.
+            Fields that are missing from the response are left as they were.
+            Frees the request structure from memory after sending the request.
+    @param   req
+               The `J` cJSON request object.
+    @param   path
+               The object within the response to be parsed, such as `body`,
+               or NULL for the response itself.
+    @param   s
+               The struct to be filled in.  If the response is malformed,
+               the fields parsed before the error was found are left updated.
+    @param   fields
+               The fields of the struct, such as `NoteTrackPointFields`.
+  @returns a `J` cJSON object with only the `err` field of the response, if
+             any, or NULL if there is insufficient memory.
+*/
+/**************************************************************************/
+J *NoteRequestResponseStruct(J *req, const char *path, void *s, const JField *fields)
+{
+    // Exit if null request.  This allows safe execution of the form NoteRequestResponseStruct(NoteNewRequest("xxx"), ...)
+    if (req == NULL) {
+        return NULL;
+    }
+
+    // Execute the transaction, keeping only the error in the response
+    const char *wanted[] = { c_err, NULL };
+    structResponse target = { path, s, fields };
+    J *rsp = noteTransaction(req, wanted, &target);
+
+    // Free the request and exit
+    JDelete(req);
+    return rsp;
+}
+
 /**************************************************************************/
 /*!
     @brief  Send a request to the Notecard and return the response.
@@ -326,6 +516,84 @@ char *NoteRequestResponseJSON(char *reqJSON)
 */
 /**************************************************************************/
 J *NoteTransaction(J *req)
+{
+    return noteTransaction(req, NULL, NULL);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Begin a transaction with the Notecard without waiting for its
+            response, so that other work can be done while the Notecard
+            processes the request.  The response is then collected by
+            `NoteTransactionComplete`, after `NoteTransactionPoll` reports
+            that it's ready or to wait for it.  Only one transaction may be
+            in progress at a time, and the Notecard is locked until it
+            completes.  Does NOT free the request structure from memory,
+            which may be done as soon as this returns.
+    @param   req
+               The `J` cJSON request object.
+  @returns `true` if the transaction was begun, or `false` if the request is
+             NULL or another transaction is already in progress.  Errors in
+             sending the request are reported in the response.
+*/
+/**************************************************************************/
+bool NoteTransactionBegin(J *req)
+{
+    if (req == NULL) {
+        return false;
+    }
+    return transactionBegin(req, NULL, NULL);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Receive as much of the response to the transaction in progress
+            as has arrived, without waiting for the rest of it.
+  @returns `true` if the response is ready to be collected by
+             `NoteTransactionComplete`, or if no transaction is in progress.
+*/
+/**************************************************************************/
+bool NoteTransactionPoll()
+{
+    if (!transaction.active) {
+        return true;
+    }
+    return transactionPoll(false);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Complete the transaction in progress, waiting for its response if
+            it isn't yet ready.
+  @returns a `J` cJSON object with the response, or NULL if no transaction is
+             in progress or there is insufficient memory.
+*/
+/**************************************************************************/
+J *NoteTransactionComplete()
+{
+    if (!transaction.active) {
+        return NULL;
+    }
+    return transactionComplete();
+}
+
+/**************************************************************************/
+/*!
+    @brief  Initiate a transaction to the Notecard and return the response,
+            as `NoteTransaction`, optionally with only some of its fields.
+    @param   req
+               The `J` cJSON request object.
+    @param   fields
+               A NULL-terminated list of the fields wanted from a buffered
+               response, including `err`, or NULL for all of them.
+    @param   target
+               A struct into which the response is also to be parsed, or
+               NULL.  The response is then buffered even when streaming.
+  @returns a `J` cJSON object with the response, or NULL if there is
+             insufficient memory.
+*/
+/**************************************************************************/
+static J *noteTransaction(J *req, const char * const *fields, const structResponse *target)
 {
 
     // Validate in case of memory failure of the requestor
@@ -333,6 +601,44 @@ J *NoteTransaction(J *req)
         return NULL;
     }
 
+    // Refuse to interleave with a transaction that's in progress
+    if (!transactionBegin(req, fields, target)) {
+        return errDoc(ERRSTR("another transaction is in progress",c_bad));
+    }
+
+    // Wait for the response
+    return transactionComplete();
+
+}
+
+/**************************************************************************/
+/*!
+    @brief  Begin a transaction by sending the request to the Notecard,
+            leaving its response to be received by `transactionPoll`.
+    @param   req
+               The `J` cJSON request object.
+    @param   fields
+               A NULL-terminated list of the fields wanted from a buffered
+               response, including `err`, or NULL for all of them.
+    @param   target
+               A struct into which the response is also to be parsed, or
+               NULL.
+  @returns `false` if another transaction is already in progress.
+*/
+/**************************************************************************/
+static bool transactionBegin(J *req, const char * const *fields, const structResponse *target)
+{
+
+    // Only one transaction may be in progress
+    if (transaction.active) {
+        return false;
+    }
+    memset(&transaction, 0, sizeof(transaction));
+    transaction.active = true;
+    transaction.settled = true;
+    transaction.fields = fields;
+    transaction.target = target;
+
     // Determine the request or command type
     const char *reqType = JGetString(req, "req");
     const char *cmdType = JGetString(req, "cmd");
@@ -351,45 +657,106 @@ J *NoteTransaction(J *req)
 #endif
 
     // Determine whether or not a response will be expected, by virtue of "cmd" being present
-    bool noResponseExpected = (reqType[0] == '\0' && cmdType[0] != '\0');
+    transaction.noResponseExpected = (reqType[0] == '\0' && cmdType[0] != '\0');
 
     // If a reset of the module is required for any reason, do it now.
     // We must do this before acquiring lock.
     if (resetRequired) {
         if (!NoteReset()) {
-            return NULL;
+            return true;
         }
     }
 
     // Lock
     _LockNote();
 
-    // Serialize the JSON requet
-    char *json = JPrintUnformatted(req);
-    if (json == NULL) {
-        J *rsp = errDoc(ERRSTR("can't convert to JSON",c_bad));
-        _UnlockNote();
-        return rsp;
-    }
-
-    if (suppressShowTransactions == 0) {
+    // Serialize the JSON requet only if it is to be shown, because otherwise the transport
+    // renders it directly onto the wire without ever holding all of it in memory.
+    char *json = NULL;
+    if (suppressShowTransactions == 0 && NoteIsDebugOutputActive()) {
+        json = JPrintUnformatted(req);
+        if (json == NULL) {
+            transaction.rsp = errDoc(ERRSTR("can't convert to JSON",c_bad));
+            _UnlockNote();
+            return true;
+        }
         _Debugln(json);
     }
 
-    // Pertform the transaction
-    char *responseJSON;
-    const char *errStr;
-    if (noResponseExpected) {
-        errStr = _Transaction(json, NULL);
+    // Send the request
+    if (transaction.noResponseExpected) {
+        transaction.errStr = _TransactionBegin(json, req, NULL, NULL, &transaction.reply);
+    } else if (streamResponses && target == NULL) {
+        transaction.responseStream = JParseStreamBegin();
+        if (transaction.responseStream == NULL) {
+            if (json != NULL) {
+                JFree(json);
+            }
+            transaction.rsp = errDoc(ERRSTR("insufficient memory",c_mem));
+            _UnlockNote();
+            return true;
+        }
+        transaction.errStr = _TransactionBegin(json, req, NULL, transaction.responseStream, &transaction.reply);
     } else {
-        errStr = _Transaction(json, &responseJSON);
+        transaction.errStr = _TransactionBegin(json, req, &transaction.responseJSON, NULL, &transaction.reply);
     }
 
     // Free the json
-    JFree(json);
+    if (json != NULL) {
+        JFree(json);
+    }
+
+    // The response is now to be received
+    transaction.settled = false;
+    return true;
+
+}
+
+/**************************************************************************/
+/*!
+    @brief  Receive as much of the response to the transaction in progress
+            as has arrived.
+    @param   block
+               If `true`, wait for all of it.
+  @returns `true` if the response is ready.
+*/
+/**************************************************************************/
+static bool transactionPoll(bool block)
+{
+    if (!transaction.settled && transaction.errStr == NULL) {
+        transaction.errStr = _TransactionPoll(&transaction.reply, block);
+    }
+    return (transaction.settled || transaction.errStr != NULL || transaction.reply.done);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Complete the transaction in progress, waiting for its response if
+            need be, and parse the response.
+  @returns a `J` cJSON object with the response, or NULL if there is
+             insufficient memory.
+*/
+/**************************************************************************/
+static J *transactionComplete()
+{
+
+    // Wait for the response, after which another transaction may begin
+    transactionPoll(true);
+    transaction.active = false;
+    if (transaction.settled) {
+        return transaction.rsp;
+    }
+    const char *errStr = transaction.errStr;
+    char *responseJSON = transaction.responseJSON;
+    JStream *responseStream = transaction.responseStream;
+    const char * const *fields = transaction.fields;
+    const structResponse *target = transaction.target;
 
     // If error, queue up a reset
     if (errStr != NULL) {
+        if (responseStream != NULL) {
+            JDelete(JParseStreamEnd(responseStream));
+        }
         NoteResetRequired();
         J *rsp = errDoc(errStr);
         _UnlockNote();
@@ -397,13 +764,54 @@ J *NoteTransaction(J *req)
     }
 
     // Exit with a blank object (with no err field) if no response expected
-    if (noResponseExpected) {
+    if (transaction.noResponseExpected) {
         _UnlockNote();
         return JCreateObject();
     }
 
-    // Parse the reply from the card on the input stream
-    J *rspdoc = JParse(responseJSON);
+    // When streaming, the reply was parsed as it arrived
+    if (responseStream != NULL) {
+        J *rspdoc = JParseStreamEnd(responseStream);
+        if (rspdoc == NULL) {
+            _Debug("invalid JSON\n");
+            J *rsp = errDoc(ERRSTR("unrecognized response from card {io}",c_iobad));
+            _UnlockNote();
+            return rsp;
+        }
+        if (suppressShowTransactions == 0 && NoteIsDebugOutputActive()) {
+            char *rspJSON = JPrintUnformatted(rspdoc);
+            if (rspJSON != NULL) {
+                _Debugln(rspJSON);
+                JFree(rspJSON);
+            }
+        }
+        _UnlockNote();
+        return rspdoc;
+    }
+
+    // Parse the reply from the card on the input stream, noting that parsing
+    // in place alters the buffer, and so it's shown beforehand
+    if (inSituResponses && fields == NULL) {
+        if (suppressShowTransactions == 0) {
+            showResponse(responseJSON);
+        }
+        J *rspdoc = JParseInSitu(responseJSON);
+        if (rspdoc == NULL) {
+            _Debug("invalid JSON\n");
+            _Free(responseJSON);
+            J *rsp = errDoc(ERRSTR("unrecognized response from card {io}",c_iobad));
+            _UnlockNote();
+            return rsp;
+        }
+        _UnlockNote();
+        return rspdoc;
+    }
+    J *rspdoc;
+    if (fields != NULL) {
+        rspdoc = JParseFields(responseJSON, fields);
+    } else {
+        rspdoc = (arenaResponses ? JParseArena(responseJSON) : JParse(responseJSON));
+    }
     if (rspdoc == NULL) {
         _Debug("invalid JSON: ");
         _Debug(responseJSON);
@@ -413,13 +821,14 @@ J *NoteTransaction(J *req)
         return rsp;
     }
 
+    // Fill in the struct from the same buffer
+    if (target != NULL) {
+        JParseStruct(responseJSON, target->path, target->s, target->fields);
+    }
+
     // Debug
     if (suppressShowTransactions == 0) {
-        if (responseJSON[strlen(responseJSON)-1] == '\n') {
-            _Debug(responseJSON);
-        } else {
-            _Debugln(responseJSON);
-        }
+        showResponse(responseJSON);
     }
 
     // Discard the buffer now that it's parsed
@@ -16,54 +16,119 @@
 // Turbo I/O mode
 extern bool cardTurboIO;
 
+// Forwards
+static Jbool _WriteRequest(void *context, const char *data, size_t length);
+
+/**************************************************************************/
+/*!
+    @brief  Transmit part of a request, in segments so as not to overwhelm
+            the notecard's interrupt buffers.  This is a `JPrintSinkFn`, so
+            that a request can be serialized directly onto the wire.
+    @param   context
+               A `uint32_t` counting the bytes sent in the current segment.
+    @param   data
+               The data to transmit.
+    @param   length
+               The length of the data.
+  @returns `true`.
+*/
+/**************************************************************************/
+static Jbool _WriteRequest(void *context, const char *data, size_t length)
+{
+    uint32_t *sentInSegment = (uint32_t *) context;
+    while (length > 0) {
+        if (*sentInSegment >= CARD_REQUEST_SERIAL_SEGMENT_MAX_LEN) {
+            *sentInSegment = 0;
+            pacingDelay(PACE_SERIAL_SEGMENT);
+        }
+        size_t segLen = CARD_REQUEST_SERIAL_SEGMENT_MAX_LEN - *sentInSegment;
+        if (segLen > length) {
+            segLen = length;
+        }
+        _SerialTransmit((uint8_t *)data, segLen, false);
+        *sentInSegment += segLen;
+        data += segLen;
+        length -= segLen;
+    }
+    return true;
+}
+
 /**************************************************************************/
 /*!
-    @brief  Given a JSON string, perform an Serial transaction with the Notecard.
+    @brief  Given a JSON request, begin a Serial transaction with the Notecard
+            by transmitting the request, leaving its reply to be received by
+            `serialNoteTransactionPoll`.
     @param   json
-               A c-string containing the JSON request object.
+               A c-string containing the JSON request object, or `NULL` if
+               the request is to be serialized from `jsonRequest` directly
+               onto the wire without ever being held in memory in its
+               entirety.
+    @param   jsonRequest
+               The request object, used only if `json` is `NULL`.
     @param   jsonResponse
                An out parameter c-string buffer that will contain the JSON
                response from the Notercard.
+    @param   jsonStream
+               If not `NULL`, a streaming parser that is fed the response as
+               it is received, in which case `jsonResponse` is unused and no
+               response buffer is allocated.
+    @param   reply
+               The state of the reply, which is done if no reply is expected
+               or if the transaction failed.
   @returns a c-string with an error, or `NULL` if no error ocurred.
 */
 /**************************************************************************/
-const char *serialNoteTransaction(char *json, char **jsonResponse)
+const char *serialNoteTransactionBegin(char *json, J *jsonRequest, char **jsonResponse, JStream *jsonStream, transactionReply *reply)
 {
+    memset(reply, 0, sizeof(transactionReply));
+    reply->done = true;
 
-    // Append newline to the transaction
-    int jsonLen = strlen(json);
-    uint8_t *transmitBuf = (uint8_t *) _Malloc(jsonLen+c_newline_len);
-    if (transmitBuf == NULL) {
-        return ERRSTR("insufficient memory",c_mem);
-    }
-    memcpy(transmitBuf, json, jsonLen);
-    memcpy(&transmitBuf[jsonLen], c_newline, c_newline_len);
-    jsonLen += c_newline_len;
-
-    // Transmit the request in segments so as not to overwhelm the notecard's interrupt buffers
-    uint32_t segOff = 0;
-    uint32_t segLeft = jsonLen;
-    while (true) {
-        size_t segLen = segLeft;
-        if (segLen > CARD_REQUEST_SERIAL_SEGMENT_MAX_LEN) {
-            segLen = CARD_REQUEST_SERIAL_SEGMENT_MAX_LEN;
-        }
-        _SerialTransmit((uint8_t *)&transmitBuf[segOff], segLen, false);
-        segOff += segLen;
-        segLeft -= segLen;
-        if (segLeft == 0) {
-            break;
-        }
-        if (!cardTurboIO) {
-            _DelayMs(CARD_REQUEST_SERIAL_SEGMENT_DELAY_MS);
+    // Transmit the request followed by a newline, without first copying it to append the newline
+    uint32_t sentInSegment = 0;
+    if (json != NULL) {
+        _WriteRequest(&sentInSegment, json, strlen(json));
+    } else {
+        char window[CARD_REQUEST_PRINT_WINDOW_LEN];
+        if (!JPrintToSink(jsonRequest, window, sizeof(window), false, _WriteRequest, &sentInSegment)) {
+            // Part of the request may already be on the wire, so end the line for the notecard to
+            // reject rather than leave it to run into the next request.  The reset that follows
+            // the failure drains the notecard's reply to it.
+            _WriteRequest(&sentInSegment, c_newline, c_newline_len);
+            return ERRSTR("can't convert to JSON",c_bad);
         }
     }
-
-    // Free the transmit buffer
-    _Free(transmitBuf);
+    _WriteRequest(&sentInSegment, c_newline, c_newline_len);
 
     // If no reply expected, we're done
-    if (jsonResponse == NULL) {
+    if (jsonResponse == NULL && jsonStream == NULL) {
+        pacingAdjust(PACE_SERIAL_SEGMENT, true);
+        return NULL;
+    }
+
+    // The reply is now awaited
+    reply->jsonResponse = jsonResponse;
+    reply->jsonStream = jsonStream;
+    reply->startMs = _GetMs();
+    reply->done = false;
+    return NULL;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Receive as much of the reply to a Serial transaction as has
+            arrived, until the reply is complete.
+    @param   reply
+               The state of the reply, which is done when this returns an
+               error or when the reply has been received in its entirety.
+    @param   block
+               If `true`, wait for the reply to be complete rather than
+               returning as soon as nothing is available.
+  @returns a c-string with an error, or `NULL` if no error ocurred.
+*/
+/**************************************************************************/
+const char *serialNoteTransactionPoll(transactionReply *reply, bool block)
+{
+    if (reply->done) {
         return NULL;
     }
 
@@ -71,85 +136,141 @@ const char *serialNoteTransaction(char *json, char **jsonResponse)
     // because the json parse operation immediately following is subject to the
     // serial port timeout. We'd like more flexibility in max timeout and ultimately
     // in our error handling.
-    uint32_t startMs;
-    for (startMs = _GetMs(); !_SerialAvailable(); ) {
-        if (_GetMs() >= startMs + (NOTECARD_TRANSACTION_TIMEOUT_SEC*1000)) {
+    if (!reply->receiving) {
+        while (!_SerialAvailable()) {
+            if (_GetMs() >= reply->startMs + (NOTECARD_TRANSACTION_TIMEOUT_SEC*1000)) {
+                pacingAdjust(PACE_SERIAL_SEGMENT, false);
 #ifdef ERRDBG
-            _Debug("reply to request didn't arrive from module in time\n");
+                _Debug("reply to request didn't arrive from module in time\n");
 #endif
-            return ERRSTR("transaction timeout {io}",c_iotimeout);
+                reply->done = true;
+                return ERRSTR("transaction timeout {io}",c_iotimeout);
+            }
+            if (!block) {
+                return NULL;
+            }
+            if (!cardTurboIO) {
+                _SerialWait(latencyWaitMs(reply));
+            }
         }
-        if (!cardTurboIO) {
-            _DelayMs(10);
+
+        // Allocate a buffer for input, noting that we always put the +1 in the alloc so we can be assured
+        // that it can be null-terminated.  This must be the case because json parsing requires a
+        // null-terminated string.  When streaming, no buffer is needed because each byte is handed
+        // to the parser as it arrives.
+        if (reply->jsonStream == NULL) {
+            reply->jsonbufAllocLen = ALLOC_CHUNK;
+            reply->jsonbuf = (char *) _Malloc(reply->jsonbufAllocLen+1);
+            if (reply->jsonbuf == NULL) {
+#ifdef ERRDBG
+                _Debug("transaction: jsonbuf malloc failed\n");
+#endif
+                reply->done = true;
+                return ERRSTR("insufficient memory",c_mem);
+            }
         }
+        latencyArrived(reply);
+        reply->receiving = true;
+        reply->startMs = _GetMs();
     }
 
-    // Allocate a buffer for input, noting that we always put the +1 in the alloc so we can be assured
-    // that it can be null-terminated.  This must be the case because json parsing requires a
-    // null-terminated string.
-    int jsonbufAllocLen = ALLOC_CHUNK;
-    char *jsonbuf = (char *) _Malloc(jsonbufAllocLen+1);
-    if (jsonbuf == NULL) {
+    // Receive as much as has arrived at a time, straight into the json buffer or, when streaming,
+    // into a small buffer from which it's handed to the parser.  The reply ends at the newline,
+    // and anything after it is discarded.
+    char chunk[CARD_REPLY_SERIAL_CHUNK_LEN];
+    bool receivedNewline = false;
+    while (!receivedNewline) {
+
+        // Make room in the json buffer, doubling it as it fills so that a long reply is copied rarely
+        char *data = chunk;
+        size_t room = sizeof(chunk);
+        if (reply->jsonStream == NULL) {
+            if (reply->jsonbufLen >= reply->jsonbufAllocLen) {
+                char *jsonbufNew = (char *) _Realloc(reply->jsonbuf, reply->jsonbufAllocLen+1, reply->jsonbufAllocLen*2+1);
+                if (jsonbufNew == NULL) {
 #ifdef ERRDBG
-        _Debug("transaction: jsonbuf malloc failed\n");
+                    _Debug("transaction: jsonbuf malloc grow failed\n");
 #endif
-        return ERRSTR("insufficient memory",c_mem);
-    }
-    int jsonbufLen = 0;
-    char ch = 0;
-    startMs = _GetMs();
-    while (ch != '\n') {
-        if (!_SerialAvailable()) {
-            ch = 0;
-            if (_GetMs() >= startMs + (NOTECARD_TRANSACTION_TIMEOUT_SEC*1000)) {
+                    _Free(reply->jsonbuf);
+                    reply->done = true;
+                    return ERRSTR("insufficient memory",c_mem);
+                }
+                reply->jsonbuf = jsonbufNew;
+                reply->jsonbufAllocLen *= 2;
+            }
+            data = &reply->jsonbuf[reply->jsonbufLen];
+            room = (size_t) (reply->jsonbufAllocLen - reply->jsonbufLen);
+        }
+
+        size_t received = _SerialReceiveBlock((uint8_t *) data, room);
+        if (received == 0) {
+            if (_GetMs() >= reply->startMs + (NOTECARD_TRANSACTION_TIMEOUT_SEC*1000)) {
 #ifdef ERRDBG
-                jsonbuf[jsonbufLen] = '\0';
-                _Debug("received only partial reply after timeout:\n");
-                _Debug(jsonbuf);
-                _Debug("\n");
+                if (reply->jsonbuf != NULL) {
+                    reply->jsonbuf[reply->jsonbufLen] = '\0';
+                    _Debug("received only partial reply after timeout:\n");
+                    _Debug(reply->jsonbuf);
+                    _Debug("\n");
+                }
 #endif
-                _Free(jsonbuf);
+                if (reply->jsonbuf != NULL) {
+                    _Free(reply->jsonbuf);
+                }
+                pacingAdjust(PACE_SERIAL_SEGMENT, false);
+                reply->done = true;
                 return ERRSTR("transaction incomplete {io}",c_iotimeout);
             }
+            if (!block) {
+                return NULL;
+            }
             if (!cardTurboIO) {
-                _DelayMs(1);
+                _SerialWait(1);
             }
             continue;
         }
-        ch = _SerialReceive();
 
         // Because serial I/O can be error-prone, catch common bad data early, knowing that we only accept ASCII
-        if (ch == 0 || (ch & 0x80) != 0) {
+        size_t len = 0;
+        while (len < received && !receivedNewline) {
+            char ch = data[len++];
+            if (ch == 0 || (ch & 0x80) != 0) {
 #ifdef ERRDBG
-            _Debug("invalid data received on serial port from notecard\n");
+                _Debug("invalid data received on serial port from notecard\n");
 #endif
-            _Free(jsonbuf);
-            return ERRSTR("serial communications error {io}",c_iotimeout);
+                if (reply->jsonbuf != NULL) {
+                    _Free(reply->jsonbuf);
+                }
+                pacingAdjust(PACE_SERIAL_SEGMENT, false);
+                reply->done = true;
+                return ERRSTR("serial communications error {io}",c_iotimeout);
+            }
+            receivedNewline = (ch == '\n');
         }
+        pacingScanReply(reply, data, len);
 
-        // Append into the json buffer
-        jsonbuf[jsonbufLen++] = ch;
-        if (jsonbufLen >= jsonbufAllocLen) {
-            jsonbufAllocLen += ALLOC_CHUNK;
-            char *jsonbufNew = (char *) _Malloc(jsonbufAllocLen+1);
-            if (jsonbufNew == NULL) {
-#ifdef ERRDBG
-                _Debug("transaction: jsonbuf malloc grow failed\n");
-#endif
-                _Free(jsonbuf);
-                return ERRSTR("insufficient memory",c_mem);
-            }
-            memcpy(jsonbufNew, jsonbuf, jsonbufLen);
-            _Free(jsonbuf);
-            jsonbuf = jsonbufNew;
+        // When streaming, hand what was received straight to the parser.  A parse error is reported
+        // by the parser when the transaction completes.
+        if (reply->jsonStream != NULL) {
+            JParseStreamFeed(reply->jsonStream, data, len);
+        } else {
+            reply->jsonbufLen += (int) len;
         }
     }
 
+    // The notecard kept up with the request, unless it replied that it didn't
+    pacingAdjust(PACE_SERIAL_SEGMENT, pacingReplyKeptUp(reply));
+    reply->done = true;
+
+    // When streaming, the parser already has the entire reply
+    if (reply->jsonStream != NULL) {
+        return NULL;
+    }
+
     // Null-terminate it, using the +1 space that we'd allocated in the buffer
-    jsonbuf[jsonbufLen] = '\0';
+    reply->jsonbuf[reply->jsonbufLen] = '\0';
 
     // Return it
-    *jsonResponse = jsonbuf;
+    *reply->jsonResponse = reply->jsonbuf;
     return NULL;
 
 }
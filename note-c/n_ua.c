@@ -136,13 +136,13 @@ __attribute__((weak)) J *NoteUserAgent()
     JAddStringToObject(ua, "req_interface", NoteActiveInterface());
 
     if (n_cpu_mem != 0) {
-        JAddNumberToObject(ua, "cpu_mem", n_cpu_mem);
+        JAddIntToObject(ua, "cpu_mem", n_cpu_mem);
     }
     if (n_cpu_mhz != 0) {
-        JAddNumberToObject(ua, "cpu_mhz", n_cpu_mhz);
+        JAddIntToObject(ua, "cpu_mhz", n_cpu_mhz);
     }
     if (n_cpu_cores != 0) {
-        JAddNumberToObject(ua, "cpu_cores", n_cpu_cores);
+        JAddIntToObject(ua, "cpu_cores", n_cpu_cores);
     }
     if (n_cpu_vendor != NULL) {
         JAddStringToObject(ua, "cpu_vendor", n_cpu_vendor);
@@ -56,14 +56,36 @@
 #error What are floating point exponent length symbols for this compiler?
 #endif
 
+// If using fixed point, numbers are integers scaled by JNUMBER_SCALE (so 3.3 is passed as 3300),
+// so that no floating point library is needed at all on an MCU without an FPU.  Integers too large to be held that way are
+// kept exactly alongside, so use JGetInt and JAddIntToObject for counts, times and the like.
+// Every JNUMBER is scaled, whether passed in or returned: JAddNumberToObject(req,"x",12) adds 0.012,
+// NoteSetLocation(42360,-71058) sets 42.36,-71.058, and JGetNumber and NoteGetVoltage return thousandths.
+// Write JNUMBER constants with JNUMBER_FROM_INT(12) or JNUMBER_FROM_MILLI(3300), which mean the same
+// number whether or not NOTE_FIXED is defined.  JNUMBER_FROM_INT takes whole numbers of at most
+// JNUMBER_MAX/JNUMBER_SCALE in magnitude.
+#if defined(NOTE_FIXED)
+#define JNUMBER int32_t
+#define JNUMBER_DECIMALS 3
+#define JNUMBER_SCALE 1000
+#define JNUMBER_MAX INT32_MAX
+#define JNUMBER_MIN INT32_MIN
+#define JNUMBER_FROM_INT(i) ((JNUMBER) (i) * JNUMBER_SCALE)
+#define JNUMBER_FROM_MILLI(m) ((JNUMBER) (m))
+#define ERRSTR(x,y) (y)
+#define NOTE_LOWMEM
 // If using a short float, we must be on a VERY small MCU.  In this case, define additional
 // symbols that will save quite a bit of memory in the runtime image.
-#ifdef NOTE_FLOAT
+#elif defined(NOTE_FLOAT)
 #define JNUMBER float
+#define JNUMBER_FROM_INT(i) ((JNUMBER) (i))
+#define JNUMBER_FROM_MILLI(m) ((JNUMBER) (m) / 1000)
 #define ERRSTR(x,y) (y)
 #define NOTE_LOWMEM
 #else
 #define JNUMBER double
+#define JNUMBER_FROM_INT(i) ((JNUMBER) (i))
+#define JNUMBER_FROM_MILLI(m) ((JNUMBER) (m) / 1000)
 #define ERRSTR(x,y) (x)
 #define ERRDBG
 #endif
@@ -84,10 +106,15 @@ extern "C" {
 // cJSON wrappers
 #include "n_cjson.h"
 
+// Field tables for the edge structs
+extern const JField NoteTrackPointFields[];
+extern const JField NoteMotionPointFields[];
+
 // Card callback functions
 typedef void (*mutexFn) (void);
 typedef void * (*mallocFn) (size_t size);
 typedef void (*freeFn) (void *);
+typedef void * (*reallocFn) (void *, size_t size);
 typedef void (*delayMsFn) (uint32_t ms);
 typedef uint32_t (*getMsFn) (void);
 typedef size_t (*debugOutputFn) (const char *text);
@@ -95,6 +122,8 @@ typedef bool (*serialResetFn) (void);
 typedef void (*serialTransmitFn) (uint8_t *data, size_t len, bool flush);
 typedef bool (*serialAvailableFn) (void);
 typedef char (*serialReceiveFn) (void);
+typedef bool (*serialWaitFn) (uint32_t timeoutMs);
+typedef size_t (*serialReceiveBlockFn) (uint8_t *data, size_t len);
 typedef bool (*i2cResetFn) (uint16_t DevAddress);
 typedef const char * (*i2cTransmitFn) (uint16_t DevAddress, uint8_t* pBuffer, uint16_t Size);
 typedef const char * (*i2cReceiveFn) (uint16_t DevAddress, uint8_t* pBuffer, uint16_t Size, uint32_t *avail);
@@ -109,28 +138,44 @@ J *NoteNewRequest(const char *request);
 J *NoteNewCommand(const char *request);
 J *NoteRequestResponse(J *req);
 J *NoteRequestResponseWithRetry(J *req, uint32_t timeoutSeconds);
+J *NoteRequestResponseFields(J *req, const char * const *fields);
+J *NoteRequestResponseStruct(J *req, const char *path, void *s, const JField *fields);
 char *NoteRequestResponseJSON(char *reqJSON);
 void NoteSuspendTransactionDebug(void);
 void NoteResumeTransactionDebug(void);
+void NoteStreamResponses(bool enable);
+void NoteArenaResponses(bool enable);
+void NoteInSituResponses(bool enable);
 #define SYNCSTATUS_LEVEL_MAJOR         0
 #define SYNCSTATUS_LEVEL_MINOR         1
 #define SYNCSTATUS_LEVEL_DETAILED      2
 #define SYNCSTATUS_LEVEL_ALGORITHMIC   3
 #define SYNCSTATUS_LEVEL_ALL          -1
 bool NoteDebugSyncStatus(int pollFrequencyMs, int maxLevel);
+typedef void (*inboundNoteFn) (const char *file, J *note);
+bool NoteInboundArm(const char **files, int count, inboundNoteFn fn);
+bool NoteInboundDisarm(void);
+bool NoteInboundArmed(void);
+int NoteInboundDispatch(void);
 bool NoteRequest(J *req);
 bool NoteRequestWithRetry(J *req, uint32_t timeoutms);
 #define NoteResponseError(rsp) (!JIsNullString(rsp, "err"))
 #define NoteResponseErrorContains(rsp, errstr) (JContainsString(rsp, "err", errstr))
 #define NoteDeleteResponse(rsp) JDelete(rsp)
 J *NoteTransaction(J *req);
+bool NoteTransactionBegin(J *req);
+bool NoteTransactionPoll(void);
+J *NoteTransactionComplete(void);
 bool NoteErrorContains(const char *errstr, const char *errtype);
 void NoteErrorClean(char *errbuf);
 void NoteSetFnDebugOutput(debugOutputFn fn);
 void NoteSetFnMutex(mutexFn lockI2Cfn, mutexFn unlockI2Cfn, mutexFn lockNotefn, mutexFn unlockNotefn);
 void NoteSetFnDefault(mallocFn mallocfn, freeFn freefn, delayMsFn delayfn, getMsFn millisfn);
 void NoteSetFn(mallocFn mallocfn, freeFn freefn, delayMsFn delayfn, getMsFn millisfn);
+void NoteSetFnRealloc(reallocFn reallocfn);
 void NoteSetFnSerial(serialResetFn resetfn, serialTransmitFn writefn, serialAvailableFn availfn, serialReceiveFn readfn);
+void NoteSetFnSerialWait(serialWaitFn waitfn);
+void NoteSetFnSerialReceiveBlock(serialReceiveBlockFn receiveblockfn);
 #define NOTE_I2C_ADDR_DEFAULT	0x17
 #ifndef NOTE_I2C_MAX_DEFAULT
 #define NOTE_I2C_MAX_DEFAULT	30
@@ -141,6 +186,10 @@ void NoteSetFnSerial(serialResetFn resetfn, serialTransmitFn writefn, serialAvai
 void NoteSetFnI2C(uint32_t i2caddr, uint32_t i2cmax, i2cResetFn resetfn, i2cTransmitFn transmitfn, i2cReceiveFn receivefn);
 void NoteSetFnDisabled(void);
 void NoteSetI2CAddress(uint32_t i2caddress);
+void NoteGetI2CStats(uint32_t *bytesPerSec, uint32_t *stalls, uint32_t *chunkDelayMs);
+void NoteGetPacing(uint32_t *i2cChunkMs, uint32_t *i2cSegmentMs, uint32_t *serialSegmentMs);
+void NoteSetPacing(uint32_t i2cChunkMs, uint32_t i2cSegmentMs, uint32_t serialSegmentMs);
+bool NoteGetReplyLatency(int index, char *req, size_t reqLen, uint32_t *latencyMs, uint32_t *samples);
 
 // User agent
 J *NoteUserAgent(void);
@@ -156,6 +205,7 @@ void NoteDebugIntln(const char *message, int n);
 void NoteDebugf(const char *format, ...);
 void *NoteMalloc(size_t size);
 void NoteFree(void *);
+void *NoteRealloc(void *p, size_t oldSize, size_t newSize);
 long unsigned int NoteGetMs(void);
 void NoteDelayMs(uint32_t ms);
 void NoteLockI2C(void);
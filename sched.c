@@ -0,0 +1,161 @@
+// Copyright 2019 Blues Inc.  All rights reserved.
+// Use of this source code is governed by licenses granted by the
+// copyright holder including that found in the LICENSE file.
+
+#include "sched.h"
+#include "clock.h"
+
+// The run queue, in the order that tasks were posted, which ISRs append to
+static task *volatile runHead = NULL;
+static task *volatile runTail = NULL;
+
+// The timers, in the order that they're due, which only tasks change
+static task *timers = NULL;
+
+// Statistics
+static uint32_t schedDispatched = 0;
+static uint32_t schedMaxLateMs = 0;
+
+// Forwards
+static void timerInsert(task *t);
+static void timerRemove(task *t);
+static void timersExpire(long unsigned int nowMs);
+
+// Initialize a task to call the specified function with the specified context when it's run
+void taskInit(task *t, taskFn fn, void *context) {
+    t->fn = fn;
+    t->context = context;
+    t->dueMs = 0;
+    t->periodMs = 0;
+    t->timed = false;
+    t->posted = false;
+    t->next = NULL;
+    t->nextTimed = NULL;
+}
+
+// Queue a task to be run as soon as those already queued have been run, unless it's already queued.
+// This may be called by ISRs.
+void taskPost(task *t) {
+    unsigned short state = schedDisableInterrupts();
+    if (!t->posted) {
+        t->posted = true;
+        t->next = NULL;
+        if (runTail == NULL)
+            runHead = t;
+        else
+            runTail->next = t;
+        runTail = t;
+    }
+    schedRestoreInterrupts(state);
+}
+
+// Run a task once, after the specified delay, replacing any timer that it has
+void taskAfter(task *t, uint32_t delayMs) {
+    timerRemove(t);
+    t->dueMs = millis() + delayMs;
+    t->periodMs = 0;
+    timerInsert(t);
+}
+
+// Run a task periodically, first after the specified delay, replacing any timer that it has
+void taskEvery(task *t, uint32_t periodMs, uint32_t firstDelayMs) {
+    timerRemove(t);
+    t->dueMs = millis() + firstDelayMs;
+    t->periodMs = periodMs;
+    timerInsert(t);
+}
+
+// Cancel a task's timer.  If the task is already queued, it is still run.
+void taskCancel(task *t) {
+    timerRemove(t);
+    t->periodMs = 0;
+}
+
+// Insert a task into the timers after those that are due no later than it is
+static void timerInsert(task *t) {
+    task **link = &timers;
+    while (*link != NULL && clockReached(t->dueMs, (*link)->dueMs))
+        link = &(*link)->nextTimed;
+    t->nextTimed = *link;
+    *link = t;
+    t->timed = true;
+}
+
+// Remove a task from the timers, if it's there
+static void timerRemove(task *t) {
+    if (!t->timed)
+        return;
+    for (task **link = &timers; *link != NULL; link = &(*link)->nextTimed) {
+        if (*link == t) {
+            *link = t->nextTimed;
+            break;
+        }
+    }
+    t->timed = false;
+}
+
+// Queue the tasks whose timers are due, rearming the periodic ones.  A periodic task that has fallen
+// more than a period behind skips the runs that it missed rather than running them back to back.
+static void timersExpire(long unsigned int nowMs) {
+    while (timers != NULL && clockReached(nowMs, timers->dueMs)) {
+        task *t = timers;
+        timers = t->nextTimed;
+        t->timed = false;
+        uint32_t lateMs = (uint32_t) (nowMs - t->dueMs);
+        if (lateMs > schedMaxLateMs)
+            schedMaxLateMs = lateMs;
+        if (t->periodMs != 0) {
+            t->dueMs += (lateMs < t->periodMs ? t->periodMs : (lateMs / t->periodMs + 1) * t->periodMs);
+            timerInsert(t);
+        }
+        taskPost(t);
+    }
+}
+
+// Run the tasks that are due and those that have been posted, until none are left, returning how many
+// were run.  Tasks posted or falling due while these run are run too.
+size_t schedDispatch(void) {
+    size_t dispatched = 0;
+    timersExpire(millis());
+    while (true) {
+        unsigned short state = schedDisableInterrupts();
+        task *t = runHead;
+        if (t != NULL) {
+            runHead = t->next;
+            if (runHead == NULL)
+                runTail = NULL;
+            t->posted = false;
+        }
+        schedRestoreInterrupts(state);
+        if (t == NULL) {
+            timersExpire(millis());
+            if (runHead == NULL)
+                break;
+            continue;
+        }
+        t->fn(t->context);
+        dispatched++;
+    }
+    schedDispatched += dispatched;
+    return dispatched;
+}
+
+// Run tasks forever, sleeping whenever there are none to run
+void schedRun(void) {
+    while (true) {
+        schedDispatch();
+        unsigned short state = schedDisableInterrupts();
+        if (runHead == NULL)
+            schedSleep(timers != NULL, timers != NULL ? timers->dueMs : 0);
+        schedRestoreInterrupts(state);
+    }
+}
+
+// Get the number of tasks run since boot, and the furthest behind that a timer has been when it was
+// found to be due
+void schedStats(uint32_t *dispatched, uint32_t *maxLateMs) {
+    if (dispatched != NULL)
+        *dispatched = schedDispatched;
+    if (maxLateMs != NULL)
+        *maxLateMs = schedMaxLateMs;
+}
@@ -0,0 +1,50 @@
+#ifndef SCHED_H
+#define SCHED_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+//
+// A small run-to-completion scheduler.  Tasks are run one at a time, each returning before the next
+// is run, when they're posted (which ISRs may do, to hand work to the main context) or when their
+// timers expire.  When there is nothing to run, the CPU sleeps until an ISR wakes it or until the
+// next timer is due.
+//
+// An ISR that posts a task must also wake the CPU on exit, as the ISRs in main.c do with
+// __bic_SR_register_on_exit(LPM3_bits).  Timers are only set and cancelled by tasks, not by ISRs.
+//
+
+typedef void (*taskFn)(void *context);
+
+typedef struct task {
+    taskFn fn;
+    void *context;
+    long unsigned int dueMs;
+    uint32_t periodMs;
+    bool timed;
+    volatile bool posted;
+    struct task *next;
+    struct task *nextTimed;
+} task;
+
+// Tasks
+void taskInit(task *t, taskFn fn, void *context);
+void taskPost(task *t);
+void taskAfter(task *t, uint32_t delayMs);
+void taskEvery(task *t, uint32_t periodMs, uint32_t firstDelayMs);
+void taskCancel(task *t);
+
+// Scheduling
+size_t schedDispatch(void);
+void schedRun(void);
+void schedStats(uint32_t *dispatched, uint32_t *maxLateMs);
+
+// Provided by the platform.  Sleeping is done with interrupts disabled, returning with them disabled
+// once woken by an ISR or once the deadline, if any, has been reached.
+long unsigned int millis(void);
+unsigned short schedDisableInterrupts(void);
+void schedRestoreInterrupts(unsigned short state);
+void schedSleep(bool timed, long unsigned int deadlineMs);
+
+#endif // SCHED_H
@@ -0,0 +1,426 @@
+// Copyright 2019 Blues Inc.  All rights reserved.
+// Use of this source code is governed by licenses granted by the
+// copyright holder including that found in the LICENSE file.
+
+// Benchmark of note-c's JSON on the host, comparing each way of parsing and printing that it offers
+// with the one it stands in for: the items of the layout that it's built with, and the heap they
+// take; parsing into an arena against an allocation per item; parsing only the wanted fields of a
+// response against parsing all of it; looking up the keys of large objects, which are indexed when
+// it's built with N_CJSON_INDEX_THRESHOLD; parsing and printing integers; printing into a buffer
+// sized by JPrintLength against one that grows; and rendering and parsing a struct against a tree
+// of items; and the heap held by a tree parsed from a stream.  Each reports the host's time per call, the allocations made, and the peak heap.  The
+// Makefile builds it in each of the layouts and number formats that note-c can be built with, so
+// that all of them are exercised.  Exits nonzero if a way of parsing or printing gets a different
+// result from the one it stands in for, or doesn't save the allocations that it exists to save.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "note.h"
+#include "heap_sim.h"
+
+#define ITERATIONS      20000
+
+// A response like that of card.status, and one like that of card.version
+static const char statusText[] = "{\"status\":\"{normal}\",\"usb\":true,\"storage\":8,\"time\":1599769214,"
+    "\"connected\":true,\"cell\":true,\"sync\":true,\"inbound\":60,\"outbound\":360,"
+    "\"wifi\":{\"ssid\":\"blues\",\"rssi\":-53,\"bars\":3},\"gps\":{\"mode\":\"periodic\",\"secs\":3600},"
+    "\"body\":{\"org\":\"Blues Wireless\",\"product\":\"Notecard\",\"tags\":[\"a\",\"b\",\"c\",\"d\"]}}";
+static const char versionText[] = "{\"body\":{\"org\":\"Blues Wireless\",\"product\":\"Notecard\",\"version\":"
+    "\"notecard-6.1.1\",\"ver_major\":6,\"ver_minor\":1,\"ver_patch\":1,\"ver_build\":16256,"
+    "\"built\":\"Sep 20 2023 10:44:46\",\"target\":\"r5\"},\"version\":\"notecard-6.1.1.16256$20230920104446\","
+    "\"device\":\"dev:864475044204278\",\"name\":\"Blues Wireless Notecard\",\"sku\":\"NOTE-NBGL-500\","
+    "\"board\":\"1.11\",\"api\":6,\"cell\":true,\"gps\":true}";
+
+// A note.add body of mostly integers
+static const char numbersText[] = "{\"time\":1599769214,\"count\":42,\"seconds\":-3600,\"level\":100,"
+    "\"voltage\":3.5,\"rssi\":-53,\"bytes\":1048576}";
+
+// What's being measured, which each measurement reads
+static J *tree;
+static J *lookupObject;
+static int lookupKeys;
+static char lookupNames[100][16];
+static bool ok = true;
+
+// Report what a call costs, once to count its allocations and heap and then many times to time it,
+// returning the allocations that it made
+static uint32_t measure(const char *label, bool (*call)(void)) {
+    size_t heldBefore = heapHeld();
+    heapResetPeak();
+    uint32_t allocsBefore = heapAllocs();
+    if (!call()) {
+        printf("%s: wrong result\n", label);
+        ok = false;
+    }
+    uint32_t allocs = heapAllocs() - allocsBefore;
+    size_t peak = heapPeak() - heldBefore;
+    clock_t begin = clock();
+    for (int i = 0; i < ITERATIONS; i++)
+        call();
+    double ns = (double) (clock() - begin) / CLOCKS_PER_SEC * 1e9 / ITERATIONS;
+    printf("    %-34s %7.0f ns %4lu allocs %5zu B peak\n", label, ns, (unsigned long) allocs, peak);
+    return allocs;
+}
+
+// The items in a tree
+static int items(const J *item) {
+    int n = 0;
+    for (; item != NULL; item = item->next)
+        n += 1 + items(item->child);
+    return n;
+}
+
+// Whether two trees print the same
+static bool samePrint(J *a, J *b) {
+    char *aText = JPrintUnformatted(a);
+    char *bText = JPrintUnformatted(b);
+    bool same = (aText != NULL && bText != NULL && strcmp(aText, bText) == 0);
+    JFree(aText);
+    JFree(bText);
+    return same;
+}
+
+// The size of an item, and the heap per item of a parsed response
+static void benchItems(void) {
+    size_t heldBefore = heapHeld();
+    J *j = JParse(statusText);
+    int n = items(j);
+    printf("items: %zu bytes each, %.1f bytes of heap per item of a %zu byte response with %d items\n",
+           sizeof(J), (double) (heapHeld() - heldBefore) / n, strlen(statusText), n);
+    JDelete(j);
+}
+
+// Parsing a response into an arena, against an allocation per item
+static bool parseTree(void) {
+    J *j = JParse(statusText);
+    bool parsed = (j != NULL && JGetInt(j, "time") == 1599769214);
+    JDelete(j);
+    return parsed;
+}
+
+static bool parseArena(void) {
+    J *j = JParseArena(statusText);
+    bool parsed = (j != NULL && JGetInt(j, "time") == 1599769214);
+    JDelete(j);
+    return parsed;
+}
+
+static void benchArena(void) {
+    printf("arena, %zu byte response:\n", strlen(statusText));
+    uint32_t treeAllocs = measure("JParse", parseTree);
+    uint32_t arenaAllocs = measure("JParseArena", parseArena);
+    J *j = JParse(statusText);
+    J *arena = JParseArena(statusText);
+    if (!samePrint(j, arena) || arenaAllocs >= treeAllocs)
+        ok = false;
+    JDelete(j);
+    JDelete(arena);
+}
+
+// The heap held by a tree parsed from a stream, fed to the parser as it would arrive, against one
+// parsed whole, for a string just longer than the parser's token buffer once doubled to hold it
+static void benchStream(void) {
+    static char text[1100];
+    strcpy(text, "{\"text\":\"");
+    memset(&text[9], 'x', 1030);
+    strcpy(&text[9 + 1030], "\"}");
+    size_t heldBefore = heapHeld();
+    J *whole = JParse(text);
+    size_t wholeBytes = heapHeld() - heldBefore;
+    heldBefore = heapHeld();
+    JStream *stream = JParseStreamBegin();
+    for (size_t i = 0, len = strlen(text); stream != NULL && i < len; i += NOTE_I2C_MAX_DEFAULT)
+        JParseStreamFeed(stream, &text[i], (len - i < NOTE_I2C_MAX_DEFAULT ? len - i : NOTE_I2C_MAX_DEFAULT));
+    J *streamed = JParseStreamEnd(stream);
+    size_t streamedBytes = heapHeld() - heldBefore;
+    printf("stream, a %zu byte string: tree of %zu bytes parsed whole, %zu bytes streamed\n", strlen(text) - 11,
+           wholeBytes, streamedBytes);
+    if (streamed == NULL || !samePrint(whole, streamed) || streamedBytes > wholeBytes)
+        ok = false;
+    JDelete(whole);
+    JDelete(streamed);
+}
+
+// Parsing only the fields of a response that are wanted, against parsing all of it
+static const char * const versionFields[] = {"version", "body.ver_major", "body.ver_minor", NULL};
+
+static bool versionMatches(J *j) {
+    return (j != NULL && strcmp(JGetString(j, "version"), "notecard-6.1.1.16256$20230920104446") == 0
+            && JGetInt(JGetObject(j, "body"), "ver_major") == 6 && JGetInt(JGetObject(j, "body"), "ver_minor") == 1);
+}
+
+static bool parseWhole(void) {
+    J *j = JParse(versionText);
+    bool matches = versionMatches(j);
+    JDelete(j);
+    return matches;
+}
+
+static bool parseFields(void) {
+    J *j = JParseFields(versionText, versionFields);
+    bool matches = versionMatches(j);
+    JDelete(j);
+    return matches;
+}
+
+static void benchFields(void) {
+    printf("fields, 3 of a %zu byte response:\n", strlen(versionText));
+    uint32_t wholeAllocs = measure("JParse", parseWhole);
+    uint32_t fieldsAllocs = measure("JParseFields", parseFields);
+    if (fieldsAllocs >= wholeAllocs)
+        ok = false;
+}
+
+// Looking up every key of an object, whose value is its index
+static bool lookupAll(void) {
+    bool found = true;
+    for (int i = 0; i < lookupKeys; i++)
+        found = (JGetInt(lookupObject, lookupNames[i]) == i) && found;
+    return found;
+}
+
+static void benchLookup(void) {
+#ifdef N_CJSON_INDEX_THRESHOLD
+    printf("lookup, indexed past %d children, per object of:\n", N_CJSON_INDEX_THRESHOLD);
+#else
+    printf("lookup, by scanning, per object of:\n");
+#endif
+    static const int keys[] = {5, 20, 100};
+    for (int k = 0; k < 100; k++)
+        snprintf(lookupNames[k], sizeof(lookupNames[k]), "key%d", k);
+    for (size_t i = 0; i < sizeof(keys)/sizeof(keys[0]); i++) {
+        lookupObject = JCreateObject();
+        lookupKeys = keys[i];
+        for (int k = 0; k < lookupKeys; k++)
+            JAddIntToObject(lookupObject, lookupNames[k], k);
+        char label[40];
+        snprintf(label, sizeof(label), "%d keys, all of them", lookupKeys);
+        size_t heldBefore = heapHeld();
+        measure(label, lookupAll);
+        printf("    %-34s %7zu B\n", "index", heapHeld() - heldBefore);
+        JDelete(lookupObject);
+    }
+}
+
+// Parsing and printing integers
+static bool parseNumbers(void) {
+    J *j = JParse(numbersText);
+    bool parsed = (j != NULL && JGetInt(j, "bytes") == 1048576);
+    JDelete(j);
+    return parsed;
+}
+
+static bool printNumbers(void) {
+    char *text = JPrintUnformatted(tree);
+    bool printed = (text != NULL);
+    JFree(text);
+    return printed;
+}
+
+static void benchNumbers(void) {
+    printf("numbers, a %zu byte body of mostly integers:\n", strlen(numbersText));
+    measure("JParse", parseNumbers);
+    tree = JParse(numbersText);
+    measure("JPrintUnformatted", printNumbers);
+
+    // An epoch time survives the round trip wherever a JNUMBER or valueint can hold it
+    char *text = JPrintUnformatted(tree);
+#if !defined(NOTE_FIXED) && !(defined(N_CJSON_COMPACT) && defined(NOTE_FLOAT))
+    if (JGetInt(tree, "time") != 1599769214 || text == NULL || strstr(text, "\"time\":1599769214,") == NULL)
+        ok = false;
+#endif
+    JFree(text);
+    JDelete(tree);
+
+    // Constants mean the same number whether or not numbers are fixed point
+    tree = JCreateObject();
+    JAddNumberToObject(tree, "whole", JNUMBER_FROM_INT(12));
+    JAddNumberToObject(tree, "milli", JNUMBER_FROM_MILLI(3300));
+    text = JPrintUnformatted(tree);
+    const char *milli = (text == NULL ? NULL : strstr(text, "\"milli\":"));
+    if (text == NULL || strncmp(text, "{\"whole\":12,", 11) != 0 || milli == NULL || fabs(strtod(milli + 8, NULL) - 3.3) > 1e-6)
+        ok = false;
+    JFree(text);
+    JDelete(tree);
+}
+
+// Printing into a buffer sized by JPrintLength, against one that grows as it's printed into and is
+// then copied into one of the right size, as JPrint did before JPrintLength
+typedef struct {
+    char *buffer;
+    size_t len;
+    size_t size;
+} growing;
+
+static Jbool grow(void *context, const char *data, size_t length) {
+    growing *g = (growing *) context;
+    while (g->len + length + 1 > g->size) {
+        char *bigger = (char *) JMalloc(g->size * 2);
+        if (bigger == NULL)
+            return false;
+        memcpy(bigger, g->buffer, g->len);
+        JFree(g->buffer);
+        g->buffer = bigger;
+        g->size *= 2;
+    }
+    memcpy(&g->buffer[g->len], data, length);
+    g->len += length;
+    return true;
+}
+
+static char *printGrowing(J *item) {
+    char window[N_CJSON_PRINT_WINDOW_MIN * 4];
+    growing g = {(char *) JMalloc(128), 0, 128};
+    if (g.buffer == NULL)
+        return NULL;
+    if (!JPrintToSink(item, window, sizeof(window), false, grow, &g)) {
+        JFree(g.buffer);
+        return NULL;
+    }
+    char *text = (char *) JMalloc(g.len + 1);
+    if (text != NULL) {
+        memcpy(text, g.buffer, g.len);
+        text[g.len] = '\0';
+    }
+    JFree(g.buffer);
+    return text;
+}
+
+static bool printMeasured(void) {
+    char *text = JPrintUnformatted(tree);
+    bool printed = (text != NULL);
+    JFree(text);
+    return printed;
+}
+
+static bool printGrown(void) {
+    char *text = printGrowing(tree);
+    bool printed = (text != NULL);
+    JFree(text);
+    return printed;
+}
+
+static void benchPrint(void) {
+    tree = NoteNewRequest("note.add");
+    JAddStringToObject(tree, "file", "bench.qo");
+    J *body = JParse(statusText);
+    JAddItemToObject(tree, "body", body);
+    JAddItemToObject(body, "more", JParse(versionText));
+    size_t length = JPrintLength(tree, false);
+    printf("print, a %zu byte note.add:\n", length);
+    uint32_t measuredAllocs = measure("JPrintUnformatted, sized to fit", printMeasured);
+    measure("a growing buffer, then a copy", printGrown);
+    char *measured = JPrintUnformatted(tree);
+    char *grown = printGrowing(tree);
+    if (measuredAllocs != 1 || measured == NULL || grown == NULL || strcmp(measured, grown) != 0 || strlen(measured) != length)
+        ok = false;
+    JFree(measured);
+    JFree(grown);
+    JDelete(tree);
+}
+
+// Rendering and parsing a struct, against a tree of items
+static const TrackPoint track = {
+    .mtime = 1600000000.125, .lat = 42.5, .lon = -71.25, .time = 1600000000, .hdop = 1.5,
+    .journeyTime = 3600, .journeyCount = 12, .trackType = "no-sat", .motionCount = 7, .seconds = -60,
+    .distance = 1234.5, .bearing = 270.25, .velocity = 2.75, .temperature = 21.5, .humidity = 45.25,
+    .pressure = 101325.5, .voltage = 3.75, .usb = true, .charging = false,
+};
+
+static J *trackTree(const TrackPoint *t) {
+    J *j = JCreateObject();
+    if (j == NULL)
+        return NULL;
+    JAddNumberToObject(j, TRACKPOINT_MEASUREMENT_TIME, t->mtime);
+    JAddNumberToObject(j, TRACKPOINT_LAT, t->lat);
+    JAddNumberToObject(j, TRACKPOINT_LON, t->lon);
+    JAddIntToObject(j, TRACKPOINT_TIME, t->time);
+    JAddNumberToObject(j, TRACKPOINT_HDOP, t->hdop);
+    JAddIntToObject(j, TRACKPOINT_JOURNEY_TIME, t->journeyTime);
+    JAddIntToObject(j, TRACKPOINT_JOURNEY_COUNT, t->journeyCount);
+    JAddStringToObject(j, TRACKPOINT_TYPE, t->trackType);
+    JAddIntToObject(j, TRACKPOINT_MOTION_COUNT, t->motionCount);
+    JAddIntToObject(j, TRACKPOINT_SECONDS, t->seconds);
+    JAddNumberToObject(j, TRACKPOINT_DISTANCE, t->distance);
+    JAddNumberToObject(j, TRACKPOINT_BEARING, t->bearing);
+    JAddNumberToObject(j, TRACKPOINT_VELOCITY, t->velocity);
+    JAddNumberToObject(j, TRACKPOINT_TEMPERATURE, t->temperature);
+    JAddNumberToObject(j, TRACKPOINT_HUMIDITY, t->humidity);
+    JAddNumberToObject(j, TRACKPOINT_PRESSURE, t->pressure);
+    JAddNumberToObject(j, TRACKPOINT_VOLTAGE, t->voltage);
+    JAddBoolToObject(j, TRACKPOINT_USB, t->usb);
+    JAddBoolToObject(j, TRACKPOINT_CHARGING, t->charging);
+    return j;
+}
+
+static char *trackText;
+
+static bool printTree(void) {
+    J *j = trackTree(&track);
+    char *text = JPrintUnformatted(j);
+    bool printed = (text != NULL);
+    JFree(text);
+    JDelete(j);
+    return printed;
+}
+
+static bool printStruct(void) {
+    char *text = JPrintStruct(&track, NoteTrackPointFields);
+    bool printed = (text != NULL);
+    JFree(text);
+    return printed;
+}
+
+static bool parseTrackTree(void) {
+    J *j = JParse(trackText);
+    TrackPoint t = {0};
+    if (j != NULL) {
+        t.lat = (double) JGetNumber(j, TRACKPOINT_LAT);
+        t.lon = (double) JGetNumber(j, TRACKPOINT_LON);
+        t.time = (uint32_t) JGetInt(j, TRACKPOINT_TIME);
+        t.motionCount = (uint32_t) JGetInt(j, TRACKPOINT_MOTION_COUNT);
+        strlcpy(t.trackType, JGetString(j, TRACKPOINT_TYPE), sizeof(t.trackType));
+    }
+    JDelete(j);
+    return (t.time == track.time && t.motionCount == track.motionCount && strcmp(t.trackType, track.trackType) == 0);
+}
+
+static bool parseStruct(void) {
+    TrackPoint t = {0};
+    return (JParseStruct(trackText, NULL, &t, NoteTrackPointFields) && memcmp(&t, &track, sizeof(t)) == 0);
+}
+
+static void benchStruct(void) {
+    trackText = JPrintStruct(&track, NoteTrackPointFields);
+    printf("struct, a %zu byte TrackPoint:\n", trackText == NULL ? 0 : strlen(trackText));
+    measure("print a tree of items", printTree);
+    uint32_t printAllocs = measure("JPrintStruct", printStruct);
+    measure("parse into a tree of items", parseTrackTree);
+    uint32_t parseAllocs = measure("JParseStruct", parseStruct);
+    if (trackText == NULL || printAllocs != 1 || parseAllocs != 0)
+        ok = false;
+    JFree(trackText);
+}
+
+int main(void) {
+    NoteSetFn(heapMalloc, heapFree, NULL, NULL);
+    NoteSetFnRealloc(heapRealloc);
+
+    benchItems();
+    benchArena();
+    benchFields();
+    benchLookup();
+    benchNumbers();
+    benchPrint();
+    benchStruct();
+    benchStream();
+    if (heapHeld() != 0) {
+        printf("%zu bytes of heap left held\n", heapHeld());
+        ok = false;
+    }
+
+    return (ok ? 0 : 1);
+}
@@ -0,0 +1,128 @@
+// Copyright 2019 Blues Inc.  All rights reserved.
+// Use of this source code is governed by licenses granted by the
+// copyright holder including that found in the LICENSE file.
+
+// Benchmark of main.c's I2C path, built for the host against the mock driverlib in test/mock, which
+// simulates the eUSCI_B with a Notecard on the bus.  For note.add requests of several sizes, it
+// counts what each transaction costs: the allocations made by main.c itself, which frames its
+// transfers in a static buffer, and by note-c; the eUSCI_B interrupts taken; the bytes on the wire;
+// the time that the transaction takes, including note-c's pacing; and the host's own time.  Exits
+// nonzero if a request doesn't reach the Notecard intact or main.c allocates anything.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <driverlib.h>
+#include "main.h"
+#include "note.h"
+#include "card_sim.h"
+
+#define TRANSACTIONS    1000
+
+// main.c's hardware setup
+void init_GPIO(void);
+void init_CS(void);
+
+// Allocations made by main.c, which is built with its malloc() and free() renamed to these
+static uint32_t firmwareAllocs = 0;
+
+void *firmwareMalloc(size_t size) {
+    firmwareAllocs++;
+    return malloc(size);
+}
+
+void firmwareFree(void *p) {
+    free(p);
+}
+
+// Allocations made by note-c
+static uint32_t noteAllocs = 0;
+
+static void *noteMalloc(size_t size) {
+    noteAllocs++;
+    return malloc(size);
+}
+
+static void *noteRealloc(void *p, size_t size) {
+    noteAllocs++;
+    return realloc(p, size);
+}
+
+// main.c's millis(), whose long is wider here than note-c's milliseconds
+static uint32_t noteMillis(void) {
+    return (uint32_t) millis();
+}
+
+// main.c calls the example's setup() from its main(), which isn't run here
+void setup(void) {
+}
+
+// A request to add a note whose body has a string of the specified length
+static J *noteAdd(size_t len) {
+    static char text[4096];
+    J *req = NoteNewRequest("note.add");
+    if (req == NULL)
+        return NULL;
+    JAddStringToObject(req, "file", "bench.qo");
+    if (len > 0) {
+        memset(text, 'x', len);
+        text[len] = '\0';
+        J *body = JCreateObject();
+        JAddStringToObject(body, "text", text);
+        JAddItemToObject(req, "body", body);
+    }
+    return req;
+}
+
+// The length of a request as the Notecard should receive it, without its newline
+static size_t requestLength(J *req) {
+    char *json = JPrintUnformatted(req);
+    size_t len = (json == NULL ? 0 : strlen(json));
+    JFree(json);
+    JDelete(req);
+    return len;
+}
+
+int main(void) {
+    init_CS();
+    init_GPIO();
+    NoteSetFn(noteMalloc, free, delay, noteMillis);
+    NoteSetFnRealloc(noteRealloc);
+    NoteSetFnI2C(NOTE_I2C_ADDR_DEFAULT, NOTE_I2C_MAX_DEFAULT, noteI2CReset, noteI2CTransmit, noteI2CReceive);
+    cardReset("{\"total\":1}");
+    int failed = 0;
+
+    printf("%d transactions at %lu Hz, %d bytes per chunk:\n", TRANSACTIONS,
+           (unsigned long) NOTECARD_I2C_FREQUENCY, NOTE_I2C_MAX_DEFAULT);
+    const size_t lengths[] = {0, 64, 256, 1024};
+    for (size_t i = 0; i < sizeof(lengths)/sizeof(lengths[0]); i++) {
+
+        // Once to settle, and then measured
+        NoteRequest(noteAdd(lengths[i]));
+        cardReset("{\"total\":1}");
+        uint32_t firmwareAllocsBefore = firmwareAllocs;
+        uint32_t noteAllocsBefore = noteAllocs;
+        uint32_t interrupts = mockI2CInterrupts();
+        uint32_t bytes = mockI2CBytes();
+        uint64_t ns = mockNowNs();
+        int ok = 0;
+        clock_t begin = clock();
+        for (int t = 0; t < TRANSACTIONS; t++)
+            ok += NoteRequest(noteAdd(lengths[i]));
+        double hostUs = (double) (clock() - begin) / CLOCKS_PER_SEC * 1e6 / TRANSACTIONS;
+        printf("body text %4zu: main.c %.1f allocs, note-c %.1f allocs, %.1f interrupts, "
+               "%.1f bytes on the wire, %.2f ms elapsed, %.1f us on the host\n", lengths[i],
+               (double) (firmwareAllocs - firmwareAllocsBefore) / TRANSACTIONS,
+               (double) (noteAllocs - noteAllocsBefore) / TRANSACTIONS,
+               (double) (mockI2CInterrupts() - interrupts) / TRANSACTIONS,
+               (double) (mockI2CBytes() - bytes) / TRANSACTIONS,
+               (double) (mockNowNs() - ns) / 1e6 / TRANSACTIONS, hostUs);
+        if (ok != TRANSACTIONS || cardRequests() != TRANSACTIONS || cardLongestRequest() != requestLength(noteAdd(lengths[i])))
+            failed = 1;
+    }
+    if (firmwareAllocs != 0 || mockI2CErrors() != 0)
+        failed = 1;
+
+    return failed;
+}
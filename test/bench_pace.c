@@ -0,0 +1,207 @@
+// Copyright 2019 Blues Inc.  All rights reserved.
+// Use of this source code is governed by licenses granted by the
+// copyright holder including that found in the LICENSE file.
+
+// Benchmark of the delays that note-c learns between the segments and chunks of a request, against
+// the fixed CARD_REQUEST_*_DELAY_MS delays that they replaced, over SERIAL and over I2C.  The
+// simulated Notecard of card_sim.c is given a bounded receive buffer that it drains at a fixed rate,
+// dropping bytes or refusing I2C writes when it's overrun, and the time that bytes take on the wire
+// and that note-c delays is simulated.  Each run sends note.add requests whose bodies have 256 B,
+// 1 KB and 4 KB of text in turn, to a card that keeps up with the wire and to one that's busy, and
+// reports the bytes of request per second that reached the card intact, the requests that failed,
+// and the bytes dropped.  The learned delays start from the fixed ones, and how they converge is
+// shown by the delays after a number of transactions.  Exits nonzero if the learned delays don't
+// deliver at least the throughput of the fixed ones, or don't reach their least on a card that
+// keeps up.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "note.h"
+#include "n_lib.h"
+#include "card_sim.h"
+
+#define TRANSACTIONS    300
+
+// The wire, at 10 bits a byte over SERIAL and 9 over I2C
+#define SERIAL_BAUD     115200
+#define I2C_FREQUENCY   400000
+#define SERIAL_BYTE_US  (10 * 1000000 / SERIAL_BAUD)
+#define I2C_BYTE_US     (9 * 1000000 / I2C_FREQUENCY)
+
+// The cards, with the receive buffer of a Notecard, that drain it faster than SERIAL can fill it, or
+// more slowly than either SERIAL or I2C can
+typedef struct {
+    const char *name;
+    size_t bufferBytes;
+    uint32_t drainBytesPerSec;
+} card;
+static const card cards[] = {
+    {"keeps up", 1024, 16000},
+    {"busy", 1024, 2000},
+};
+
+// The transactions after which the learned delays are shown
+static const int shownAfter[] = {10, 30, 100, 300};
+
+// Simulated time, which passes on the wire and while note-c delays
+static uint64_t nowUs = 0;
+
+static void pass(uint32_t us) {
+    nowUs += us;
+    cardPass(us);
+}
+
+static void hostDelay(uint32_t ms) {
+    pass(ms * 1000);
+}
+
+static uint32_t hostMillis(void) {
+    return (uint32_t) (nowUs / 1000);
+}
+
+// SERIAL, a byte at a time on the wire to the simulated Notecard
+static bool serialReset(void) {
+    return true;
+}
+
+static void serialTransmit(uint8_t *data, size_t len, bool flush) {
+    (void) flush;
+    for (size_t i = 0; i < len; i++) {
+        pass(SERIAL_BYTE_US);
+        cardReceive(&data[i], 1);
+    }
+}
+
+static bool serialAvailable(void) {
+    return cardAvailable() > 0;
+}
+
+static char serialReceive(void) {
+    uint8_t data = 0;
+    pass(SERIAL_BYTE_US);
+    cardSend(&data, 1);
+    return (char) data;
+}
+
+// I2C, in the frames of the Notecard's I2C protocol, each after its address
+static bool i2cReset(uint16_t address) {
+    (void) address;
+    return true;
+}
+
+static const char *i2cTransmit(uint16_t address, uint8_t *data, uint16_t len) {
+    (void) address;
+    uint8_t frame[NOTE_I2C_MAX_MAX + 1];
+    frame[0] = (uint8_t) len;
+    memcpy(&frame[1], data, len);
+    pass((len + 2) * I2C_BYTE_US);
+    return (cardI2CWrite(frame, len + 1) ? NULL : "i2c: frame not acknowledged");
+}
+
+static const char *i2cReceive(uint16_t address, uint8_t *data, uint16_t len, uint32_t *available) {
+    (void) address;
+    uint8_t frame[NOTE_I2C_MAX_MAX + 2] = {0, (uint8_t) len};
+    pass((2 + 1) * I2C_BYTE_US);
+    if (!cardI2CWrite(frame, 2) || cardI2CRead(frame, sizeof(frame)) != len + 2u)
+        return "i2c: incorrect amount of data";
+    pass((len + 3) * I2C_BYTE_US);
+    memcpy(data, &frame[2], len);
+    *available = frame[0];
+    return NULL;
+}
+
+// A request to add a note whose body has a string of the specified length
+static J *noteAdd(size_t len) {
+    static char text[4096 + 1];
+    J *req = NoteNewRequest("note.add");
+    if (req == NULL)
+        return NULL;
+    JAddStringToObject(req, "file", "bench.qo");
+    memset(text, 'x', len);
+    text[len] = '\0';
+    J *body = JCreateObject();
+    JAddStringToObject(body, "text", text);
+    JAddItemToObject(req, "body", body);
+    return req;
+}
+
+// The length of a request as the Notecard should receive it, without its newline
+static size_t requestLength(J *req) {
+    char *json = JPrintUnformatted(req);
+    size_t len = (json == NULL ? 0 : strlen(json));
+    JFree(json);
+    return len;
+}
+
+// The delays currently used by the interface
+static void showPacing(bool i2c, int after) {
+    uint32_t i2cChunkMs, i2cSegmentMs, serialSegmentMs;
+    NoteGetPacing(&i2cChunkMs, &i2cSegmentMs, &serialSegmentMs);
+    if (i2c)
+        printf(" %d:%lu/%lu", after, (unsigned long) i2cChunkMs, (unsigned long) i2cSegmentMs);
+    else
+        printf(" %d:%lu", after, (unsigned long) serialSegmentMs);
+}
+
+// Send note.add requests to a card, with the fixed delays or with those learned from their start,
+// returning the bytes of request per second that reached it intact
+static double bench(const char *interface, bool i2c, const card *c, bool learned) {
+    static const size_t lengths[] = {256, 1024, 4096};
+    cardReset("{\"total\":1}");
+    cardLimitBuffer(c->bufferBytes, c->drainBytesPerSec);
+    NoteSetPacing(CARD_REQUEST_I2C_CHUNK_DELAY_MS, CARD_REQUEST_I2C_SEGMENT_DELAY_MS, CARD_REQUEST_SERIAL_SEGMENT_DELAY_MS);
+    NoteReset();
+    uint64_t beginUs = nowUs;
+    uint64_t delivered = 0;
+    int failed = 0;
+    size_t shown = 0;
+    printf("%s, %s card, %s delays:", interface, c->name, learned ? "learned" : "fixed");
+    for (int t = 0; t < TRANSACTIONS; t++) {
+        if (!learned)
+            NoteSetPacing(CARD_REQUEST_I2C_CHUNK_DELAY_MS, CARD_REQUEST_I2C_SEGMENT_DELAY_MS, CARD_REQUEST_SERIAL_SEGMENT_DELAY_MS);
+        J *req = noteAdd(lengths[t % (sizeof(lengths)/sizeof(lengths[0]))]);
+        size_t len = requestLength(req);
+        if (NoteRequest(req))
+            delivered += len;
+        else
+            failed++;
+        if (learned && shown < sizeof(shownAfter)/sizeof(shownAfter[0]) && t + 1 == shownAfter[shown])
+            showPacing(i2c, shownAfter[shown++]);
+    }
+    double bytesPerSec = (double) delivered * 1e6 / (double) (nowUs - beginUs);
+    printf("\n    %.0f bytes/s, %d of %d requests failed, %lu bytes dropped or writes refused\n",
+           bytesPerSec, failed, TRANSACTIONS, (unsigned long) cardOverruns());
+    return bytesPerSec;
+}
+
+// Compare the learned delays with the fixed ones on each card, returning false if they do worse or
+// don't reach their least on a card that keeps up
+static bool compare(const char *interface, bool i2c) {
+    bool ok = true;
+    for (size_t i = 0; i < sizeof(cards)/sizeof(cards[0]); i++) {
+        double fixedBytesPerSec = bench(interface, i2c, &cards[i], false);
+        double learnedBytesPerSec = bench(interface, i2c, &cards[i], true);
+        if (learnedBytesPerSec < fixedBytesPerSec)
+            ok = false;
+        uint32_t i2cChunkMs, i2cSegmentMs, serialSegmentMs;
+        NoteGetPacing(&i2cChunkMs, &i2cSegmentMs, &serialSegmentMs);
+        bool least = (i2c ? i2cChunkMs == CARD_REQUEST_I2C_CHUNK_DELAY_MIN_MS && i2cSegmentMs == CARD_REQUEST_I2C_SEGMENT_DELAY_MIN_MS
+                      : serialSegmentMs == CARD_REQUEST_SERIAL_SEGMENT_DELAY_MIN_MS);
+        if (i == 0 && !least)
+            ok = false;
+    }
+    return ok;
+}
+
+int main(void) {
+    NoteSetFn(malloc, free, hostDelay, hostMillis);
+    bool ok = true;
+
+    NoteSetFnSerial(serialReset, serialTransmit, serialAvailable, serialReceive);
+    ok = compare("serial", false) && ok;
+    NoteSetFnI2C(NOTE_I2C_ADDR_DEFAULT, NOTE_I2C_MAX_DEFAULT, i2cReset, i2cTransmit, i2cReceive);
+    ok = compare("i2c", true) && ok;
+
+    return (ok ? 0 : 1);
+}
@@ -0,0 +1,108 @@
+// Copyright 2019 Blues Inc.  All rights reserved.
+// Use of this source code is governed by licenses granted by the
+// copyright holder including that found in the LICENSE file.
+
+// Benchmark of the scheduler in sched.c on a simulated clock: how long a task posted by an ISR waits
+// to be run, how late timers run, and how much of the time the CPU sleeps, over a simulated hour of
+// a workload like that of example.c.  The host's own cost of posting and dispatching is measured too.
+
+#include <stdio.h>
+#include <time.h>
+#include "sched_sim.h"
+
+#define SIM_HOUR_MS    (60UL * 60 * 1000)
+
+// An ISR, such as an ADC's, that posts a task every few milliseconds
+#define ISR_PERIOD_MS   7
+static task isrTask;
+static uint64_t isrPostedMs = 0;
+static uint64_t isrLatencySumMs = 0;
+static uint64_t isrLatencyMaxMs = 0;
+static uint32_t isrRuns = 0;
+
+static void isrPost(void) {
+    isrPostedMs = simNowMs();
+    taskPost(&isrTask);
+}
+
+static void isrTaskFn(void *context) {
+    (void) context;
+    uint64_t latencyMs = simNowMs() - isrPostedMs;
+    isrLatencySumMs += latencyMs;
+    if (latencyMs > isrLatencyMaxMs)
+        isrLatencyMaxMs = latencyMs;
+    isrRuns++;
+}
+
+// A sample taken periodically, which begins a transaction and polls for its reply a little later
+// as example.c does, each step keeping the CPU busy for a while
+#define SAMPLE_PERIOD_MS    15000
+#define SAMPLE_POLL_MS      25
+static task sampleTask;
+static task pollTask;
+static uint32_t samples = 0;
+
+static void sampleTaskFn(void *context) {
+    (void) context;
+    samples++;
+    simBusy(2);
+    taskAfter(&pollTask, SAMPLE_POLL_MS);
+}
+
+static void pollTaskFn(void *context) {
+    (void) context;
+    simBusy(3);
+}
+
+int main(void) {
+
+    // Simulate an hour
+    simReset(0);
+    taskInit(&isrTask, isrTaskFn, NULL);
+    taskInit(&sampleTask, sampleTaskFn, NULL);
+    taskInit(&pollTask, pollTaskFn, NULL);
+    simIsrEvery(isrPost, ISR_PERIOD_MS);
+    taskEvery(&sampleTask, SAMPLE_PERIOD_MS, 0);
+    simRunUntil(SIM_HOUR_MS);
+    simIsrEvery(NULL, 0);
+    taskCancel(&sampleTask);
+    taskCancel(&pollTask);
+    uint32_t dispatched, maxLateMs;
+    schedStats(&dispatched, &maxLateMs);
+    printf("simulated hour: %lu tasks run, %lu samples\n", (unsigned long) dispatched, (unsigned long) samples);
+    printf("isr task latency: avg %.3f ms, max %lu ms\n",
+           isrRuns ? (double) isrLatencySumMs / isrRuns : 0.0, (unsigned long) isrLatencyMaxMs);
+    printf("timer lateness: max %lu ms\n", (unsigned long) maxLateMs);
+    printf("idle: %.3f%%\n", 100.0 * (double) simAsleepMs() / (double) simNowMs());
+
+    // The host's cost of posting tasks and dispatching them, eight at a time
+    static task tasks[8];
+    for (int i = 0; i < 8; i++)
+        taskInit(&tasks[i], isrTaskFn, NULL);
+    const int posts = 10000000;
+    clock_t begin = clock();
+    for (int i = 0; i < posts; i++) {
+        taskPost(&tasks[i & 7]);
+        if ((i & 7) == 7)
+            schedDispatch();
+    }
+    printf("host post and dispatch: %.1f ns per task\n",
+           (double) (clock() - begin) / CLOCKS_PER_SEC * 1e9 / posts);
+
+    // The host's cost of rearming a timer with sixteen pending
+    static task timed[16];
+    for (int i = 0; i < 16; i++) {
+        taskInit(&timed[i], isrTaskFn, NULL);
+        taskAfter(&timed[i], 100000 + i * 7);
+    }
+    const int rearms = 2000000;
+    begin = clock();
+    for (int i = 0; i < rearms; i++)
+        taskAfter(&timed[i & 15], 100000 + (i * 13) % 500);
+    printf("host taskAfter with 16 timers: %.1f ns\n",
+           (double) (clock() - begin) / CLOCKS_PER_SEC * 1e9 / rearms);
+    for (int i = 0; i < 16; i++)
+        taskCancel(&timed[i]);
+
+    return 0;
+}
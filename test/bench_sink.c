@@ -0,0 +1,136 @@
+// Copyright 2019 Blues Inc.  All rights reserved.
+// Use of this source code is governed by licenses granted by the
+// copyright holder including that found in the LICENSE file.
+
+// Benchmark of the heap that note-c uses to send a request, over SERIAL and over I2C, to the
+// simulated Notecard of card_sim.c.  n_serial.c and n_i2c.c render a request through a small window
+// with JPrintToSink() rather than printing it whole, so the heap that a transaction needs beyond
+// the request's own JSON tree shouldn't grow with the request.  For note.add requests whose bodies
+// have 256 B, 1 KB and 4 KB of text, it reports the heap held by the tree, the peak heap of the
+// transaction beyond that, and the allocations made, and exits nonzero if the peak grows with the
+// body or a request doesn't reach the Notecard intact.
+
+#include <stdio.h>
+#include <string.h>
+#include "note.h"
+#include "card_sim.h"
+#include "heap_sim.h"
+
+// How much more the peak of a larger request may be than that of the smallest
+#define SLACK_BYTES     64
+
+// Simulated time, which passes only while note-c delays
+static uint32_t nowMs = 0;
+
+static void hostDelay(uint32_t ms) {
+    nowMs += ms;
+}
+
+static uint32_t hostMillis(void) {
+    return nowMs;
+}
+
+// SERIAL, straight to the simulated Notecard
+static bool serialReset(void) {
+    return true;
+}
+
+static void serialTransmit(uint8_t *data, size_t len, bool flush) {
+    (void) flush;
+    cardReceive(data, len);
+}
+
+static bool serialAvailable(void) {
+    return cardAvailable() > 0;
+}
+
+static char serialReceive(void) {
+    uint8_t data = 0;
+    cardSend(&data, 1);
+    return (char) data;
+}
+
+// I2C, in the frames of the Notecard's I2C protocol
+static bool i2cReset(uint16_t address) {
+    (void) address;
+    return true;
+}
+
+static const char *i2cTransmit(uint16_t address, uint8_t *data, uint16_t len) {
+    (void) address;
+    uint8_t frame[NOTE_I2C_MAX_MAX + 1];
+    frame[0] = (uint8_t) len;
+    memcpy(&frame[1], data, len);
+    return (cardI2CWrite(frame, len + 1) ? NULL : "i2c: frame not acknowledged");
+}
+
+static const char *i2cReceive(uint16_t address, uint8_t *data, uint16_t len, uint32_t *available) {
+    (void) address;
+    uint8_t frame[NOTE_I2C_MAX_MAX + 2] = {0, (uint8_t) len};
+    if (!cardI2CWrite(frame, 2) || cardI2CRead(frame, sizeof(frame)) != len + 2u)
+        return "i2c: incorrect amount of data";
+    memcpy(data, &frame[2], len);
+    *available = frame[0];
+    return NULL;
+}
+
+// A request to add a note whose body has a string of the specified length
+static J *noteAdd(size_t len) {
+    static char text[4096 + 1];
+    J *req = NoteNewRequest("note.add");
+    if (req == NULL)
+        return NULL;
+    JAddStringToObject(req, "file", "bench.qo");
+    memset(text, 'x', len);
+    text[len] = '\0';
+    J *body = JCreateObject();
+    JAddStringToObject(body, "text", text);
+    JAddItemToObject(req, "body", body);
+    return req;
+}
+
+// The length of a request as the Notecard should receive it, without its newline
+static size_t requestLength(J *req) {
+    char *json = JPrintUnformatted(req);
+    size_t len = (json == NULL ? 0 : strlen(json));
+    JFree(json);
+    return len;
+}
+
+// Send note.add requests of each size, reporting the heap that they use, and returning false if the
+// peak grows with the request or a request didn't reach the Notecard intact
+static bool bench(const char *interface) {
+    static const size_t lengths[] = {256, 1024, 4096};
+    size_t firstPeak = 0;
+    bool ok = true;
+    for (size_t i = 0; i < sizeof(lengths)/sizeof(lengths[0]); i++) {
+        cardReset("{\"total\":1}");
+        J *req = noteAdd(lengths[i]);
+        size_t expected = requestLength(req);
+        size_t treeBytes = heapHeld();
+        heapResetPeak();
+        uint32_t allocsBefore = heapAllocs();
+        bool sent = NoteRequest(req);
+        size_t peak = heapPeak() - treeBytes;
+        printf("%s, body text %4zu: %zu byte request, tree %5zu bytes, peak %4zu bytes more in %lu allocs\n",
+               interface, lengths[i], expected, treeBytes, peak, (unsigned long) (heapAllocs() - allocsBefore));
+        if (i == 0)
+            firstPeak = peak;
+        if (!sent || cardRequests() != 1 || cardLongestRequest() != expected || heapHeld() != 0 || peak > firstPeak + SLACK_BYTES)
+            ok = false;
+    }
+    return ok;
+}
+
+int main(void) {
+    NoteSetFn(heapMalloc, heapFree, hostDelay, hostMillis);
+    NoteSetFnRealloc(heapRealloc);
+    bool ok = true;
+
+    NoteSetFnSerial(serialReset, serialTransmit, serialAvailable, serialReceive);
+    ok = bench("serial") && ok;
+    NoteSetFnI2C(NOTE_I2C_ADDR_DEFAULT, NOTE_I2C_MAX_DEFAULT, i2cReset, i2cTransmit, i2cReceive);
+    ok = bench("i2c") && ok;
+
+    return (ok ? 0 : 1);
+}
@@ -0,0 +1,164 @@
+// Copyright 2019 Blues Inc.  All rights reserved.
+// Use of this source code is governed by licenses granted by the
+// copyright holder including that found in the LICENSE file.
+
+// Measurement of the stack used by note-c's JSON parse, print and delete, which work iteratively so
+// that the stack they use doesn't grow with the nesting of the JSON.  The stack below the caller is
+// painted with a pattern before each call, and the depth to which the pattern was overwritten is the
+// stack that the call used.  Exits nonzero if the stack used keeps growing with the nesting, or if JSON nested
+// more deeply than N_CJSON_NESTING_LIMIT is parsed or printed.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "note.h"
+
+// How much of the stack to paint, which must be more than any call measured uses
+#define PAINT_BYTES     65536
+#define PAINT_PATTERN   0xA5
+
+// How much more stack a nesting may use than the next shallower one measured, allowing for paths
+// through the parser that shallower JSON doesn't take, where a recursive parser would use a frame
+// more for every level
+#define SLACK_BYTES     64
+
+// The deepest tree deleted, which would overflow the stack if deleting it were recursive
+#define DEEP_LEVELS     200000
+
+static const char *text;
+static J *tree;
+static char *printed;
+
+// Painting and inspecting the stack are deliberately what the compiler warns about
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-but-set-variable"
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+
+__attribute__((noinline)) static void paint(void) {
+    volatile unsigned char stack[PAINT_BYTES];
+    for (size_t i = 0; i < PAINT_BYTES; i++)
+        stack[i] = PAINT_PATTERN;
+}
+
+__attribute__((noinline)) static size_t painted(void) {
+    volatile unsigned char stack[PAINT_BYTES];
+    size_t i;
+    for (i = 0; i < PAINT_BYTES && stack[i] == PAINT_PATTERN; i++)
+        ;
+    return PAINT_BYTES - i;
+}
+
+#pragma GCC diagnostic pop
+
+__attribute__((noinline)) static void parse(void) {
+    tree = JParse(text);
+}
+
+__attribute__((noinline)) static void print(void) {
+    printed = JPrintUnformatted(tree);
+}
+
+__attribute__((noinline)) static void delete(void) {
+    JDelete(tree);
+    tree = NULL;
+}
+
+// Get the stack used by a call, beyond that used by measuring it
+static size_t stackUsed(void (*fn)(void)) {
+    paint();
+    size_t base = painted();
+    paint();
+    fn();
+    size_t used = painted();
+    return (used > base ? used - base : 0);
+}
+
+// Build JSON nested to the specified number of levels, alternating objects and arrays
+static void nested(char *buf, int levels) {
+    char *p = buf;
+    for (int i = 0; i < levels; i++)
+        p += sprintf(p, (i & 1) ? "[1,\"s\"," : "{\"a\":");
+    p += sprintf(p, "null");
+    for (int i = levels - 1; i >= 0; i--)
+        *p++ = (i & 1) ? ']' : '}';
+    *p = '\0';
+}
+
+static uint32_t hostMillis(void) {
+    return 0;
+}
+
+static void hostDelay(uint32_t ms) {
+    (void) ms;
+}
+
+int main(void) {
+    NoteSetFn(malloc, free, hostDelay, hostMillis);
+    static char buf[16 * N_CJSON_NESTING_LIMIT + 16];
+    int failed = 0;
+
+    // Once to load whatever the first call of each needs, and then at each nesting
+    nested(buf, 1);
+    text = buf;
+    parse();
+    print();
+    JFree(printed);
+    delete();
+    const int nestings[] = {2, 4, 8, 16, 32, N_CJSON_NESTING_LIMIT};
+    size_t lastParse = 0, lastPrint = 0, lastDelete = 0;
+    for (size_t i = 0; i < sizeof(nestings)/sizeof(nestings[0]); i++) {
+        nested(buf, nestings[i]);
+        size_t parseUsed = stackUsed(parse);
+        if (tree == NULL) {
+            printf("nesting %3d: not parsed\n", nestings[i]);
+            failed = 1;
+            continue;
+        }
+        size_t printUsed = stackUsed(print);
+        bool same = (printed != NULL && strcmp(printed, buf) == 0);
+        JFree(printed);
+        size_t deleteUsed = stackUsed(delete);
+        printf("nesting %3d: parse %5zu, print %5zu, delete %5zu bytes of stack%s\n",
+               nestings[i], parseUsed, printUsed, deleteUsed, same ? "" : " (printed differently)");
+        if (i > 0 && (parseUsed > lastParse + SLACK_BYTES || printUsed > lastPrint + SLACK_BYTES || deleteUsed > lastDelete + SLACK_BYTES))
+            failed = 1;
+        lastParse = parseUsed;
+        lastPrint = printUsed;
+        lastDelete = deleteUsed;
+        if (!same)
+            failed = 1;
+    }
+
+    // JSON nested past the limit is neither parsed nor printed
+    nested(buf, N_CJSON_NESTING_LIMIT + 1);
+    J *j = JParse(buf);
+    printf("nesting %3d: %s\n", N_CJSON_NESTING_LIMIT + 1, j == NULL ? "not parsed" : "parsed");
+    if (j != NULL)
+        failed = 1;
+    JDelete(j);
+    nested(buf, N_CJSON_NESTING_LIMIT);
+    j = JCreateArray();
+    JAddItemToArray(j, JParse(buf));
+    char *s = JPrintUnformatted(j);
+    printf("nesting %3d: %s\n", N_CJSON_NESTING_LIMIT + 1, s == NULL ? "not printed" : "printed");
+    if (s != NULL)
+        failed = 1;
+    JFree(s);
+    JDelete(j);
+
+    // A tree far deeper than could be parsed is still deleted without recursing
+    tree = JCreateArray();
+    J *leaf = tree;
+    for (int i = 0; i < DEEP_LEVELS; i++) {
+        J *child = JCreateArray();
+        JAddItemToArray(leaf, child);
+        leaf = child;
+    }
+    size_t deleteUsed = stackUsed(delete);
+    printf("nesting %d: delete %zu bytes of stack\n", DEEP_LEVELS, deleteUsed);
+    if (deleteUsed > lastDelete + SLACK_BYTES)
+        failed = 1;
+
+    return failed;
+}
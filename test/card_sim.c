@@ -0,0 +1,188 @@
+// Copyright 2019 Blues Inc.  All rights reserved.
+// Use of this source code is governed by licenses granted by the
+// copyright holder including that found in the LICENSE file.
+
+#include <string.h>
+#include "card_sim.h"
+
+// The request being received, and the replies yet to be sent
+static char request[CARD_REQUEST_MAX];
+static size_t requestLen = 0;
+static const char *replyLine = "{}";
+static uint8_t replies[1024];
+static size_t repliesLen = 0;
+static size_t repliesSent = 0;
+
+// Whether the request being received has lost bytes to an overrun
+static bool requestGarbled = false;
+
+// The receive buffer's limit, and how much of it the card has yet to drain, in millionths of bytes
+static size_t bufferBytes = 0;
+static uint32_t bufferDrainPerSec = 0;
+static uint64_t bufferHeld = 0;
+
+// The card's own time, how long it takes to reply, and when the last reply is due
+static uint64_t nowUs = 0;
+static uint32_t replyDelayUs = 0;
+static uint64_t replyDueUs = 0;
+
+// How many bytes the last I2C read request asked for
+static size_t i2cReadLen = 0;
+
+static uint32_t requests = 0;
+static size_t longestRequest = 0;
+static uint32_t overruns = 0;
+
+// Start afresh, answering each request with the specified reply, which has no newline
+void cardReset(const char *reply) {
+    replyLine = reply;
+    requestLen = repliesLen = repliesSent = i2cReadLen = 0;
+    requestGarbled = false;
+    bufferBytes = 0;
+    bufferHeld = 0;
+    replyDelayUs = 0;
+    replyDueUs = nowUs;
+    requests = 0;
+    longestRequest = 0;
+    overruns = 0;
+}
+
+// Limit the receive buffer to the specified number of bytes, which the card drains at the specified rate
+void cardLimitBuffer(size_t bytes, uint32_t bytesPerSec) {
+    bufferBytes = bytes;
+    bufferDrainPerSec = bytesPerSec;
+    bufferHeld = 0;
+}
+
+// Delay each reply by the specified time after the end of its request
+void cardDelayReplies(uint32_t us) {
+    replyDelayUs = us;
+}
+
+// Pass time for the card to drain its receive buffer and to reply
+void cardPass(uint32_t us) {
+    nowUs += us;
+    uint64_t drained = (uint64_t) us * bufferDrainPerSec;
+    bufferHeld = (drained > bufferHeld ? 0 : bufferHeld - drained);
+}
+
+// Take a byte into the receive buffer, returning false if it's full
+static bool buffer(void) {
+    if (bufferBytes == 0)
+        return true;
+    if (bufferHeld + 1000000 > (uint64_t) bufferBytes * 1000000) {
+        overruns++;
+        return false;
+    }
+    bufferHeld += 1000000;
+    return true;
+}
+
+// Queue a line of reply
+static void reply(const char *line) {
+    if (repliesSent == repliesLen)
+        repliesLen = repliesSent = 0;
+    size_t len = strlen(line);
+    if (repliesLen + len + 2 > sizeof(replies))
+        return;
+    memcpy(&replies[repliesLen], line, len);
+    memcpy(&replies[repliesLen + len], "\r\n", 2);
+    repliesLen += len + 2;
+}
+
+// Answer the request just received
+static void answer(void) {
+    replyDueUs = nowUs + replyDelayUs;
+    if (requestLen > 0 && request[requestLen-1] == '\r')
+        requestLen--;
+    if (requestLen == 0) {
+        reply("");
+        return;
+    }
+    requests++;
+    if (requestLen > longestRequest)
+        longestRequest = requestLen;
+    request[requestLen] = '\0';
+    if (requestGarbled)
+        reply("{\"err\":\"request was garbled {io}\"}");
+    else if (strstr(request, "\"cmd\"") == NULL)
+        reply(replyLine);
+    requestLen = 0;
+    requestGarbled = false;
+}
+
+// Send the card bytes of requests
+void cardReceive(const uint8_t *data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        if (!buffer())
+            requestGarbled = true;
+        else if (data[i] == '\n')
+            answer();
+        else if (requestLen < sizeof(request) - 1)
+            request[requestLen++] = (char) data[i];
+    }
+}
+
+// Get how many bytes of replies the card has yet to send, none of which it has sent until it has
+// drained what it received before them and its reply is due
+size_t cardAvailable(void) {
+    if (bufferHeld > 0 || nowUs < replyDueUs)
+        return 0;
+    return repliesLen - repliesSent;
+}
+
+// Take up to the specified number of bytes of replies
+size_t cardSend(uint8_t *data, size_t len) {
+    if (len > cardAvailable())
+        len = cardAvailable();
+    memcpy(data, &replies[repliesSent], len);
+    repliesSent += len;
+    return len;
+}
+
+// Write a frame of the I2C protocol
+bool cardI2CWrite(const uint8_t *frame, size_t len) {
+    if (len < 2)
+        return false;
+    if (frame[0] == 0 && len == 2) {
+        i2cReadLen = frame[1];
+        return true;
+    }
+    if (frame[0] != len - 1)
+        return false;
+    if (bufferBytes != 0 && bufferHeld + (uint64_t) (len - 1) * 1000000 > (uint64_t) bufferBytes * 1000000) {
+        overruns++;
+        requestGarbled = true;
+        return false;
+    }
+    cardReceive(&frame[1], len - 1);
+    return true;
+}
+
+// Read the frame of the I2C protocol that the last write asked for
+size_t cardI2CRead(uint8_t *frame, size_t max) {
+    size_t len = i2cReadLen;
+    i2cReadLen = 0;
+    if (len + 2 > max || len > cardAvailable())
+        return 0;
+    cardSend(&frame[2], len);
+    size_t available = cardAvailable();
+    frame[0] = (uint8_t) (available > 255 ? 255 : available);
+    frame[1] = (uint8_t) len;
+    return len + 2;
+}
+
+// How many requests the card has answered or not
+uint32_t cardRequests(void) {
+    return requests;
+}
+
+// How many bytes have been dropped or I2C writes refused because the receive buffer was full
+uint32_t cardOverruns(void) {
+    return overruns;
+}
+
+// The length of the longest request, without its newline
+size_t cardLongestRequest(void) {
+    return longestRequest;
+}
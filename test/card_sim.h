@@ -0,0 +1,56 @@
+#ifndef CARD_SIM_H
+#define CARD_SIM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+//
+// A simulated Notecard for host benchmarks of the code that talks to it.  It answers every request
+// line that it's sent with the same reply line, except for a "cmd", which it doesn't answer, and it
+// answers a blank line with a blank line as the real Notecard does.  It may be talked to as a byte
+// stream, as over SERIAL, or in the frames of the Notecard's I2C protocol: a write of a length and
+// that many bytes of request, or a write of a zero length and the number of bytes to read, which are
+// then read back after two header bytes giving how many more are available and how many follow.
+// Its receive buffer may be limited, like the Notecard's interrupt buffer, so that it overruns if
+// requests are sent faster than the card drains it.  Bytes that overrun it over SERIAL are dropped,
+// and the request that they were part of is answered with an I/O error, as it is if an I2C write
+// of it doesn't fit and is refused.  Nor does the card reply to a request before it has drained it,
+// and its replies may be delayed, as though it took that long to process each request.
+//
+
+#define CARD_I2C_ADDRESS    0x17
+#define CARD_REQUEST_MAX    8192
+
+// Start afresh, answering each request with the specified reply, which has no newline, with no
+// limit to the receive buffer, and with no delay
+void cardReset(const char *reply);
+
+// Delay each reply by the specified time after the end of its request
+void cardDelayReplies(uint32_t us);
+
+// Limit the receive buffer to the specified number of bytes, which the card drains at the specified
+// rate, and pass time for the card to drain it and to reply
+void cardLimitBuffer(size_t bytes, uint32_t bytesPerSec);
+void cardPass(uint32_t us);
+
+// Send the card bytes of requests
+void cardReceive(const uint8_t *data, size_t len);
+
+// Get how many bytes of replies the card has yet to send, and take up to the specified number of them
+size_t cardAvailable(void);
+size_t cardSend(uint8_t *data, size_t len);
+
+// Write a frame of the I2C protocol, returning false if it's malformed or doesn't fit, and read the
+// frame that the last write asked for, returning its length, or 0 if it asked for more than is available
+bool cardI2CWrite(const uint8_t *frame, size_t len);
+size_t cardI2CRead(uint8_t *frame, size_t max);
+
+// How many requests the card has answered or not, and the length of the longest, without its newline
+uint32_t cardRequests(void);
+size_t cardLongestRequest(void);
+
+// How many bytes have been dropped or I2C writes refused because the receive buffer was full
+uint32_t cardOverruns(void);
+
+#endif // CARD_SIM_H
@@ -0,0 +1,27 @@
+#ifndef CHECK_H
+#define CHECK_H
+
+#include <stdio.h>
+
+//
+// The least that the host tests need: CHECK() reports a failed condition and carries on, so that
+// one run shows every failure, and checkReport() summarizes them as the program's exit status.
+//
+
+static unsigned checkFailures = 0;
+static unsigned long checkCount = 0;
+
+#define CHECK(cond) do { \
+    checkCount++; \
+    if (!(cond)) { \
+        if (checkFailures++ < 20) \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+    } \
+} while (0)
+
+static inline int checkReport(const char *name) {
+    printf("%s: %lu checks, %u failed\n", name, checkCount, checkFailures);
+    return checkFailures == 0 ? 0 : 1;
+}
+
+#endif // CHECK_H
@@ -0,0 +1,71 @@
+// Copyright 2019 Blues Inc.  All rights reserved.
+// Use of this source code is governed by licenses granted by the
+// copyright holder including that found in the LICENSE file.
+
+#include <stdlib.h>
+#include "heap_sim.h"
+
+// A heap that counts what it holds, in a header before each block
+typedef struct {
+    size_t size;
+    max_align_t align;
+} block;
+static size_t held = 0;
+static size_t peak = 0;
+static uint32_t allocs = 0;
+
+void *heapMalloc(size_t size) {
+    block *b = malloc(sizeof(block) + size);
+    if (b == NULL)
+        return NULL;
+    b->size = size;
+    held += size;
+    if (held > peak)
+        peak = held;
+    allocs++;
+    return b + 1;
+}
+
+void heapFree(void *p) {
+    if (p == NULL)
+        return;
+    block *b = (block *) p - 1;
+    held -= b->size;
+    free(b);
+}
+
+void *heapRealloc(void *p, size_t size) {
+    if (p == NULL)
+        return heapMalloc(size);
+    block *b = (block *) p - 1;
+    size_t was = b->size;
+    b = realloc(b, sizeof(block) + size);
+    if (b == NULL)
+        return NULL;
+    held = held - was + size;
+    b->size = size;
+    if (held > peak)
+        peak = held;
+    allocs++;
+    return b + 1;
+}
+
+// The bytes held now
+size_t heapHeld(void) {
+    return held;
+}
+
+// The most held since the peak was last reset
+size_t heapPeak(void) {
+    return peak;
+}
+
+// Reset the peak to what is held now
+void heapResetPeak(void) {
+    peak = held;
+}
+
+// How many allocations, including reallocations, have been made
+uint32_t heapAllocs(void) {
+    return allocs;
+}
@@ -0,0 +1,24 @@
+#ifndef HEAP_SIM_H
+#define HEAP_SIM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+//
+// A heap for host benchmarks that counts what it holds, the most that it has held, and the
+// allocations made from it, for use as note-c's malloc, free and realloc.
+//
+
+void *heapMalloc(size_t size);
+void heapFree(void *p);
+void *heapRealloc(void *p, size_t size);
+
+// The bytes held now, and the most held since the peak was last reset to what is held now
+size_t heapHeld(void);
+size_t heapPeak(void);
+void heapResetPeak(void);
+
+// How many allocations, including reallocations, have been made
+uint32_t heapAllocs(void);
+
+#endif // HEAP_SIM_H
@@ -0,0 +1,393 @@
+// Copyright 2019 Blues Inc.  All rights reserved.
+// Use of this source code is governed by licenses granted by the
+// copyright holder including that found in the LICENSE file.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "driverlib.h"
+#include "card_sim.h"
+
+// main.c's ISRs
+void USCI_B0_ISR(void);
+void TIMER0_B1_ISR(void);
+
+// Registers
+volatile uint16_t FRCTL0, SFRIFG1;
+volatile uint16_t CSCTL0, CSCTL1, CSCTL2, CSCTL3, CSCTL4, CSCTL7;
+volatile uint8_t P2SEL1, P3DIR, P3SEL0, P3SEL1;
+volatile uint16_t UCB0CTLW0, UCB0IV;
+volatile uint16_t TB0CTL, TB0IV, P2IV;
+
+// The CPU's status register, and the bits that the running ISR has cleared in the one it returns to
+static unsigned short sr = 0;
+static unsigned short srClearOnExit = 0;
+static bool inIsr = false;
+
+// Simulated time
+static uint64_t nowNs = 0;
+
+// Timer_B: the overflows that have interrupted so far, and the one-shot compare
+static bool timerStarted = false;
+static bool timerOverflowEnabled = false;
+static uint64_t timerOverflowsTaken = 0;
+static uint64_t compareDueTicks = 0;
+static bool compareEnabled = false;
+static bool compareFlag = false;
+
+// eUSCI_B: its interrupt enables and flags, the bus rate, and the frame on the wire
+#define I2C_VECTOR_NACK     0x04
+#define I2C_VECTOR_RX0      0x16
+#define I2C_VECTOR_TX0      0x18
+static uint16_t i2cEnables = 0;
+static uint16_t i2cFlags = 0;
+static uint32_t i2cRate = 100000;
+static uint8_t i2cAddress = 0;
+static uint8_t i2cFrame[CARD_REQUEST_MAX];
+static size_t i2cFrameLen = 0;
+static size_t i2cFrameNext = 0;
+static bool i2cStopping = false;
+static uint32_t i2cInterrupts = 0;
+static uint32_t i2cBytes = 0;
+static uint32_t i2cErrors = 0;
+
+// The clock ticks elapsed, counting ACLK at exactly 32768 Hz
+static uint64_t timerTicks(void) {
+    return nowNs * 32768 / 1000000000;
+}
+
+// Pass time, raising the timer's flags for whatever it passed
+static void pass(uint64_t ns) {
+    nowNs += ns;
+    if (!timerStarted)
+        return;
+    uint64_t ticks = timerTicks();
+    if ((ticks >> 16) > timerOverflowsTaken)
+        TB0CTL |= TBIFG;
+    while (ticks >= compareDueTicks) {
+        compareFlag = true;
+        compareDueTicks += 0x10000;
+    }
+}
+
+// Pass the time to put the specified number of bytes on the wire, each with its acknowledge bit
+static void wire(uint32_t bytes) {
+    i2cBytes += bytes;
+    pass((uint64_t) bytes * 9 * 1000000000 / i2cRate);
+}
+
+// Call an ISR as the CPU would, with interrupts disabled until it returns
+static void isr(void (*fn)(void)) {
+    unsigned short saved = sr;
+    sr &= ~(GIE | LPM3_bits);
+    srClearOnExit = 0;
+    inIsr = true;
+    fn();
+    inIsr = false;
+    sr = saved & ~srClearOnExit;
+}
+
+// Take the pending interrupt of the highest priority, returning false if none is pending
+static bool take(void) {
+    if (!(sr & GIE))
+        return false;
+    if (compareEnabled && compareFlag) {
+        compareFlag = false;
+        TB0IV = TB0IV_TBCCR1;
+        isr(TIMER0_B1_ISR);
+        return true;
+    }
+    if (timerOverflowEnabled && (TB0CTL & TBIFG)) {
+        TB0CTL &= ~TBIFG;
+        timerOverflowsTaken++;
+        TB0IV = TB0IV_TBIFG;
+        isr(TIMER0_B1_ISR);
+        return true;
+    }
+    uint16_t pending = i2cFlags & i2cEnables;
+    if (pending != 0) {
+        if (pending & EUSCI_B_I2C_NAK_INTERRUPT) {
+            i2cFlags &= ~EUSCI_B_I2C_NAK_INTERRUPT;
+            UCB0IV = I2C_VECTOR_NACK;
+        } else if (pending & EUSCI_B_I2C_RECEIVE_INTERRUPT0) {
+            i2cFlags &= ~EUSCI_B_I2C_RECEIVE_INTERRUPT0;
+            UCB0IV = I2C_VECTOR_RX0;
+        } else if (pending & EUSCI_B_I2C_TRANSMIT_INTERRUPT0) {
+            i2cFlags &= ~EUSCI_B_I2C_TRANSMIT_INTERRUPT0;
+            UCB0IV = I2C_VECTOR_TX0;
+        } else {
+            i2cFlags &= ~pending;
+            UCB0IV = 0;
+        }
+        i2cInterrupts++;
+        isr(USCI_B0_ISR);
+        return true;
+    }
+    return false;
+}
+
+// Take pending interrupts, and while the CPU is asleep, pass time until the timer wakes it
+static void run(void) {
+    while (true) {
+        while (take())
+            ;
+        if (!(sr & CPUOFF) || inIsr)
+            return;
+        if (!(sr & GIE) || !timerStarted) {
+            fprintf(stderr, "mock: the CPU is asleep with nothing to wake it\n");
+            exit(1);
+        }
+        uint64_t ticks = timerTicks();
+        uint64_t wakeTicks = ((ticks >> 16) + 1) << 16;
+        if (compareEnabled && compareDueTicks < wakeTicks)
+            wakeTicks = compareDueTicks;
+        uint64_t wakeNs = (wakeTicks * 1000000000 + 32767) / 32768;
+        pass(wakeNs > nowNs ? wakeNs - nowNs : 1);
+    }
+}
+
+// Intrinsics
+void __disable_interrupt(void) {
+    sr &= ~GIE;
+}
+
+void __enable_interrupt(void) {
+    sr |= GIE;
+    run();
+}
+
+unsigned short __get_interrupt_state(void) {
+    return sr & GIE;
+}
+
+void __set_interrupt_state(unsigned short state) {
+    sr = (sr & ~GIE) | (state & GIE);
+    run();
+}
+
+void __bis_SR_register(unsigned short bits) {
+    sr |= bits;
+    run();
+}
+
+void __bic_SR_register(unsigned short bits) {
+    sr &= ~bits;
+}
+
+void __bic_SR_register_on_exit(unsigned short bits) {
+    srClearOnExit |= bits;
+}
+
+// CS, PMM and WDT_A
+uint32_t CS_getSMCLK(void) {
+    return 24000000;
+}
+
+void PMM_unlockLPM5(void) {
+}
+
+void WDT_A_hold(uint16_t baseAddress) {
+    (void) baseAddress;
+}
+
+// GPIO
+void GPIO_setAsOutputPin(uint8_t selectedPort, uint16_t selectedPins) {
+    (void) selectedPort; (void) selectedPins;
+}
+
+void GPIO_setOutputLowOnPin(uint8_t selectedPort, uint16_t selectedPins) {
+    (void) selectedPort; (void) selectedPins;
+}
+
+void GPIO_setAsInputPinWithPullDownResistor(uint8_t selectedPort, uint16_t selectedPins) {
+    (void) selectedPort; (void) selectedPins;
+}
+
+void GPIO_setAsPeripheralModuleFunctionInputPin(uint8_t selectedPort, uint16_t selectedPins, uint8_t mode) {
+    (void) selectedPort; (void) selectedPins; (void) mode;
+}
+
+void GPIO_setAsPeripheralModuleFunctionOutputPin(uint8_t selectedPort, uint16_t selectedPins, uint8_t mode) {
+    (void) selectedPort; (void) selectedPins; (void) mode;
+}
+
+void GPIO_selectInterruptEdge(uint8_t selectedPort, uint16_t selectedPins, uint8_t edgeSelect) {
+    (void) selectedPort; (void) selectedPins; (void) edgeSelect;
+}
+
+void GPIO_enableInterrupt(uint8_t selectedPort, uint16_t selectedPins) {
+    (void) selectedPort; (void) selectedPins;
+}
+
+void GPIO_disableInterrupt(uint8_t selectedPort, uint16_t selectedPins) {
+    (void) selectedPort; (void) selectedPins;
+}
+
+void GPIO_clearInterrupt(uint8_t selectedPort, uint16_t selectedPins) {
+    (void) selectedPort; (void) selectedPins;
+}
+
+uint8_t GPIO_getInputPinValue(uint8_t selectedPort, uint16_t selectedPins) {
+    (void) selectedPort; (void) selectedPins;
+    return 0;
+}
+
+// Timer_B
+void Timer_B_initContinuousMode(uint16_t baseAddress, Timer_B_initContinuousModeParam *param) {
+    (void) baseAddress;
+    timerStarted = param->startTimer;
+    timerOverflowEnabled = (param->timerInterruptEnable_TBIE == TIMER_B_TBIE_INTERRUPT_ENABLE);
+    timerOverflowsTaken = timerTicks() >> 16;
+    compareDueTicks = UINT64_MAX;
+}
+
+uint16_t Timer_B_getCounterValue(uint16_t baseAddress) {
+    (void) baseAddress;
+    return (uint16_t) timerTicks();
+}
+
+void Timer_B_setCompareValue(uint16_t baseAddress, uint16_t compareRegister, uint16_t compareValue) {
+    (void) baseAddress; (void) compareRegister;
+    uint64_t ticks = timerTicks();
+    uint16_t ahead = (uint16_t) (compareValue - (uint16_t) ticks);
+    compareDueTicks = ticks + (ahead == 0 ? 0x10000 : ahead);
+}
+
+void Timer_B_clearCaptureCompareInterrupt(uint16_t baseAddress, uint16_t captureCompareRegister) {
+    (void) baseAddress; (void) captureCompareRegister;
+    compareFlag = false;
+}
+
+void Timer_B_enableCaptureCompareInterrupt(uint16_t baseAddress, uint16_t captureCompareRegister) {
+    (void) baseAddress; (void) captureCompareRegister;
+    compareEnabled = true;
+}
+
+void Timer_B_disableCaptureCompareInterrupt(uint16_t baseAddress, uint16_t captureCompareRegister) {
+    (void) baseAddress; (void) captureCompareRegister;
+    compareEnabled = false;
+}
+
+// eUSCI_B, which resets its interrupts when initialized
+void EUSCI_B_I2C_initMaster(uint16_t baseAddress, EUSCI_B_I2C_initMasterParam *param) {
+    (void) baseAddress;
+    i2cRate = param->dataRate;
+    i2cEnables = i2cFlags = 0;
+}
+
+void EUSCI_B_I2C_setSlaveAddress(uint16_t baseAddress, uint8_t slaveAddress) {
+    (void) baseAddress;
+    i2cAddress = slaveAddress;
+}
+
+void EUSCI_B_I2C_setMode(uint16_t baseAddress, uint8_t mode) {
+    (void) baseAddress; (void) mode;
+}
+
+void EUSCI_B_I2C_enable(uint16_t baseAddress) {
+    (void) baseAddress;
+}
+
+void EUSCI_B_I2C_clearInterrupt(uint16_t baseAddress, uint16_t mask) {
+    (void) baseAddress;
+    i2cFlags &= ~mask;
+}
+
+void EUSCI_B_I2C_enableInterrupt(uint16_t baseAddress, uint16_t mask) {
+    (void) baseAddress;
+    i2cEnables |= mask;
+}
+
+// Start a write with the address and the first byte, which the Notecard acknowledges only if it's
+// the one addressed
+void EUSCI_B_I2C_masterSendMultiByteStart(uint16_t baseAddress, uint8_t txData) {
+    (void) baseAddress;
+    wire(1);
+    if (i2cAddress != CARD_I2C_ADDRESS) {
+        i2cFlags |= EUSCI_B_I2C_NAK_INTERRUPT;
+        return;
+    }
+    wire(1);
+    i2cFrame[0] = txData;
+    i2cFrameLen = 1;
+    i2cFlags |= EUSCI_B_I2C_TRANSMIT_INTERRUPT0;
+}
+
+void EUSCI_B_I2C_masterSendMultiByteNext(uint16_t baseAddress, uint8_t txData) {
+    (void) baseAddress;
+    wire(1);
+    if (i2cFrameLen < sizeof(i2cFrame))
+        i2cFrame[i2cFrameLen++] = txData;
+    i2cFlags |= EUSCI_B_I2C_TRANSMIT_INTERRUPT0;
+}
+
+// Send the last byte and the stop condition, handing the frame to the Notecard
+void EUSCI_B_I2C_masterSendMultiByteFinish(uint16_t baseAddress, uint8_t txData) {
+    (void) baseAddress;
+    wire(1);
+    if (i2cFrameLen < sizeof(i2cFrame))
+        i2cFrame[i2cFrameLen++] = txData;
+    if (!cardI2CWrite(i2cFrame, i2cFrameLen))
+        i2cErrors++;
+}
+
+// Start a read with the address, after which the Notecard sends the frame asked for by the last
+// write, and the bus reads as 0xFF past its end
+void EUSCI_B_I2C_masterReceiveStart(uint16_t baseAddress) {
+    (void) baseAddress;
+    wire(1);
+    if (i2cAddress != CARD_I2C_ADDRESS) {
+        i2cFlags |= EUSCI_B_I2C_NAK_INTERRUPT;
+        return;
+    }
+    i2cFrameLen = cardI2CRead(i2cFrame, sizeof(i2cFrame));
+    if (i2cFrameLen == 0)
+        i2cErrors++;
+    i2cFrameNext = 0;
+    i2cStopping = false;
+    wire(1);
+    i2cFlags |= EUSCI_B_I2C_RECEIVE_INTERRUPT0;
+}
+
+// Take the byte received, while the next is clocked in unless a stop has been asked for
+uint8_t EUSCI_B_I2C_masterReceiveMultiByteNext(uint16_t baseAddress) {
+    (void) baseAddress;
+    uint8_t data = 0xFF;
+    if (i2cFrameNext < i2cFrameLen)
+        data = i2cFrame[i2cFrameNext];
+    else
+        i2cErrors++;
+    i2cFrameNext++;
+    if (!i2cStopping) {
+        wire(1);
+        i2cFlags |= EUSCI_B_I2C_RECEIVE_INTERRUPT0;
+    }
+    return data;
+}
+
+// Make the byte being received the last
+void EUSCI_B_I2C_masterReceiveMultiByteStop(uint16_t baseAddress) {
+    (void) baseAddress;
+    i2cStopping = true;
+}
+
+uint16_t EUSCI_B_I2C_masterIsStopSent(uint16_t baseAddress) {
+    (void) baseAddress;
+    return EUSCI_B_I2C_STOP_SEND_COMPLETE;
+}
+
+// The simulated time, and what the simulated eUSCI_B has done
+uint64_t mockNowNs(void) {
+    return nowNs;
+}
+
+uint32_t mockI2CInterrupts(void) {
+    return i2cInterrupts;
+}
+
+uint32_t mockI2CBytes(void) {
+    return i2cBytes;
+}
+
+uint32_t mockI2CErrors(void) {
+    return i2cErrors;
+}
@@ -0,0 +1,164 @@
+#ifndef DRIVERLIB_H
+#define DRIVERLIB_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+//
+// A mock of the parts of TI's driverlib and the MSP430FR2355's device header that main.c uses when
+// talking to the Notecard over I2C, so that main.c can be built and run on a host.  Registers that
+// main.c only sets up are plain variables.  The eUSCI_B is simulated as an I2C master with the
+// simulated Notecard of test/card_sim.c on the bus, and Timer_B as counting ACLK against simulated
+// time, which passes only while bytes are on the wire or while the CPU sleeps waiting for the timer.
+// Interrupts are delivered to main.c's own ISRs whenever they're pending and enabled, and the CPU
+// sleeps in __bis_SR_register() until an ISR wakes it.
+//
+
+// Status register bits, and the low-power modes
+#define GIE                 0x0008
+#define CPUOFF              0x0010
+#define OSCOFF              0x0020
+#define SCG0                0x0040
+#define SCG1                0x0080
+#define LPM0_bits           (CPUOFF)
+#define LPM3_bits           (SCG1+SCG0+CPUOFF)
+
+// Intrinsics
+void __disable_interrupt(void);
+void __enable_interrupt(void);
+unsigned short __get_interrupt_state(void);
+void __set_interrupt_state(unsigned short state);
+void __bis_SR_register(unsigned short bits);
+void __bic_SR_register(unsigned short bits);
+void __bic_SR_register_on_exit(unsigned short bits);
+#define __delay_cycles(cycles)          ((void) (cycles))
+#define __even_in_range(vector, range)  (vector)
+
+// ISRs are ordinary functions, kept even though nothing in main.c calls them
+#define interrupt(vector)   used
+
+// Registers
+extern volatile uint16_t FRCTL0, SFRIFG1;
+extern volatile uint16_t CSCTL0, CSCTL1, CSCTL2, CSCTL3, CSCTL4, CSCTL7;
+extern volatile uint8_t P2SEL1, P3DIR, P3SEL0, P3SEL1;
+extern volatile uint16_t UCB0CTLW0, UCB0IV;
+extern volatile uint16_t TB0CTL, TB0IV, P2IV;
+
+#define BIT4                0x0010
+#define BIT6                0x0040
+#define BIT7                0x0080
+#define FRCTLPW             0xA500
+#define NWAITS_2            0x0020
+#define OFIFG               0x0002
+#define DCOFFG              0x0001
+#define XT1OFFG             0x0002
+#define FLLUNLOCK0          0x0100
+#define FLLUNLOCK1          0x0200
+#define SELREF__XT1CLK      0x0000
+#define DCORSEL_7           0x000E
+#define FLLD_0              0x0000
+#define SELMS__DCOCLKDIV    0x0000
+#define SELA__XT1CLK        0x0000
+#define UCTXSTP             0x0004
+#define TBIFG               0x0001
+#define TB0IV_TBCCR1        0x0002
+#define TB0IV_TBIFG         0x000E
+#define P2IV_P2IFG0         0x0002
+#define P2IV_P2IFG7         0x0010
+
+// Base addresses
+#define EUSCI_B0_BASE       0x0540
+#define TIMER_B0_BASE       0x0380
+#define WDT_A_BASE          0x01CC
+
+// CS, PMM and WDT_A
+uint32_t CS_getSMCLK(void);
+void PMM_unlockLPM5(void);
+void WDT_A_hold(uint16_t baseAddress);
+
+// GPIO, whose pins all read low
+#define GPIO_PORT_P1                    1
+#define GPIO_PORT_P2                    2
+#define GPIO_PORT_P4                    4
+#define GPIO_PORT_PA                    1
+#define GPIO_PORT_PB                    3
+#define GPIO_PORT_PC                    5
+#define GPIO_PORT_PD                    7
+#define GPIO_PORT_PE                    9
+#define GPIO_PIN0                       0x0001
+#define GPIO_PIN2                       0x0004
+#define GPIO_PIN3                       0x0008
+#define GPIO_PIN_ALL16                  0xFFFF
+#define GPIO_PRIMARY_MODULE_FUNCTION    0x01
+#define GPIO_LOW_TO_HIGH_TRANSITION     0x00
+#define GPIO_INPUT_PIN_HIGH             0x01
+void GPIO_setAsOutputPin(uint8_t selectedPort, uint16_t selectedPins);
+void GPIO_setOutputLowOnPin(uint8_t selectedPort, uint16_t selectedPins);
+void GPIO_setAsInputPinWithPullDownResistor(uint8_t selectedPort, uint16_t selectedPins);
+void GPIO_setAsPeripheralModuleFunctionInputPin(uint8_t selectedPort, uint16_t selectedPins, uint8_t mode);
+void GPIO_setAsPeripheralModuleFunctionOutputPin(uint8_t selectedPort, uint16_t selectedPins, uint8_t mode);
+void GPIO_selectInterruptEdge(uint8_t selectedPort, uint16_t selectedPins, uint8_t edgeSelect);
+void GPIO_enableInterrupt(uint8_t selectedPort, uint16_t selectedPins);
+void GPIO_disableInterrupt(uint8_t selectedPort, uint16_t selectedPins);
+void GPIO_clearInterrupt(uint8_t selectedPort, uint16_t selectedPins);
+uint8_t GPIO_getInputPinValue(uint8_t selectedPort, uint16_t selectedPins);
+
+// Timer_B
+#define TIMER_B_CLOCKSOURCE_ACLK            0x0100
+#define TIMER_B_CLOCKSOURCE_DIVIDER_1       0x00
+#define TIMER_B_TBIE_INTERRUPT_ENABLE       0x0002
+#define TIMER_B_DO_CLEAR                    0x0004
+#define TIMER_B_CAPTURECOMPARE_REGISTER_1   0x04
+typedef struct Timer_B_initContinuousModeParam {
+    uint16_t clockSource;
+    uint16_t clockSourceDivider;
+    uint16_t timerInterruptEnable_TBIE;
+    uint16_t timerClear;
+    bool startTimer;
+} Timer_B_initContinuousModeParam;
+void Timer_B_initContinuousMode(uint16_t baseAddress, Timer_B_initContinuousModeParam *param);
+uint16_t Timer_B_getCounterValue(uint16_t baseAddress);
+void Timer_B_setCompareValue(uint16_t baseAddress, uint16_t compareRegister, uint16_t compareValue);
+void Timer_B_clearCaptureCompareInterrupt(uint16_t baseAddress, uint16_t captureCompareRegister);
+void Timer_B_enableCaptureCompareInterrupt(uint16_t baseAddress, uint16_t captureCompareRegister);
+void Timer_B_disableCaptureCompareInterrupt(uint16_t baseAddress, uint16_t captureCompareRegister);
+
+// eUSCI_B in I2C mode
+#define EUSCI_B_I2C_CLOCKSOURCE_SMCLK                               0x00C0
+#define EUSCI_B_I2C_SEND_STOP_AUTOMATICALLY_ON_BYTECOUNT_THRESHOLD  0x0008
+#define EUSCI_B_I2C_TRANSMIT_MODE                                   0x0010
+#define EUSCI_B_I2C_RECEIVE_MODE                                    0x00
+#define EUSCI_B_I2C_RECEIVE_INTERRUPT0                              0x0001
+#define EUSCI_B_I2C_TRANSMIT_INTERRUPT0                             0x0002
+#define EUSCI_B_I2C_NAK_INTERRUPT                                   0x0020
+#define EUSCI_B_I2C_BYTE_COUNTER_INTERRUPT                          0x0040
+#define EUSCI_B_I2C_STOP_SEND_COMPLETE                              0x00
+typedef struct EUSCI_B_I2C_initMasterParam {
+    uint8_t selectClockSource;
+    uint32_t i2cClk;
+    uint32_t dataRate;
+    uint8_t byteCounterThreshold;
+    uint8_t autoSTOPGeneration;
+} EUSCI_B_I2C_initMasterParam;
+void EUSCI_B_I2C_initMaster(uint16_t baseAddress, EUSCI_B_I2C_initMasterParam *param);
+void EUSCI_B_I2C_setSlaveAddress(uint16_t baseAddress, uint8_t slaveAddress);
+void EUSCI_B_I2C_setMode(uint16_t baseAddress, uint8_t mode);
+void EUSCI_B_I2C_enable(uint16_t baseAddress);
+void EUSCI_B_I2C_clearInterrupt(uint16_t baseAddress, uint16_t mask);
+void EUSCI_B_I2C_enableInterrupt(uint16_t baseAddress, uint16_t mask);
+void EUSCI_B_I2C_masterSendMultiByteStart(uint16_t baseAddress, uint8_t txData);
+void EUSCI_B_I2C_masterSendMultiByteNext(uint16_t baseAddress, uint8_t txData);
+void EUSCI_B_I2C_masterSendMultiByteFinish(uint16_t baseAddress, uint8_t txData);
+void EUSCI_B_I2C_masterReceiveStart(uint16_t baseAddress);
+uint8_t EUSCI_B_I2C_masterReceiveMultiByteNext(uint16_t baseAddress);
+void EUSCI_B_I2C_masterReceiveMultiByteStop(uint16_t baseAddress);
+uint16_t EUSCI_B_I2C_masterIsStopSent(uint16_t baseAddress);
+
+// The simulated time, and what the simulated eUSCI_B has done: the interrupts that it has taken,
+// the bytes that it has put on the wire, and the transfers that the Notecard found malformed
+uint64_t mockNowNs(void);
+uint32_t mockI2CInterrupts(void);
+uint32_t mockI2CBytes(void);
+uint32_t mockI2CErrors(void);
+
+#endif // DRIVERLIB_H
@@ -0,0 +1,114 @@
+// Copyright 2019 Blues Inc.  All rights reserved.
+// Use of this source code is governed by licenses granted by the
+// copyright holder including that found in the LICENSE file.
+
+#include <setjmp.h>
+#include "sched_sim.h"
+#include "clock.h"
+
+// The simulated clock and CPU
+static uint64_t nowMs = 0;
+static uint64_t asleepMs = 0;
+static bool interruptsEnabled = true;
+
+// The simulated ISR
+static simIsrFn isrFn = NULL;
+static uint32_t isrPeriodMs = 0;
+static uint64_t isrDueMs = 0;
+
+// Where to return to once the run is over
+static jmp_buf runEnd;
+static uint64_t runEndMs = 0;
+
+// Start the simulation afresh at the specified time, with no ISR
+void simReset(uint64_t startMs) {
+    nowMs = startMs;
+    asleepMs = 0;
+    interruptsEnabled = true;
+    isrFn = NULL;
+}
+
+// Fire the specified ISR every period, first after a period has passed, or never if it's NULL
+void simIsrEvery(simIsrFn isr, uint32_t periodMs) {
+    isrFn = isr;
+    isrPeriodMs = periodMs;
+    isrDueMs = nowMs + periodMs;
+}
+
+// Fire the ISR if it's due, as it would be on return from the sleep or busy period that made it so
+static void isrFire(void) {
+    while (isrFn != NULL && isrDueMs <= nowMs) {
+        isrDueMs += isrPeriodMs;
+        bool enabled = interruptsEnabled;
+        interruptsEnabled = false;
+        isrFn();
+        interruptsEnabled = enabled;
+    }
+}
+
+// Run schedRun() until the simulated clock reaches the specified time
+bool simRunUntil(uint64_t endMs) {
+    runEndMs = endMs;
+    int ended = setjmp(runEnd);
+    if (ended == 0)
+        schedRun();
+    interruptsEnabled = true;
+    return ended == 1;
+}
+
+// Pass time as though the running task were busy
+void simBusy(uint32_t ms) {
+    for (uint32_t i = 0; i < ms; i++) {
+        nowMs++;
+        if (interruptsEnabled)
+            isrFire();
+    }
+}
+
+uint64_t simNowMs(void) {
+    return nowMs;
+}
+
+uint64_t simAsleepMs(void) {
+    return asleepMs;
+}
+
+// The platform functions that sched.c needs
+long unsigned int millis(void) {
+    return (uint32_t) nowMs;
+}
+
+unsigned short schedDisableInterrupts(void) {
+    unsigned short state = interruptsEnabled;
+    interruptsEnabled = false;
+    return state;
+}
+
+void schedRestoreInterrupts(unsigned short state) {
+    interruptsEnabled = (state != 0);
+    if (interruptsEnabled)
+        isrFire();
+}
+
+// Sleep until the ISR fires or the deadline is reached, ending the run once it's over
+void schedSleep(bool timed, long unsigned int deadlineMs) {
+    uint64_t wakeMs = runEndMs;
+    if (isrFn != NULL && isrDueMs < wakeMs)
+        wakeMs = isrDueMs;
+    if (timed) {
+        int32_t remainingMs = clockMsUntil(millis(), deadlineMs);
+        uint64_t timerMs = nowMs + (remainingMs > 0 ? (uint32_t) remainingMs : 0);
+        if (timerMs < wakeMs)
+            wakeMs = timerMs;
+    } else if (isrFn == NULL) {
+        longjmp(runEnd, 2);
+    }
+    if (wakeMs >= runEndMs) {
+        asleepMs += runEndMs - nowMs;
+        nowMs = runEndMs;
+        longjmp(runEnd, 1);
+    }
+    asleepMs += wakeMs - nowMs;
+    nowMs = wakeMs;
+    isrFire();
+}
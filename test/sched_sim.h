@@ -0,0 +1,35 @@
+#ifndef SCHED_SIM_H
+#define SCHED_SIM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "sched.h"
+
+//
+// A simulated platform for running sched.c on a host, providing the functions that sched.h expects
+// of the platform.  Time is simulated, and passes only while sleeping or while a task says that it's
+// busy, so that runs are fast and repeatable.  millis() wraps at 32 bits, as it does on the MSP430.
+// An ISR may be simulated as firing periodically, which it does whenever its time comes, whether
+// the CPU is asleep or busy, as long as interrupts are enabled.
+//
+
+typedef void (*simIsrFn)(void);
+
+// Start the simulation afresh at the specified time, with no ISR
+void simReset(uint64_t startMs);
+
+// Fire the specified ISR every period, first after a period has passed, or never if it's NULL
+void simIsrEvery(simIsrFn isr, uint32_t periodMs);
+
+// Run schedRun() until the simulated clock reaches the specified time, returning false if it
+// stopped early because it slept with nothing to wake it
+bool simRunUntil(uint64_t endMs);
+
+// Pass time as though the running task were busy for the specified number of milliseconds
+void simBusy(uint32_t ms);
+
+// The simulated time, unwrapped, and how much of it was spent asleep
+uint64_t simNowMs(void);
+uint64_t simAsleepMs(void);
+
+#endif // SCHED_SIM_H
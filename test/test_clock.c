@@ -0,0 +1,104 @@
+// Copyright 2019 Blues Inc.  All rights reserved.
+// Use of this source code is governed by licenses granted by the
+// copyright holder including that found in the LICENSE file.
+
+// Host tests of the clock arithmetic in clock.h, particularly across the wrap of millis()
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "clock.h"
+#include "check.h"
+
+// The first tick at which millis() has wrapped
+#define WRAP_TICKS      ((((uint64_t) 1 << 32) * CLOCK_FREQUENCY + 999) / 1000)
+
+// A reading of the counter is extended by the overflows counted so far, plus one that is pending
+// only if the reading is from after it
+static void testExtend(void) {
+    CHECK(clockExtend(0, 0, false) == 0);
+    CHECK(clockExtend(0, 0xffff, false) == 0xffff);
+    CHECK(clockExtend(5, 0x1234, false) == ((uint64_t) 5 << 16) + 0x1234);
+    CHECK(clockExtend(5, 0x0001, true) == ((uint64_t) 6 << 16) + 0x0001);
+    CHECK(clockExtend(5, 0x7fff, true) == ((uint64_t) 6 << 16) + 0x7fff);
+    CHECK(clockExtend(5, 0x8000, true) == ((uint64_t) 5 << 16) + 0x8000);
+    CHECK(clockExtend(5, 0xffff, true) == ((uint64_t) 5 << 16) + 0xffff);
+    CHECK(clockExtend(0xffffffff, 0x0001, false) == ((uint64_t) 0xffffffff << 16) + 0x0001);
+}
+
+// Milliseconds advance by at most one per tick, and wrap from 0xffffffff to 0
+static void testTicksToMs(void) {
+    CHECK(clockTicksToMs(0) == 0);
+    CHECK(clockTicksToMs(CLOCK_FREQUENCY) == 1000);
+    CHECK(clockTicksToMs(CLOCK_FREQUENCY - 1) == 999);
+    CHECK(clockTicksToMs(WRAP_TICKS - 1) == 0xffffffff);
+    CHECK(clockTicksToMs(WRAP_TICKS) == 0);
+    CHECK(clockTicksToMs(WRAP_TICKS + CLOCK_FREQUENCY) == 1000);
+    long unsigned int lastMs = clockTicksToMs(WRAP_TICKS - 100000);
+    for (uint64_t ticks = WRAP_TICKS - 100000; ticks < WRAP_TICKS + 100000; ticks++) {
+        long unsigned int ms = clockTicksToMs(ticks);
+        CHECK((uint32_t) (ms - lastMs) <= 1);
+        lastMs = ms;
+    }
+}
+
+// Times compare by their signed difference, so that they compare correctly across the wrap
+static void testReached(void) {
+    CHECK(clockMsUntil(100, 150) == 50);
+    CHECK(clockMsUntil(150, 100) == -50);
+    CHECK(clockMsUntil(0xfffffff0, 0x10) == 0x20);
+    CHECK(clockMsUntil(0x10, 0xfffffff0) == -0x20);
+    CHECK(clockMsUntil(0, 0x7fffffff) == 0x7fffffff);
+    CHECK(clockReached(100, 100));
+    CHECK(clockReached(101, 100));
+    CHECK(!clockReached(99, 100));
+    CHECK(!clockReached(0xfffffff0, 0x10));
+    CHECK(clockReached(0x10, 0xfffffff0));
+    CHECK(clockReached(0x10, 0x10));
+
+    // A deadline computed as millis() + ms, as delay() does, is reached exactly ms later, even if the
+    // sum exceeds 32 bits as it does where long is 64 bits
+    for (long unsigned int nowMs = 0xffffff00; nowMs != 0x100; nowMs = (uint32_t) (nowMs + 1)) {
+        long unsigned int deadlineMs = nowMs + 0x80;
+        CHECK(clockMsUntil(nowMs, deadlineMs) == 0x80);
+        CHECK(!clockReached((uint32_t) (nowMs + 0x7f), deadlineMs));
+        CHECK(clockReached((uint32_t) (nowMs + 0x80), deadlineMs));
+    }
+}
+
+// The compare is armed between its bounds, and never wakes a sleeper before its deadline
+static void testCompareTicks(void) {
+    CHECK(clockMsToTicks(0) == 0);
+    CHECK(clockMsToTicks(1) == 33);
+    CHECK(clockMsToTicks(1000) == CLOCK_FREQUENCY);
+    CHECK(clockMsToTicks(131000) == 131 * CLOCK_FREQUENCY);
+    CHECK(clockCompareTicks(0) == CLOCK_COMPARE_MIN_TICKS);
+    CHECK(clockCompareTicks(1) == 33);
+    CHECK(clockCompareTicks(CLOCK_COMPARE_MAX_MS - 1) <= CLOCK_COMPARE_MAX_TICKS);
+    CHECK(clockCompareTicks(CLOCK_COMPARE_MAX_MS) == CLOCK_COMPARE_MAX_TICKS);
+    CHECK(clockCompareTicks(0x7fffffff) == CLOCK_COMPARE_MAX_TICKS);
+
+    srand(1);
+    for (int i = 0; i < 1000000; i++) {
+        uint64_t ticks = (i & 1) ? WRAP_TICKS - 40000 + rand() % 80000 : ((uint64_t) rand() << 16) + rand();
+        long unsigned int nowMs = clockTicksToMs(ticks);
+        int32_t remainingMs = 1 + rand() % 3000;
+        long unsigned int deadlineMs = nowMs + remainingMs;
+        uint32_t compareTicks = clockCompareTicks(clockMsUntil(nowMs, deadlineMs));
+        CHECK(compareTicks >= CLOCK_COMPARE_MIN_TICKS && compareTicks <= CLOCK_COMPARE_MAX_TICKS);
+        long unsigned int wokenMs = clockTicksToMs(ticks + compareTicks);
+        if (remainingMs < (int32_t) CLOCK_COMPARE_MAX_MS) {
+            CHECK(clockReached(wokenMs, deadlineMs));
+            CHECK(clockMsUntil(deadlineMs, wokenMs) <= 1);
+        } else {
+            CHECK(!clockReached(wokenMs, deadlineMs) || remainingMs == (int32_t) CLOCK_COMPARE_MAX_MS);
+        }
+    }
+}
+
+int main(void) {
+    testExtend();
+    testTicksToMs();
+    testReached();
+    testCompareTicks();
+    return checkReport("clock");
+}
@@ -0,0 +1,136 @@
+// Copyright 2019 Blues Inc.  All rights reserved.
+// Use of this source code is governed by licenses granted by the
+// copyright holder including that found in the LICENSE file.
+
+// Host tests of the scheduler in sched.c, run on a simulated clock
+
+#include <stdio.h>
+#include "sched_sim.h"
+#include "check.h"
+
+// Where millis() wraps
+#define WRAP_MS     ((uint64_t) 1 << 32)
+
+// A record of when each task ran, and in what order
+#define RUNS_MAX    64
+static struct {
+    int id;
+    uint64_t atMs;
+} runs[RUNS_MAX];
+static int runCount = 0;
+
+static void record(void *context) {
+    if (runCount < RUNS_MAX) {
+        runs[runCount].id = (int) (intptr_t) context;
+        runs[runCount].atMs = simNowMs();
+    }
+    runCount++;
+}
+
+static void start(uint64_t startMs) {
+    simReset(startMs);
+    runCount = 0;
+}
+
+// Posted tasks run in the order that they were posted, once however often they were posted
+static void testPost(void) {
+    task a, b, c;
+    taskInit(&a, record, (void *) 1);
+    taskInit(&b, record, (void *) 2);
+    taskInit(&c, record, (void *) 3);
+    start(0);
+    taskPost(&b);
+    taskPost(&a);
+    taskPost(&b);
+    taskPost(&c);
+    CHECK(schedDispatch() == 3);
+    CHECK(runCount == 3);
+    CHECK(runs[0].id == 2 && runs[1].id == 1 && runs[2].id == 3);
+    CHECK(schedDispatch() == 0);
+}
+
+// Timers run when they're due and in the order that they're due, straddling the wrap of millis(), and
+// once they have, there's nothing left to wake the CPU
+static void testTimers(uint64_t startMs) {
+    task a, b, c;
+    taskInit(&a, record, (void *) 1);
+    taskInit(&b, record, (void *) 2);
+    taskInit(&c, record, (void *) 3);
+    start(startMs);
+    taskAfter(&a, 600);
+    taskAfter(&b, 300);
+    taskAfter(&c, 900);
+    taskCancel(&c);
+    CHECK(!simRunUntil(startMs + 1000));
+    CHECK(runCount == 2);
+    CHECK(runs[0].id == 2 && runs[0].atMs == startMs + 300);
+    CHECK(runs[1].id == 1 && runs[1].atMs == startMs + 600);
+    CHECK(simAsleepMs() == 600);
+}
+
+// Periodic tasks run exactly on their period, straddling the wrap of millis()
+static void testPeriodic(uint64_t startMs) {
+    task a;
+    taskInit(&a, record, (void *) 1);
+    start(startMs);
+    taskEvery(&a, 100, 50);
+    CHECK(simRunUntil(startMs + 1000));
+    taskCancel(&a);
+    CHECK(runCount == 10);
+    for (int i = 0; i < runCount && i < RUNS_MAX; i++)
+        CHECK(runs[i].atMs == startMs + 50 + 100 * (uint64_t) i);
+}
+
+// A periodic task that falls more than a period behind skips the runs that it missed, staying in
+// step with its period rather than running them back to back
+static task slow;
+static void slowRun(void *context) {
+    record(context);
+    if (runCount == 2)
+        simBusy(250);
+}
+static void testBehind(void) {
+    taskInit(&slow, slowRun, (void *) 1);
+    start(0);
+    taskEvery(&slow, 100, 100);
+    CHECK(simRunUntil(1000));
+    taskCancel(&slow);
+    CHECK(runCount == 8);
+    CHECK(runs[0].atMs == 100 && runs[1].atMs == 200 && runs[2].atMs == 450);
+    CHECK(runs[3].atMs == 500 && runs[7].atMs == 900);
+}
+
+// A task posted by an ISR runs as soon as the ISR has woken the CPU, or as soon as the running task
+// has returned
+static task isrTask;
+static void isrPost(void) {
+    taskPost(&isrTask);
+}
+static void testIsr(void) {
+    taskInit(&isrTask, record, (void *) 1);
+    start(WRAP_MS - 50);
+    simIsrEvery(isrPost, 7);
+    CHECK(simRunUntil(WRAP_MS + 50));
+    simIsrEvery(NULL, 0);
+    CHECK(runCount == 14);
+    for (int i = 0; i < runCount && i < RUNS_MAX; i++)
+        CHECK(runs[i].atMs == WRAP_MS - 50 + 7 * (uint64_t) (i + 1));
+}
+
+// With nothing to run, no timers and no ISR, the CPU would sleep forever
+static void testIdle(void) {
+    start(0);
+    CHECK(!simRunUntil(1000));
+}
+
+int main(void) {
+    testPost();
+    testTimers(0);
+    testTimers(WRAP_MS - 450);
+    testPeriodic(1000);
+    testPeriodic(WRAP_MS - 520);
+    testBehind();
+    testIsr();
+    testIdle();
+    return checkReport("sched");
+}
@@ -0,0 +1,232 @@
+// Copyright 2019 Blues Inc.  All rights reserved.
+// Use of this source code is governed by licenses granted by the
+// copyright holder including that found in the LICENSE file.
+
+// Host tests of note-c's transactions with the simulated Notecard of card_sim.c, over SERIAL and over
+// I2C, on a simulated clock: that a transaction begun with NoteTransactionBegin is polled until its
+// reply arrives and is then completed, and that no other transaction may interleave with it; that
+// the reply latency learned for a kind of request converges to how long the Notecard takes to
+// reply, so that waiting for a reply takes few polls; and that receiving a reply a block at a time
+// with NoteSetFnSerialReceiveBlock gets the same response as receiving it a byte at a time.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "note.h"
+#include "card_sim.h"
+#include "heap_sim.h"
+#include "check.h"
+
+// How long the simulated Notecard takes to reply
+#define REPLY_DELAY_MS  120
+
+// Simulated time, which passes only while note-c delays or waits
+static uint64_t nowUs = 0;
+
+static void hostDelay(uint32_t ms) {
+    nowUs += (uint64_t) ms * 1000;
+    cardPass(ms * 1000);
+}
+
+static uint32_t hostMillis(void) {
+    return (uint32_t) (nowUs / 1000);
+}
+
+// How many times note-c has waited for a reply that wasn't there
+static uint32_t waits = 0;
+
+// SERIAL, straight to the simulated Notecard
+static bool serialReset(void) {
+    return true;
+}
+
+static void serialTransmit(uint8_t *data, size_t len, bool flush) {
+    (void) flush;
+    cardReceive(data, len);
+}
+
+static bool serialAvailable(void) {
+    return cardAvailable() > 0;
+}
+
+// Waiting until a reply starts to arrive, or for at most the specified time, as main.c does
+static bool serialWait(uint32_t timeoutMs) {
+    waits++;
+    for (uint32_t ms = 0; cardAvailable() == 0; ms++) {
+        if (ms >= timeoutMs)
+            return false;
+        hostDelay(1);
+    }
+    return true;
+}
+
+static char serialReceive(void) {
+    uint8_t data = 0;
+    cardSend(&data, 1);
+    return (char) data;
+}
+
+// Receiving a block at a time, of no more than a set size
+static size_t blockMax = 0;
+
+static size_t serialReceiveBlock(uint8_t *data, size_t len) {
+    return cardSend(data, len < blockMax ? len : blockMax);
+}
+
+// I2C, in the frames of the Notecard's I2C protocol
+static bool i2cReset(uint16_t address) {
+    (void) address;
+    return true;
+}
+
+static const char *i2cTransmit(uint16_t address, uint8_t *data, uint16_t len) {
+    (void) address;
+    uint8_t frame[NOTE_I2C_MAX_MAX + 1];
+    frame[0] = (uint8_t) len;
+    memcpy(&frame[1], data, len);
+    return (cardI2CWrite(frame, len + 1) ? NULL : "i2c: frame not acknowledged");
+}
+
+static const char *i2cReceive(uint16_t address, uint8_t *data, uint16_t len, uint32_t *available) {
+    (void) address;
+    uint8_t frame[NOTE_I2C_MAX_MAX + 2] = {0, (uint8_t) len};
+    if (!cardI2CWrite(frame, 2) || cardI2CRead(frame, sizeof(frame)) != len + 2u)
+        return "i2c: incorrect amount of data";
+    memcpy(data, &frame[2], len);
+    *available = frame[0];
+    if (len == 0 && *available == 0)
+        waits++;
+    return NULL;
+}
+
+// A transaction begun, polled until its reply arrives, and completed, with no other transaction
+// able to interleave with it
+static void testBeginPollComplete(void) {
+    cardReset("{\"total\":1}");
+    cardDelayReplies(REPLY_DELAY_MS * 1000);
+    NoteReset();
+
+    J *req = NoteNewRequest("note.add");
+    CHECK(NoteTransactionBegin(req));
+    JDelete(req);
+    CHECK(cardRequests() == 1);
+    CHECK(!NoteTransactionPoll());
+
+    // Neither another transaction nor another begin interleaves with it
+    J *rsp = NoteRequestResponse(NoteNewRequest("card.version"));
+    CHECK(rsp != NULL && NoteResponseError(rsp));
+    CHECK(rsp != NULL && strstr(JGetString(rsp, "err"), "in progress") != NULL);
+    JDelete(rsp);
+    req = NoteNewRequest("card.version");
+    CHECK(!NoteTransactionBegin(req));
+    JDelete(req);
+    CHECK(cardRequests() == 1);
+
+    // The reply arrives only once the Notecard has had time to process the request
+    hostDelay(REPLY_DELAY_MS / 2);
+    CHECK(!NoteTransactionPoll());
+    hostDelay(REPLY_DELAY_MS / 2);
+    bool ready = false;
+    for (int i = 0; i < 100 && !ready; i++)
+        ready = NoteTransactionPoll();
+    CHECK(ready);
+    rsp = NoteTransactionComplete();
+    CHECK(rsp != NULL && !NoteResponseError(rsp) && JGetInt(rsp, "total") == 1);
+    JDelete(rsp);
+
+    // After which nothing is in progress, and another transaction may be made
+    CHECK(NoteTransactionPoll());
+    CHECK(NoteTransactionComplete() == NULL);
+    rsp = NoteRequestResponse(NoteNewRequest("note.add"));
+    CHECK(rsp != NULL && JGetInt(rsp, "total") == 1);
+    JDelete(rsp);
+
+    // Completing without polling waits for the reply
+    uint32_t beganMs = hostMillis();
+    req = NoteNewRequest("note.add");
+    CHECK(NoteTransactionBegin(req));
+    JDelete(req);
+    rsp = NoteTransactionComplete();
+    CHECK(rsp != NULL && JGetInt(rsp, "total") == 1);
+    CHECK(hostMillis() - beganMs >= REPLY_DELAY_MS);
+    JDelete(rsp);
+    CHECK(cardRequests() == 3);
+}
+
+// The latency learned for a kind of request, which converges to the Notecard's, after which a reply
+// is waited for with fewer waits, the first of them until just before it's expected, and without
+// waiting much past its arrival
+static void testLatency(const char *kind) {
+    cardReset("{\"total\":1}");
+    cardDelayReplies(REPLY_DELAY_MS * 1000);
+    NoteReset();
+
+    uint32_t firstWaits = 0;
+    uint32_t lastWaits = 0;
+    uint32_t lastMs = 0;
+    for (int t = 0; t < 20; t++) {
+        waits = 0;
+        uint32_t beganMs = hostMillis();
+        CHECK(NoteRequest(NoteNewRequest(kind)));
+        if (t == 0)
+            firstWaits = waits;
+        lastWaits = waits;
+        lastMs = hostMillis() - beganMs;
+    }
+    char req[16];
+    uint32_t latencyMs = 0;
+    uint32_t samples = 0;
+    CHECK(NoteGetReplyLatency(0, req, sizeof(req), &latencyMs, &samples));
+    CHECK(strcmp(req, kind) == 0);
+    CHECK(samples == 20);
+    CHECK(latencyMs >= REPLY_DELAY_MS && latencyMs <= REPLY_DELAY_MS + REPLY_DELAY_MS/8);
+    CHECK(lastWaits < firstWaits);
+    CHECK(lastMs >= REPLY_DELAY_MS && lastMs <= REPLY_DELAY_MS + REPLY_DELAY_MS/4);
+}
+
+// A response received a block at a time, which is the same as one received a byte at a time
+static char *transact(const char *reply) {
+    cardReset(reply);
+    J *rsp = NoteRequestResponse(NoteNewRequest("card.status"));
+    char *text = JPrintUnformatted(rsp);
+    JDelete(rsp);
+    return text;
+}
+
+static void testReceiveBlock(void) {
+    static char reply[900];
+    strcpy(reply, "{\"status\":\"");
+    memset(&reply[11], 'x', 800);
+    strcpy(&reply[11 + 800], "\",\"usb\":true,\"time\":1599769214}");
+
+    NoteSetFnSerialReceiveBlock(NULL);
+    char *byByte = transact(reply);
+    CHECK(byByte != NULL && strlen(byByte) == strlen(reply));
+    static const size_t blocks[] = {1, 7, 32, 64, 1024};
+    for (size_t i = 0; i < sizeof(blocks)/sizeof(blocks[0]); i++) {
+        blockMax = blocks[i];
+        NoteSetFnSerialReceiveBlock(serialReceiveBlock);
+        char *byBlock = transact(reply);
+        CHECK(byByte != NULL && byBlock != NULL && strcmp(byByte, byBlock) == 0);
+        JFree(byBlock);
+    }
+    NoteSetFnSerialReceiveBlock(NULL);
+    JFree(byByte);
+}
+
+int main(void) {
+    NoteSetFn(heapMalloc, heapFree, hostDelay, hostMillis);
+    NoteSetFnRealloc(heapRealloc);
+
+    NoteSetFnSerial(serialReset, serialTransmit, serialAvailable, serialReceive);
+    NoteSetFnSerialWait(serialWait);
+    testBeginPollComplete();
+    testLatency("card.time");
+    testReceiveBlock();
+    NoteSetFnI2C(NOTE_I2C_ADDR_DEFAULT, NOTE_I2C_MAX_DEFAULT, i2cReset, i2cTransmit, i2cReceive);
+    testBeginPollComplete();
+    testLatency("card.temp");
+    CHECK(heapHeld() == 0);
+
+    return checkReport("transaction");
+}